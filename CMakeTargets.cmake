@@ -3,3 +3,10 @@
 set(ALL_TARGETS "")
 set(ALL_TARGETS ${ALL_TARGETS};src/sewer;src/osbs;src/core;src/geom2d;src/draw2d;src/encode;src/inet)
 set(ALL_TARGETS ${ALL_TARGETS};src/html5;src/nlib;src/ndoc;src/nbuild)
+
+# Test programs, registered in CTest
+set(NBUILD_TESTS False CACHE BOOL "Build and register the nbuild tests.")
+if (NBUILD_TESTS)
+    enable_testing()
+    set(ALL_TARGETS ${ALL_TARGETS};tools/nbtest)
+endif()
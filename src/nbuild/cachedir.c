@@ -0,0 +1,106 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: cachedir.c
+ *
+ */
+
+/* Keys and expiration of content-addressed cache entries */
+
+#include "cachedir.h"
+#include <nlib/ssh.h>
+#include <core/arrst.h>
+#include <core/date.h>
+#include <core/hfile.h>
+#include <core/strings.h>
+#include <osbs/bfile.h>
+#include <osbs/bthread.h>
+#include <sewer/cassert.h>
+
+/* Entries not used in this time are removed */
+static const int32_t i_EXPIRE_DAYS = 30;
+/* Used entries are rewritten when older than this, to renew their date */
+static const int32_t i_REFRESH_DAYS = 7;
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t cachedir_fnv(const uint32_t seed, const byte_t *data, const uint32_t size)
+{
+    /* FNV-1a, independent of bhash to make the key wider */
+    uint32_t i, h = seed;
+    for (i = 0; i < size; ++i)
+    {
+        h ^= (uint32_t)data[i];
+        h *= 16777619;
+    }
+    return h;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static Date i_limit(const int32_t days)
+{
+    Date now = date_system();
+    return date_add_days(&now, -days);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t cachedir_refresh(const char_t *pathname)
+{
+    Date updated;
+    Date limit = i_limit(i_REFRESH_DAYS);
+    bool_t ok = FALSE;
+    if (bfile_lstat(pathname, NULL, NULL, &updated, NULL) == TRUE && date_cmp(&updated, &limit) < 0)
+    {
+        /* Other thread could be refreshing the same entry */
+        String *tmpname = str_printf("%s.%d", pathname, bthread_current_id());
+        if (hfile_copy(pathname, tc(tmpname), NULL) == TRUE)
+        {
+            ok = bfile_rename(tc(tmpname), pathname, NULL);
+            if (ok == FALSE)
+                bfile_delete(tc(tmpname), NULL);
+        }
+        str_destroy(&tmpname);
+    }
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t cachedir_prune(const char_t *path)
+{
+    /* Entries are files or directories. A directory is as old as its newest file */
+    ArrSt(DirEntry) *entries = hfile_dir_list(path, TRUE, NULL);
+    Date limit = i_limit(i_EXPIRE_DAYS);
+    uint32_t n = 0;
+
+    arrst_foreach(entry, entries, DirEntry)
+        String *pathname = str_cpath("%s/%s", path, tc(entry->name));
+        if (entry->type == ekDIRECTORY)
+        {
+            Date updated = hfile_date(tc(pathname), TRUE);
+            if (date_cmp(&updated, &limit) < 0 && hfile_dir_destroy(tc(pathname), NULL) == TRUE)
+                n += 1;
+        }
+        else if (date_cmp(&entry->date, &limit) < 0 && bfile_delete(tc(pathname), NULL) == TRUE)
+        {
+            n += 1;
+        }
+        str_destroy(&pathname);
+    arrst_end()
+
+    arrst_destroy(&entries, hfile_dir_entry_remove, DirEntry);
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t cachedir_prune_drive(const Login *drive, const char_t *path, const char_t *pattern)
+{
+    /* Same expiration, but by the date of the remote file */
+    return ssh_delete_expired(drive, path, pattern, (uint32_t)i_EXPIRE_DAYS);
+}
@@ -0,0 +1,24 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: cachedir.h
+ *
+ */
+
+/* Keys and expiration of content-addressed cache entries */
+
+#include "nbuild.hxx"
+
+/* FNV-1a offset basis, the seed of a new key */
+#define CACHEDIR_FNV_SEED 2166136261u
+
+uint32_t cachedir_fnv(const uint32_t seed, const byte_t *data, const uint32_t size);
+
+bool_t cachedir_refresh(const char_t *pathname);
+
+uint32_t cachedir_prune(const char_t *path);
+
+bool_t cachedir_prune_drive(const Login *drive, const char_t *path, const char_t *pattern);
@@ -0,0 +1,110 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: estim.c
+ *
+ */
+
+/* Job duration estimator */
+
+#include "estim.h"
+#include "report.h"
+#include <core/arrst.h>
+#include <sewer/cassert.h>
+
+/*---------------------------------------------------------------------------*/
+
+static int i_cmp_seconds(const uint32_t *s1, const uint32_t *s2)
+{
+    if (*s1 < *s2)
+        return -1;
+    if (*s1 > *s2)
+        return 1;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t estim_median(const ArrSt(uint32_t) *seconds)
+{
+    uint32_t n = arrst_size(seconds, uint32_t);
+    uint32_t median = UINT32_MAX;
+    if (n > 0)
+    {
+        ArrSt(uint32_t) *sorted = arrst_copy(seconds, NULL, uint32_t);
+        const uint32_t *s = NULL;
+        arrst_sort(sorted, i_cmp_seconds, uint32_t);
+        s = arrst_all_const(sorted, uint32_t);
+        if (n % 2 == 1)
+            median = s[n / 2];
+        else
+            median = (s[n / 2 - 1] + s[n / 2]) / 2;
+        arrst_destroy(&sorted, NULL, uint32_t);
+    }
+    return median;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t estim_step_seconds(const Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname)
+{
+    ArrSt(uint32_t) *seconds = arrst_create(uint32_t);
+    uint32_t median = UINT32_MAX;
+    report_job_times(report, job_id, step_id, hostname, seconds);
+    median = estim_median(seconds);
+    arrst_destroy(&seconds, NULL, uint32_t);
+    return median;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t estim_boot_seconds(const Report *report, const char_t *hostname)
+{
+    /* UINT32_MAX if the host has never been booted by nbuild */
+    ArrSt(uint32_t) *seconds = arrst_create(uint32_t);
+    uint32_t median = UINT32_MAX;
+    report_times(report, hostname, "boot", hostname, seconds);
+    median = estim_median(seconds);
+    arrst_destroy(&seconds, NULL, uint32_t);
+    return median;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t estim_job_seconds(const Report *report, const uint32_t job_id, const bool_t build_done, const char_t *hostname)
+{
+    /* UINT32_MAX if there is no history (unknown cost) */
+    uint32_t build = 0, test = 0;
+    if (build_done == FALSE)
+    {
+        build = estim_step_seconds(report, job_id, "build", hostname);
+        if (build == UINT32_MAX)
+            return UINT32_MAX;
+    }
+
+    /* Jobs without tests or never tested, only build time */
+    test = estim_step_seconds(report, job_id, "test", hostname);
+    if (test == UINT32_MAX)
+    {
+        if (build_done == TRUE)
+            return UINT32_MAX;
+        test = 0;
+    }
+
+    return build + test;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t estim_completion(const uint32_t queued, const uint32_t slots, const uint32_t boot, const uint32_t seconds)
+{
+    /* Queued work is spread over the host slots. The job starts when a slot is free */
+    uint32_t nslots = slots > 0 ? slots : 1;
+    uint64_t total = (uint64_t)boot + (uint64_t)(queued / nslots) + (uint64_t)seconds;
+    if (total >= UINT32_MAX)
+        return UINT32_MAX - 1;
+    return (uint32_t)total;
+}
@@ -0,0 +1,23 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: estim.h
+ *
+ */
+
+/* Job duration estimator */
+
+#include "nbuild.hxx"
+
+uint32_t estim_median(const ArrSt(uint32_t) *seconds);
+
+uint32_t estim_step_seconds(const Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname);
+
+uint32_t estim_boot_seconds(const Report *report, const char_t *hostname);
+
+uint32_t estim_job_seconds(const Report *report, const uint32_t job_id, const bool_t build_done, const char_t *hostname);
+
+uint32_t estim_completion(const uint32_t queued, const uint32_t slots, const uint32_t boot, const uint32_t seconds);
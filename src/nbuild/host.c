@@ -11,6 +11,7 @@
 /* Build host (runner) */
 
 #include "host.h"
+#include "hostcaps.h"
 #include "nbuild.h"
 #include "network.h"
 #include <nlib/nlib.h>
@@ -19,9 +20,14 @@
 #include <encode/base64.h>
 #include <core/arrst.h>
 #include <core/arrpt.h>
+#include <core/bhash.h>
 #include <core/dbind.h>
+#include <core/heap.h>
 #include <core/strings.h>
 #include <core/stream.h>
+#include <osbs/bmutex.h>
+#include <osbs/bthread.h>
+#include <osbs/btime.h>
 #include <osbs/log.h>
 #include <sewer/cassert.h>
 
@@ -50,13 +56,57 @@ struct _host_t
     String *macos_host;
     String *macos_volume;
     String *mingw_path;
+    uint32_t slots;
+    uint32_t njobs;
+    uint32_t test_jobs;
+    /* Minutes a booted VM keeps running after its last job (0 shutdown) */
+    uint32_t keepalive;
     Login login;
     ArrPt(String) *generators;
     ArrPt(String) *tags;
 };
 
+typedef struct _testrun_t TestRun;
+typedef struct _buildscan_t BuildScan;
+
+struct _testrun_t
+{
+    const Host *host;
+    const Job *job;
+    const char_t *buildpath;
+    const char_t *envvars;
+    const ArrSt(Target) *tests;
+    /* Index in 'tests' of each result */
+    ArrSt(uint32_t) *targets;
+    ArrSt(RTest) *results;
+    /* Next test to launch, protected by mutex */
+    uint32_t next;
+    Mutex *mutex;
+};
+
+/* Build output processed line by line while the build is running */
+struct _buildscan_t
+{
+    const Host *host;
+    uint32_t runner_id;
+    bool_t ascii_fix;
+    Stream *log;
+    Stream *warns;
+    Stream *errors;
+    uint32_t nwarns;
+    uint32_t nerrors;
+    uint32_t progress;
+};
+
 ArrStDebug(Host);
 
+/* Default wall-clock limit (seconds) of a test executable */
+static const uint32_t i_TEST_TIMEOUT = 1800;
+/* Extra time before killing the local ssh client of a blocked test */
+static const uint32_t i_TEST_GRACE = 60;
+/* Toolchain key and number of builds of an incremental build tree */
+static const char_t *i_INCREMENTAL_STAMP = "incr.txt";
+
 /*---------------------------------------------------------------------------*/
 
 void host_dbind(void)
@@ -73,6 +123,10 @@ void host_dbind(void)
     dbind(Host, String *, macos_host);
     dbind(Host, String *, macos_volume);
     dbind(Host, String *, mingw_path);
+    dbind(Host, uint32_t, slots);
+    dbind(Host, uint32_t, njobs);
+    dbind(Host, uint32_t, test_jobs);
+    dbind(Host, uint32_t, keepalive);
     dbind(Host, Login, login);
     dbind(Host, ArrPt(String) *, generators);
     dbind(Host, ArrPt(String) *, tags);
@@ -183,6 +237,30 @@ const char_t *host_macos_volume(const Host *host)
 
 /*---------------------------------------------------------------------------*/
 
+uint32_t host_slots(const Host *host)
+{
+    cassert_no_null(host);
+    return host->slots;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t host_njobs(const Host *host)
+{
+    cassert_no_null(host);
+    return host->njobs;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t host_keepalive(const Host *host)
+{
+    cassert_no_null(host);
+    return host->keepalive;
+}
+
+/*---------------------------------------------------------------------------*/
+
 const Login *host_login(const Host *host)
 {
     cassert_no_null(host);
@@ -200,7 +278,7 @@ void host_localhost(ArrSt(Host) *hosts, const ArrSt(uint32_t) *ips)
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_job_match(const Host *host, const Job *job)
+bool_t host_can_run_job(const Host *host, const Job *job)
 {
     bool_t ok = TRUE;
     cassert_no_null(job);
@@ -247,17 +325,6 @@ static bool_t i_job_match(const Host *host, const Job *job)
 
 /*---------------------------------------------------------------------------*/
 
-const Host *host_match_job(const ArrSt(Host) *hosts, const Job *job)
-{
-    arrst_foreach_const(host, hosts, Host)
-        if (i_job_match(host, job) == TRUE)
-            return host;
-    arrst_end()
-    return NULL;
-}
-
-/*---------------------------------------------------------------------------*/
-
 const Host *host_by_name(const ArrSt(Host) *hosts, const char_t *name)
 {
     arrst_foreach_const(host, hosts, Host)
@@ -334,36 +401,39 @@ macos_t host_macos_version(const Host *host)
 
 /*---------------------------------------------------------------------------*/
 
+/* Build prologue in a single remote session: workpath and clean build directory */
 static bool_t i_create_build_dirs(const Host *host, const char_t *flowpath, const uint32_t runner_id, String **error_msg)
 {
     bool_t ok = TRUE;
+    SSHBatch *batch = NULL;
+    uint32_t step_work, step_del, step_flow;
     cassert_no_null(host);
     cassert_no_null(error_msg);
     cassert(*error_msg == NULL);
-    if (ok == TRUE)
+    batch = ssh_batch_create(&host->login);
+    step_work = ssh_batch_create_dir(batch, tc(host->workpath));
+    step_del = ssh_batch_delete_dir(batch, flowpath);
+    step_flow = ssh_batch_create_dir(batch, flowpath);
+    ssh_batch_run(batch);
+
+    if (ssh_batch_ret(batch, step_work) != 0)
     {
-        ok = ssh_create_dir(&host->login, tc(host->workpath));
-        if (ok == FALSE)
-            *error_msg = str_printf("Error creating host '%s' directory '%s'", tc(host->name), tc(host->workpath));
+        *error_msg = str_printf("Error creating host '%s' directory '%s'", tc(host->name), tc(host->workpath));
+        ok = FALSE;
     }
-
-    if (ok == TRUE)
+    else if (ssh_batch_ret(batch, step_del) != 0)
     {
-        if (ssh_dir_exists(&host->login, flowpath) == TRUE)
-        {
-            ok = ssh_delete_dir(&host->login, flowpath);
-            if (ok == FALSE)
-                *error_msg = str_printf("Error removing host '%s' directory '%s'", tc(host->name), flowpath);
-        }
+        *error_msg = str_printf("Error removing host '%s' directory '%s'", tc(host->name), flowpath);
+        ok = FALSE;
     }
-
-    if (ok == TRUE)
+    else if (ssh_batch_ret(batch, step_flow) != 0)
     {
-        ok = ssh_create_dir(&host->login, flowpath);
-        if (ok == FALSE)
-            *error_msg = str_printf("Error creating host '%s' directory '%s'", tc(host->name), flowpath);
+        *error_msg = str_printf("Error creating host '%s' directory '%s'", tc(host->name), flowpath);
+        ok = FALSE;
     }
 
+    ssh_batch_destroy(&batch);
+
     if (ok == TRUE)
         log_printf("%s Runner %s[%d]%s '%s%s%s' created '%s%s%s' build directory", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_PATH, flowpath, kASCII_RESET);
 
@@ -649,38 +719,176 @@ static bool_t i_cmake_configure(const Host *host, const Job *job, const generato
 
 /*---------------------------------------------------------------------------*/
 
-static uint32_t i_get_messages(const String *msgbuf, const char_t **msg, const uint32_t nmsgs, String **msg_log)
+static bool_t i_match_any(const char_t *str, const char_t **msgs, const uint32_t nmsgs)
+{
+    uint32_t i = 0;
+    for (i = 0; i < nmsgs; ++i)
+    {
+        if (str[0] == msgs[i][0] && str_is_prefix(str, msgs[i]) == TRUE)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Single pass over the line, looking for warning and error patterns at the same time */
+static void i_classify_line(const char_t *line, const char_t **warnmsgs, const uint32_t nwarnmsgs, const char_t **errmsgs, const uint32_t nerrmsgs, bool_t *is_warn, bool_t *is_error)
+{
+    const char_t *c = line;
+    cassert_no_null(line);
+    cassert_no_null(is_warn);
+    cassert_no_null(is_error);
+    *is_warn = FALSE;
+    *is_error = FALSE;
+    while (*c != '\0' && (*is_warn == FALSE || *is_error == FALSE))
+    {
+        if (*is_warn == FALSE)
+            *is_warn = i_match_any(c, warnmsgs, nwarnmsgs);
+        if (*is_error == FALSE)
+            *is_error = i_match_any(c, errmsgs, nerrmsgs);
+        c += 1;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_get_messages(const String *msgbuf, const char_t **warnmsgs, const uint32_t nwarnmsgs, const char_t **errmsgs, const uint32_t nerrmsgs, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors)
 {
     const byte_t *data = cast_const(tc(msgbuf), byte_t);
     uint32_t size = str_len(msgbuf);
     Stream *stm = stm_from_block(data, size);
-    Stream *out = stm_memory(1024);
-    uint32_t i, n = 0;
-    cassert_no_null(msg_log);
-    cassert(*msg_log == NULL);
+    Stream *wout = stm_memory(1024);
+    Stream *eout = stm_memory(1024);
+    cassert_no_null(warns);
+    cassert_no_null(errors);
+    cassert_no_null(nwarns);
+    cassert_no_null(nerrors);
+    cassert(*warns == NULL);
+    cassert(*errors == NULL);
+    *nwarns = 0;
+    *nerrors = 0;
 
     stm_lines(line, stm)
-        for (i = 0; i < nmsgs; ++i)
+        bool_t is_warn = FALSE, is_error = FALSE;
+        i_classify_line(line, warnmsgs, nwarnmsgs, errmsgs, nerrmsgs, &is_warn, &is_error);
+        if (is_warn == TRUE)
         {
-            if (str_str(line, msg[i]) != NULL)
-            {
-                stm_writef(out, line);
-                stm_writef(out, "\n");
-                n += 1;
-                break;
-            }
+            stm_writef(wout, line);
+            stm_writef(wout, "\n");
+            *nwarns += 1;
+        }
+
+        if (is_error == TRUE)
+        {
+            stm_writef(eout, line);
+            stm_writef(eout, "\n");
+            *nerrors += 1;
         }
     stm_next(line, stm)
 
-    *msg_log = stm_str(out);
+    *warns = stm_str(wout);
+    *errors = stm_str(eout);
     stm_close(&stm);
-    stm_close(&out);
-    return n;
+    stm_close(&wout);
+    stm_close(&eout);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Make '[ 45%]' or Ninja '[12/345]' progress prefix */
+static uint32_t i_build_progress(const char_t *line)
+{
+    const char_t *c = line;
+    uint32_t num = 0, den = 0;
+    if (*c != '[')
+        return UINT32_MAX;
+
+    c += 1;
+    while (*c == ' ')
+        c += 1;
+
+    if (*c < '0' || *c > '9')
+        return UINT32_MAX;
+
+    while (*c >= '0' && *c <= '9')
+    {
+        num = num * 10 + (uint32_t)(*c - '0');
+        c += 1;
+    }
+
+    if (*c == '%' && num <= 100)
+        return num;
+
+    if (*c != '/')
+        return UINT32_MAX;
+
+    c += 1;
+    while (*c >= '0' && *c <= '9')
+    {
+        den = den * 10 + (uint32_t)(*c - '0');
+        c += 1;
+    }
+
+    if (*c != ']' || den == 0 || num > den)
+        return UINT32_MAX;
+
+    return (num * 100) / den;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_cmake_build(const Host *host, const Job *job, const generator_t generator, const char_t *buildpath, const uint32_t runner_id, String **build_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+static void i_OnBuildLine(BuildScan *scan, const char_t *line)
+{
+    static const char_t *warnmsgs[] = {"warning:", "warning LNK", "warning C"};
+    static const char_t *errmsgs[] = {"error:", "error LNK"};
+    String *fixed = NULL;
+    bool_t is_warn = FALSE, is_error = FALSE;
+    uint32_t progress = UINT32_MAX;
+    cassert_no_null(scan);
+
+    /* Please Apple, don't use non ascii chars in logs */
+    if (scan->ascii_fix == TRUE && str_str(line, "➜") != NULL)
+    {
+        fixed = str_repl(line, "➜", "->", NULL);
+        line = tc(fixed);
+    }
+
+    stm_writef(scan->log, line);
+    stm_writef(scan->log, "\n");
+
+    i_classify_line(line, warnmsgs, sizeof(warnmsgs) / sizeof(char_t *), errmsgs, sizeof(errmsgs) / sizeof(char_t *), &is_warn, &is_error);
+    if (is_warn == TRUE)
+    {
+        stm_writef(scan->warns, line);
+        stm_writef(scan->warns, "\n");
+        scan->nwarns += 1;
+    }
+
+    if (is_error == TRUE)
+    {
+        stm_writef(scan->errors, line);
+        stm_writef(scan->errors, "\n");
+        scan->nerrors += 1;
+        if (scan->nerrors == 1)
+            log_printf("%s Runner %s[%d]%s '%s%s%s' first build error: %s", kASCII_SCHED_FAIL, kASCII_VERSION, scan->runner_id, kASCII_RESET, kASCII_PATH, tc(scan->host->name), kASCII_RESET, line);
+    }
+
+    /* Live progress every quarter */
+    progress = i_build_progress(line);
+    if (progress != UINT32_MAX && progress >= scan->progress + 25)
+    {
+        scan->progress = progress - (progress % 25);
+        log_printf("%s Runner %s[%d]%s '%s%s%s' build %s%d%%%s (%d warnings, %d errors)", kASCII_SCHED, kASCII_VERSION, scan->runner_id, kASCII_RESET, kASCII_PATH, tc(scan->host->name), kASCII_RESET, kASCII_VERSION, progress, kASCII_RESET, scan->nwarns, scan->nerrors);
+    }
+
+    str_destopt(&fixed);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_cmake_build(const Host *host, const Job *job, const generator_t generator, const char_t *buildpath, const uint32_t runner_id, const uint32_t njobs, String **build_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
 {
     bool_t ok = TRUE;
     cassert_no_null(host);
@@ -694,37 +902,41 @@ static bool_t i_cmake_build(const Host *host, const Job *job, const generator_t
     {
         String *cmake_envvars = NULL;
         String *build_opts = NULL;
+        BuildScan scan;
 
-        cmake_envvars = i_cmake_envvars(host, job->tags, generator, 4);
+        cmake_envvars = i_cmake_envvars(host, job->tags, generator, njobs);
 
         if (i_generator_multi_config(generator) == TRUE)
             build_opts = str_printf("--config %s", tc(job->config));
         else
             build_opts = str_c("");
 
-        ssh_cmake_build(&host->login, tc(cmake_envvars), buildpath, tc(build_opts), build_log);
+        scan.host = host;
+        scan.runner_id = runner_id;
+        scan.ascii_fix = (bool_t)(host_macos_version(host) >= ekMACOS_SONOMA);
+        scan.log = stm_memory(2048);
+        scan.warns = stm_memory(1024);
+        scan.errors = stm_memory(1024);
+        scan.nwarns = 0;
+        scan.nerrors = 0;
+        scan.progress = 0;
+
+        ssh_cmake_build(&host->login, tc(cmake_envvars), buildpath, tc(build_opts), i_OnBuildLine, &scan, BuildScan);
         str_destroy(&cmake_envvars);
         str_destroy(&build_opts);
 
-        if (*build_log != NULL)
-        {
-            macos_t macos = host_macos_version(host);
-            if (macos >= ekMACOS_SONOMA)
-            {
-                /* Please Apple, don't use non ascii chars in logs */
-                String *log = str_repl(tc(*build_log), "➜", "->", NULL);
-                str_destroy(build_log);
-                *build_log = log;
-            }
-        }
-    }
-
-    if (ok == TRUE)
-    {
-        const char_t *warnmsgs[] = {"warning:", "warning LNK", "warning C"};
-        const char_t *errmsgs[] = {"error:", "error LNK"};
-        *nwarns = i_get_messages(*build_log, warnmsgs, sizeof(warnmsgs) / sizeof(char_t *), warns);
-        *nerrors = i_get_messages(*build_log, errmsgs, sizeof(errmsgs) / sizeof(char_t *), errors);
+        cassert_no_null(warns);
+        cassert_no_null(errors);
+        cassert(*warns == NULL);
+        cassert(*errors == NULL);
+        *build_log = stm_str(scan.log);
+        *warns = stm_str(scan.warns);
+        *errors = stm_str(scan.errors);
+        *nwarns = scan.nwarns;
+        *nerrors = scan.nerrors;
+        stm_close(&scan.log);
+        stm_close(&scan.warns);
+        stm_close(&scan.errors);
     }
 
     if (ok == TRUE)
@@ -867,6 +1079,7 @@ static bool_t i_cmake_install(const Host *host, const Job *job, const char_t *pr
 static bool_t i_copy_to_drive(const Host *host, const Drive *drive, const Job *job, const char_t *flowpath, const char_t *instpath, const WorkPaths *wpaths, const uint32_t runner_id, String **error_msg)
 {
     bool_t ok = TRUE;
+    bool_t streamed = FALSE;
     String *tarname = NULL;
     String *tarpath = NULL;
     cassert_no_null(host);
@@ -877,21 +1090,31 @@ static bool_t i_copy_to_drive(const Host *host, const Drive *drive, const Job *j
     tarname = str_printf("%s.tar.gz", tc(job->name));
     tarpath = str_path(host->login.platform, "%s/%s", flowpath, tc(tarname));
 
-    if (ok == TRUE)
+    /* Stream the install dir straight into drive, without temporal tarballs */
+    if (i_exist_tag(host->tags, "no-stream") == FALSE)
+    {
+        streamed = ssh_tar_stream(&host->login, instpath, &drive->login, tc(wpaths->drive_path), tc(tarname));
+        if (streamed == TRUE)
+            log_printf("%s Runner %s[%d]%s '%s%s%s' '%s%s%s' streamed into drive", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_TARGET, tc(tarname), kASCII_RESET);
+        else
+            log_printf("%s Runner %s[%d]%s '%s%s%s' streaming '%s' failed. Using tar + copy", kASCII_WARN, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, tc(tarname));
+    }
+
+    if (ok == TRUE && streamed == FALSE)
     {
         ok = ssh_cmake_tar(&host->login, instpath, tc(tarpath));
         if (ok == FALSE)
             *error_msg = str_printf("Error creating '%s'", tc(tarpath));
     }
 
-    if (ok == TRUE)
+    if (ok == TRUE && streamed == FALSE)
     {
         ok = ssh_copy(&host->login, flowpath, tc(tarname), &drive->login, tc(wpaths->drive_path), tc(tarname), i_exist_tag(host->tags, "scp-3"));
         if (ok == FALSE)
             *error_msg = str_printf("Error copying '%s' into '%s'", tc(tarname), tc(wpaths->drive_path));
     }
 
-    if (ok == TRUE)
+    if (ok == TRUE && streamed == FALSE)
         log_printf("%s Runner %s[%d]%s '%s%s%s' '%s%s%s' copied into drive", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_TARGET, tc(tarname), kASCII_RESET);
 
     str_destroy(&tarname);
@@ -901,21 +1124,6 @@ static bool_t i_copy_to_drive(const Host *host, const Drive *drive, const Job *j
 
 /*---------------------------------------------------------------------------*/
 
-static Vers i_cmake_version(const Login *login)
-{
-    Vers vers = {0, 0, 0};
-    Stream *stm = ssh_cmake_version(login);
-    if (stm != NULL)
-    {
-        vers = vers_from_stm(stm);
-        stm_close(&stm);
-    }
-
-    return vers;
-}
-
-/*---------------------------------------------------------------------------*/
-
 static String *i_cmake_make_program(const Host *host, const Job *job, const char_t *tempath, String **error_msg)
 {
     static const char_t *make_envvar = "CMAKE_MAKE_PROGRAM";
@@ -979,20 +1187,176 @@ static String *i_cmake_make_program(const Host *host, const Job *job, const char
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_run_build(const Host *host, const Drive *drive, const char_t *project, const Job *job, const WorkPaths *wpaths, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+static String *i_source_path(const Host *host, const char_t *flowid, const char_t *kind, const uint32_t repo_vers)
+{
+    cassert_no_null(host);
+    return str_path(host->login.platform, "%s/%s/%s_r%d", tc(host->workpath), flowid, kind, repo_vers);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Build tree is reused while the toolchain (cmake and compiler) doesn't change */
+static uint32_t i_incremental_key(const Job *job, const HostCaps *caps)
+{
+    const Vers *cmake_vers = hostcaps_cmake_vers(caps);
+    String *str = NULL;
+    uint32_t key = 0;
+    cassert_no_null(job);
+    str = str_printf("%d.%d.%d|%s|%s|%s|%s", cmake_vers->major, cmake_vers->minor, cmake_vers->patch, hostcaps_compiler(caps), tc(job->generator), tc(job->config), tc(job->opts));
+    key = bhash_from_block(cast_const(tc(str), byte_t), str_len(str));
+    str_destroy(&str);
+    return key;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_incremental_stamp(const Host *host, const char_t *incpath, uint32_t *key, uint32_t *nbuilds)
+{
+    bool_t ok = FALSE;
+    cassert_no_null(host);
+    cassert_no_null(key);
+    cassert_no_null(nbuilds);
+    if (ssh_file_exists(&host->login, incpath, i_INCREMENTAL_STAMP) == TRUE)
+    {
+        Stream *stm = ssh_file_cat(&host->login, incpath, i_INCREMENTAL_STAMP);
+        if (stm != NULL)
+        {
+            const char_t *line = stm_read_trim(stm);
+            String *skey = NULL;
+            String *sbuilds = NULL;
+            if (line != NULL && str_split_trim(line, " ", &skey, &sbuilds) == TRUE)
+            {
+                bool_t err1 = FALSE, err2 = FALSE;
+                *key = str_to_u32(tc(skey), 16, &err1);
+                *nbuilds = str_to_u32(tc(sbuilds), 10, &err2);
+                ok = (bool_t)(err1 == FALSE && err2 == FALSE);
+            }
+
+            str_destopt(&skey);
+            str_destopt(&sbuilds);
+            stm_close(&stm);
+        }
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Persistent source and build trees for the job 'workpath/flowid/jobname-INC'.
+ * Only changed sources are updated, so CMake and the native build tool rebuild
+ * the minimum. A clean build is forced when the toolchain changes or every 'clean_loops'.
+ */
+static bool_t i_incremental_tree(const Host *host, const Job *job, const char_t *incpath, const char_t *srcpath, const HostCaps *caps, const uint32_t clean_loops, const uint32_t runner_id, uint32_t *key, uint32_t *nbuilds, bool_t *warm, String **error_msg)
 {
     bool_t ok = TRUE;
-    Vers cmake_vers;
+    uint32_t skey = 0, sbuilds = 0;
+    String *incsrc = NULL;
+    String *incbuild = NULL;
+    cassert_no_null(host);
+    cassert_no_null(key);
+    cassert_no_null(nbuilds);
+    cassert_no_null(warm);
+    cassert_no_null(error_msg);
+    cassert(*error_msg == NULL);
+    incsrc = str_path(host->login.platform, "%s/src", incpath);
+    incbuild = str_path(host->login.platform, "%s/build", incpath);
+    *key = i_incremental_key(job, caps);
+    *warm = FALSE;
+    *nbuilds = 0;
+
+    if (i_incremental_stamp(host, incpath, &skey, &sbuilds) == TRUE)
+    {
+        if (skey == *key && (clean_loops == 0 || sbuilds < clean_loops))
+            *warm = ssh_dir_exists(&host->login, tc(incbuild));
+    }
+
+    if (*warm == TRUE)
+    {
+        *nbuilds = sbuilds;
+    }
+    else if (ssh_dir_exists(&host->login, incpath) == TRUE)
+    {
+        ok = ssh_delete_dir(&host->login, incpath);
+        if (ok == FALSE)
+            *error_msg = str_printf("Error removing host '%s' directory '%s'", tc(host->name), incpath);
+    }
+
+    if (ok == TRUE)
+    {
+        SSHBatch *batch = ssh_batch_create(&host->login);
+        ssh_batch_create_dir(batch, tc(incsrc));
+        ssh_batch_create_dir(batch, tc(incbuild));
+        ok = ssh_batch_run(batch);
+        if (ok == FALSE)
+            *error_msg = str_printf("Error creating host '%s' directory '%s'", tc(host->name), incpath);
+        ssh_batch_destroy(&batch);
+    }
+
+    if (ok == TRUE)
+    {
+        ok = ssh_cmake_sync(&host->login, srcpath, tc(incsrc), incpath);
+        if (ok == FALSE)
+            *error_msg = str_printf("Error updating '%s' from '%s'", tc(incsrc), srcpath);
+    }
+
+    if (ok == TRUE)
+    {
+        if (*warm == TRUE)
+            log_printf("%s Runner %s[%d]%s '%s%s%s' warm build '%s%s%s' (%d since clean)", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_TARGET, tc(job->name), kASCII_RESET, *nbuilds);
+        else
+            log_printf("%s Runner %s[%d]%s '%s%s%s' cold build '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_TARGET, tc(job->name), kASCII_RESET);
+    }
+
+    str_destroy(&incsrc);
+    str_destroy(&incbuild);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_incremental_end(const Host *host, const char_t *incpath, const uint32_t key, const uint32_t nbuilds, const bool_t build_ok)
+{
+    cassert_no_null(host);
+    /* A failed build tree is not trusted by the next loop */
+    if (build_ok == TRUE)
+    {
+        String *content = str_printf("%08x %d", key, nbuilds + 1);
+        ssh_create_file(&host->login, incpath, i_INCREMENTAL_STAMP, tc(content));
+        str_destroy(&content);
+    }
+    else if (ssh_file_exists(&host->login, incpath, i_INCREMENTAL_STAMP) == TRUE)
+    {
+        String *stamp = str_path(host->login.platform, "%s/%s", incpath, i_INCREMENTAL_STAMP);
+        ssh_delete_file(&host->login, tc(stamp));
+        str_destroy(&stamp);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_run_build(const Host *host, HostCaps *caps, const Drive *drive, const Global *global, const Job *job, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+{
+    bool_t ok = TRUE;
+    const Vers *cmake_vers = NULL;
     String *flowpath = NULL;
     String *srcpath = NULL;
     String *buildpath = NULL;
     String *instpath = NULL;
+    String *incpath = NULL;
     String *makeprogram = NULL;
+    uint32_t inckey = 0, nbuilds = 0;
     generator_t generator;
     cassert_no_null(host);
+    cassert_no_null(global);
     cassert_no_null(job);
+    cassert_no_null(warm);
+    *warm = FALSE;
+    /* cmake errors are detected by the configure step */
+    cmake_vers = hostcaps_cmake_vers(caps);
     flowpath = str_path(host->login.platform, "%s/%s/%s", tc(host->workpath), flowid, tc(job->name));
-    srcpath = str_path(host->login.platform, "%s/src", tc(flowpath));
+    srcpath = i_source_path(host, flowid, "src", repo_vers);
     buildpath = str_path(host->login.platform, "%s/build", tc(flowpath));
     instpath = str_path(host->login.platform, "%s/install", tc(flowpath));
     generator = i_generator(tc(job->generator));
@@ -1008,11 +1372,22 @@ static bool_t i_run_build(const Host *host, const Drive *drive, const char_t *pr
     if (ok == TRUE)
         ok = i_create_build_dirs(host, tc(flowpath), runner_id, error_msg);
 
-    if (ok == TRUE)
-        ok = i_get_source_package(host, wpaths, tc(flowpath), NBUILD_SRC_TAR, tc(srcpath), runner_id, error_msg);
-
-    if (ok == TRUE)
-        cmake_vers = i_cmake_version(&host->login);
+    if (ok == TRUE && global->incremental == TRUE)
+    {
+        incpath = str_path(host->login.platform, "%s/%s/%s-INC", tc(host->workpath), flowid, tc(job->name));
+        ok = i_incremental_tree(host, job, tc(incpath), tc(srcpath), caps, global->clean_loops, runner_id, &inckey, &nbuilds, warm, error_msg);
+        if (ok == TRUE)
+        {
+            str_destroy(&srcpath);
+            str_destroy(&buildpath);
+            srcpath = str_path(host->login.platform, "%s/src", tc(incpath));
+            buildpath = str_path(host->login.platform, "%s/build", tc(incpath));
+        }
+        else
+        {
+            str_destroy(&incpath);
+        }
+    }
 
     if (ok == TRUE)
     {
@@ -1020,14 +1395,21 @@ static bool_t i_run_build(const Host *host, const Drive *drive, const char_t *pr
          * cmake versions lower than 3.15.0 doesn't have the --install option
          * we need use the native build command to install
          */
-        if (vers_lt(&cmake_vers, 3, 15, 0) == TRUE)
+        if (vers_lt(cmake_vers, 3, 15, 0) == TRUE)
         {
-            String *tempath = str_path(host->login.platform, "%s/makeprog", tc(flowpath));
-            makeprogram = i_cmake_make_program(host, job, tc(tempath), error_msg);
-            str_destroy(&tempath);
-
+            /* Probed once per generator while the host is running */
+            makeprogram = hostcaps_make_program(caps, tc(job->generator));
             if (makeprogram == NULL)
-                ok = FALSE;
+            {
+                String *tempath = str_path(host->login.platform, "%s/makeprog", tc(flowpath));
+                makeprogram = i_cmake_make_program(host, job, tc(tempath), error_msg);
+                str_destroy(&tempath);
+
+                if (makeprogram != NULL)
+                    hostcaps_add_make_program(caps, tc(job->generator), tc(makeprogram));
+                else
+                    ok = FALSE;
+            }
         }
     }
 
@@ -1035,10 +1417,13 @@ static bool_t i_run_build(const Host *host, const Drive *drive, const char_t *pr
         ok = i_cmake_configure(host, job, generator, tc(srcpath), tc(buildpath), tc(instpath), runner_id, cmake_log, error_msg);
 
     if (ok == TRUE)
-        ok = i_cmake_build(host, job, generator, tc(buildpath), runner_id, build_log, warns, errors, nwarns, nerrors, error_msg);
+        ok = i_cmake_build(host, job, generator, tc(buildpath), runner_id, njobs, build_log, warns, errors, nwarns, nerrors, error_msg);
+
+    if (incpath != NULL)
+        i_incremental_end(host, tc(incpath), inckey, nbuilds, ok);
 
     if (ok == TRUE)
-        ok = i_cmake_install(host, job, project, generator, &cmake_vers, tc(makeprogram), tc(buildpath), tc(instpath), runner_id, install_log, error_msg);
+        ok = i_cmake_install(host, job, tc(global->project), generator, cmake_vers, tc(makeprogram), tc(buildpath), tc(instpath), runner_id, install_log, error_msg);
 
     if (ok == TRUE)
         ok = i_copy_to_drive(host, drive, job, tc(flowpath), tc(instpath), wpaths, runner_id, error_msg);
@@ -1047,6 +1432,7 @@ static bool_t i_run_build(const Host *host, const Drive *drive, const char_t *pr
     str_destroy(&srcpath);
     str_destroy(&buildpath);
     str_destroy(&instpath);
+    str_destopt(&incpath);
     str_destopt(&makeprogram);
     return ok;
 }
@@ -1086,78 +1472,219 @@ static String *i_test_envvars(const Host *host, const generator_t generator, con
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_execute_test(const Host *host, const Job *job, const char_t *buildpath, const char_t *envvars, const char_t *exec, Stream *stm, String **error_msg)
+static String *i_test_cmd(const Host *host, const Job *job, const char_t *buildpath, const char_t *envvars, const char_t *exec, const uint32_t timeout)
 {
-    bool_t ok = TRUE;
     String *cmd = NULL;
-    String *log = NULL;
-    uint32_t ret = UINT32_MAX;
+    String *tcmd = NULL;
     cassert_no_null(host);
     cassert_no_null(job);
-    cassert_no_null(error_msg);
     cmd = str_path(host->login.platform, "%s/%s/bin/%s", buildpath, tc(job->config), exec);
+
+    /* The test is killed in the remote host when time limit is reached */
+    switch (host->login.platform)
+    {
+    case ekLINUX:
+        tcmd = str_printf("timeout -k 10 %d %s", timeout, tc(cmd));
+        break;
+
+    case ekMACOS:
+        tcmd = str_printf("perl -e \"alarm shift; exec @ARGV\" %d %s", timeout, tc(cmd));
+        break;
+
+    case ekWINDOWS:
+        /* No standard timeout launcher. Only the local watchdog */
+        tcmd = str_copy(cmd);
+        break;
+
+    default:
+        cassert_default(host->login.platform);
+    }
+
+    str_destroy(&cmd);
+
     if (str_empty_c(envvars) == FALSE)
     {
         String *ncmd = NULL;
         if (host->login.platform == ekWINDOWS)
-            ncmd = str_printf("%s&%s", envvars, tc(cmd));
+            ncmd = str_printf("%s&%s", envvars, tc(tcmd));
         else
-            ncmd = str_printf("%s;%s", envvars, tc(cmd));
-        str_destroy(&cmd);
-        cmd = ncmd;
+            ncmd = str_printf("%s;%s", envvars, tc(tcmd));
+        str_destroy(&tcmd);
+        tcmd = ncmd;
     }
 
-    ret = ssh_execute_cmd(&host->login, tc(cmd), &log);
-    if (ret == 0)
-    {
-        stm_writef(stm, tc(log));
-        stm_writef(stm, "\n");
-    }
+    return tcmd;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_execute_test(const Host *host, const Job *job, const char_t *buildpath, const char_t *envvars, const Target *test, RTest *rtest)
+{
+    uint32_t timeout = 0;
+    uint64_t init = 0;
+    bool_t expired = FALSE;
+    String *cmd = NULL;
+    cassert_no_null(host);
+    cassert_no_null(test);
+    cassert_no_null(rtest);
+    timeout = test->timeout > 0 ? test->timeout : i_TEST_TIMEOUT;
+    cmd = i_test_cmd(host, job, buildpath, envvars, tc(test->exec), timeout);
+    init = btime_now();
+    rtest->ret = ssh_execute_cmd_timeout(&host->login, tc(cmd), timeout + i_TEST_GRACE, &expired, &rtest->log);
+    rtest->seconds = (uint32_t)((btime_now() - init) / 1000000);
+    rtest->timeout = (bool_t)(expired == TRUE || (rtest->ret != 0 && rtest->seconds >= timeout));
+
+    if (rtest->timeout == TRUE)
+        log_printf("%s Test '%s%s%s' timeout after %ds", kASCII_FAIL, kASCII_TARGET, tc(test->exec), kASCII_RESET, rtest->seconds);
+    else if (rtest->ret != 0)
+        log_printf("%s Test '%s%s%s' exit %d in %ds", kASCII_FAIL, kASCII_TARGET, tc(test->exec), kASCII_RESET, rtest->ret, rtest->seconds);
     else
+        log_printf("%s Test '%s%s%s' in %ds", kASCII_OK, kASCII_TARGET, tc(test->exec), kASCII_RESET, rtest->seconds);
+
+    str_destroy(&cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_test_thread(TestRun *run)
+{
+    bool_t end = FALSE;
+    cassert_no_null(run);
+    while (end == FALSE)
     {
-        ok = FALSE;
-        *error_msg = str_printf("%s: Fatal error running test '%s'", exec, tc(log));
+        uint32_t i = UINT32_MAX;
+        bmutex_lock(run->mutex);
+        if (run->next < arrst_size(run->results, RTest))
+        {
+            i = run->next;
+            run->next += 1;
+        }
+        bmutex_unlock(run->mutex);
+
+        if (i != UINT32_MAX)
+        {
+            const uint32_t *target_id = arrst_get_const(run->targets, i, uint32_t);
+            const Target *test = arrst_get_const(run->tests, *target_id, Target);
+            RTest *rtest = arrst_get(run->results, i, RTest);
+            i_execute_test(run->host, run->job, run->buildpath, run->envvars, test, rtest);
+        }
+        else
+        {
+            end = TRUE;
+        }
     }
 
-    str_destroy(&cmd);
-    str_destroy(&log);
-    return ok;
+    return 0;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_execute_tests(const Host *host, const Job *job, const generator_t generator, const char_t *buildpath, const char_t *instpath, const ArrSt(Target) *tests, String **test_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+static bool_t i_execute_tests(const Host *host, const Job *job, const generator_t generator, const char_t *buildpath, const char_t *instpath, const ArrSt(Target) *tests, const uint32_t njobs, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
 {
     String *envvars = i_test_envvars(host, generator, instpath);
+    ArrSt(uint32_t) *targets = arrst_create(uint32_t);
     Stream *stm = stm_memory(2048);
+    Stream *fails = stm_memory(256);
+    uint32_t i, nthreads = 0;
     bool_t ok = TRUE;
+    cassert_no_null(host);
     cassert_no_null(job);
-    cassert_no_null(test_log);
     cassert_no_null(warns);
     cassert_no_null(errors);
     cassert_no_null(nwarns);
     cassert_no_null(nerrors);
+    cassert_no_null(error_msg);
+    cassert(arrst_size(results, RTest) == 0);
 
+    /* Results in declaration order */
     arrst_foreach_const(test, tests, Target)
         if (str_empty(test->exec) == FALSE)
         {
-            ok = i_execute_test(host, job, buildpath, tc(envvars), tc(test->exec), stm, error_msg);
-            if (ok == FALSE)
-                break;
+            RTest *rtest = arrst_new(results, RTest);
+            dbind_init(rtest, RTest);
+            str_upd(&rtest->name, tc(test->exec));
+            arrst_append(targets, test_i, uint32_t);
         }
     arrst_end()
 
-    if (ok == TRUE)
+    nthreads = host->test_jobs > 0 ? host->test_jobs : njobs;
+    if (nthreads == 0)
+        nthreads = 1;
+    if (nthreads > arrst_size(results, RTest))
+        nthreads = arrst_size(results, RTest);
+
+    if (nthreads > 0)
+    {
+        TestRun run;
+        Thread **threads = heap_new_n(nthreads, Thread *);
+        run.host = host;
+        run.job = job;
+        run.buildpath = buildpath;
+        run.envvars = tc(envvars);
+        run.tests = tests;
+        run.targets = targets;
+        run.results = results;
+        run.next = 0;
+        run.mutex = bmutex_create();
+
+        /* The current thread is also a test launcher */
+        for (i = 1; i < nthreads; ++i)
+            threads[i] = bthread_create(i_test_thread, &run, TestRun);
+
+        i_test_thread(&run);
+
+        for (i = 1; i < nthreads; ++i)
+        {
+            bthread_wait(threads[i]);
+            bthread_close(&threads[i]);
+        }
+
+        bmutex_close(&run.mutex);
+        heap_delete_n(&threads, nthreads, Thread *);
+    }
+
+    /* Merge test logs and encode each one */
+    arrst_foreach(rtest, results, RTest)
+        String *b64 = NULL;
+        stm_writef(stm, tc(rtest->log));
+        stm_writef(stm, "\n");
+
+        if (rtest->timeout == TRUE)
+        {
+            stm_printf(fails, "%s'%s' timeout after %ds", ok == TRUE ? "" : ", ", tc(rtest->name), rtest->seconds);
+            ok = FALSE;
+        }
+        else if (rtest->ret != 0)
+        {
+            stm_printf(fails, "%s'%s' exit %d", ok == TRUE ? "" : ", ", tc(rtest->name), rtest->ret);
+            ok = FALSE;
+        }
+
+        b64 = b64_encode_from_str(rtest->log);
+        str_destroy(&rtest->log);
+        rtest->log = b64;
+    arrst_end()
+
     {
         const char_t *warnmsgs[] = {"[WARN]"};
         const char_t *errmsgs[] = {"[FAIL]"};
-        *test_log = stm_str(stm);
-        *nwarns = i_get_messages(*test_log, warnmsgs, sizeof(warnmsgs) / sizeof(char_t *), warns);
-        *nerrors = i_get_messages(*test_log, errmsgs, sizeof(errmsgs) / sizeof(char_t *), errors);
+        String *test_log = stm_str(stm);
+        i_get_messages(test_log, warnmsgs, sizeof(warnmsgs) / sizeof(char_t *), errmsgs, sizeof(errmsgs) / sizeof(char_t *), warns, errors, nwarns, nerrors);
+        str_destroy(&test_log);
+    }
+
+    if (ok == FALSE)
+    {
+        String *msg = stm_str(fails);
+        cassert(*error_msg == NULL);
+        *error_msg = str_printf("Fatal error running tests: %s", tc(msg));
+        str_destroy(&msg);
     }
 
     str_destroy(&envvars);
+    arrst_destroy(&targets, NULL, uint32_t);
     stm_close(&stm);
+    stm_close(&fails);
     return ok;
 }
 
@@ -1208,7 +1735,7 @@ static String *i_unify_b64(String **str1, String **str2, const uint32_t v1, cons
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **test_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
 {
     bool_t ok = TRUE;
     String *flowpath = NULL;
@@ -1229,7 +1756,7 @@ static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *
     cassert_no_null(nwarns);
     cassert_no_null(nerrors);
     flowpath = str_path(host->login.platform, "%s/%s/%s", tc(host->workpath), flowid, tc(job->name));
-    testpath = str_path(host->login.platform, "%s/test", tc(flowpath));
+    testpath = i_source_path(host, flowid, "test", repo_vers);
     buildpath = str_path(host->login.platform, "%s/test_build", tc(flowpath));
     instpath = str_path(host->login.platform, "%s/install", tc(flowpath));
     generator = i_generator(tc(job->generator));
@@ -1242,9 +1769,6 @@ static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *
         ok = FALSE;
     }
 
-    if (ok == TRUE)
-        ok = i_get_source_package(host, wpaths, tc(flowpath), NBUILD_TEST_TAR, tc(testpath), runner_id, error_msg);
-
     if (ok == TRUE)
     {
         String *opts = str_copy(job->opts);
@@ -1257,18 +1781,10 @@ static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *
     }
 
     if (ok == TRUE)
-        ok = i_cmake_build(host, job, generator, tc(buildpath), runner_id, build_log, &warbuild, &errbuild, &nwarbuild, &nerrbuild, error_msg);
+        ok = i_cmake_build(host, job, generator, tc(buildpath), runner_id, njobs, build_log, &warbuild, &errbuild, &nwarbuild, &nerrbuild, error_msg);
 
     if (ok == TRUE)
-    {
-        ok = i_execute_tests(host, job, generator, tc(buildpath), tc(instpath), tests, test_log, &wartest, &errtest, &nwartest, &nerrtest, error_msg);
-        if (str_empty(*test_log) == FALSE)
-        {
-            String *b64 = b64_encode_from_str(*test_log);
-            str_destroy(test_log);
-            *test_log = b64;
-        }
-    }
+        ok = i_execute_tests(host, job, generator, tc(buildpath), tc(instpath), tests, njobs, results, &wartest, &errtest, &nwartest, &nerrtest, error_msg);
 
     *warns = i_unify_b64(&warbuild, &wartest, nwarbuild, nwartest, nwarns);
     *errors = i_unify_b64(&errbuild, &errtest, nerrbuild, nerrtest, nerrors);
@@ -1281,16 +1797,173 @@ static bool_t i_run_test(const Host *host, const Job *job, const ArrSt(Target) *
 
 /*---------------------------------------------------------------------------*/
 
-bool_t host_run_build(const Host *host, const Drive *drive, const Job *job, const char_t *project, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+HostCaps *host_probe_caps(const Host *host)
+{
+    SSHBatch *batch = NULL;
+    uint32_t ncpus = 0, free_mb = 0;
+    Vers cmake_vers = {0, 0, 0};
+    String *compiler = NULL;
+    uint32_t step_ncpus, step_disk = UINT32_MAX, step_cc = UINT32_MAX, step_cmake;
+    HostCaps *caps = NULL;
+    cassert_no_null(host);
+
+    /*
+     * One round-trip after boot. The batch stops at the first failure,
+     * so optional probes can't fail and cmake goes at the end.
+     * Free disk and compiler are not probed in Windows (cl needs the VS environment).
+     */
+    batch = ssh_batch_create(&host->login);
+    ssh_batch_create_dir(batch, tc(host->workpath));
+    step_ncpus = ssh_batch_ncpus(batch);
+    if (host->login.platform != ekWINDOWS)
+    {
+        String *cmd = str_printf("df -Pk %s | tail -1 | tr -s \" \" | cut -d\" \" -f4 || true", tc(host->workpath));
+        step_disk = ssh_batch_add(batch, &cmd);
+        cmd = str_c("cc --version 2>/dev/null | head -1 || true");
+        step_cc = ssh_batch_add(batch, &cmd);
+    }
+
+    {
+        String *cmd = str_c("cmake --version");
+        step_cmake = ssh_batch_add(batch, &cmd);
+    }
+
+    ssh_batch_run(batch);
+
+    if (ssh_batch_ret(batch, step_ncpus) == 0)
+    {
+        bool_t err = FALSE;
+        String *out = str_trim(ssh_batch_output(batch, step_ncpus));
+        ncpus = str_to_u32(tc(out), 10, &err);
+        if (err == TRUE)
+            ncpus = 0;
+        str_destroy(&out);
+    }
+
+    if (step_disk != UINT32_MAX && ssh_batch_ret(batch, step_disk) == 0)
+    {
+        bool_t err = FALSE;
+        String *out = str_trim(ssh_batch_output(batch, step_disk));
+        free_mb = str_to_u32(tc(out), 10, &err) / 1024;
+        if (err == TRUE)
+            free_mb = 0;
+        str_destroy(&out);
+    }
+
+    if (step_cc != UINT32_MAX && ssh_batch_ret(batch, step_cc) == 0)
+        compiler = str_trim(ssh_batch_output(batch, step_cc));
+
+    if (ssh_batch_ret(batch, step_cmake) == 0)
+    {
+        const char_t *out = ssh_batch_output(batch, step_cmake);
+        Stream *stm = stm_from_block(cast_const(out, byte_t), str_len_c(out));
+        cmake_vers = vers_from_stm(stm);
+        stm_close(&stm);
+    }
+
+    ssh_batch_destroy(&batch);
+    caps = hostcaps_create(ncpus, &cmake_vers, free_mb, tc(compiler));
+    str_destopt(&compiler);
+    return caps;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t host_prepare_sources(const Host *host, const WorkPaths *wpaths, const char_t *flowid, const char_t *kind, const char_t *tarname, const uint32_t repo_vers, const uint32_t runner_id, String **error_msg)
+{
+    bool_t ok = TRUE;
+    bool_t ready = FALSE;
+    String *rootpath = NULL;
+    String *treepath = NULL;
+    String *marker = NULL;
+    String *current = NULL;
+    String *vers = NULL;
+    cassert_no_null(host);
+    cassert_no_null(error_msg);
+    cassert(*error_msg == NULL);
+    rootpath = str_path(host->login.platform, "%s/%s", tc(host->workpath), flowid);
+    treepath = i_source_path(host, flowid, kind, repo_vers);
+    marker = str_printf("%s_vers.txt", kind);
+    vers = str_printf("r%d", repo_vers);
+
+    /* The marker is written after a complete untar, so it never points to a partial tree */
+    if (ssh_file_exists(&host->login, tc(rootpath), tc(marker)) == TRUE)
+    {
+        Stream *stm = ssh_file_cat(&host->login, tc(rootpath), tc(marker));
+        if (stm != NULL)
+        {
+            const char_t *token = stm_read_trim(stm);
+            if (token != NULL)
+                current = str_c(token);
+            stm_close(&stm);
+        }
+    }
+
+    if (current != NULL && str_equ(current, tc(vers)) == TRUE)
+        ready = ssh_dir_exists(&host->login, tc(treepath));
+
+    if (ready == FALSE)
+    {
+        String *markpath = str_path(host->login.platform, "%s/%s", tc(rootpath), tc(marker));
+        String *tarpath = str_path(host->login.platform, "%s/%s", tc(rootpath), tarname);
+
+        if (ssh_file_exists(&host->login, tc(rootpath), tc(marker)) == TRUE)
+            ssh_delete_file(&host->login, tc(markpath));
+
+        /* Source tree of a previous repo version */
+        if (str_empty(current) == FALSE && str_equ(current, tc(vers)) == FALSE)
+        {
+            String *oldpath = str_path(host->login.platform, "%s/%s_%s", tc(rootpath), kind, tc(current));
+            if (ssh_dir_exists(&host->login, tc(oldpath)) == TRUE)
+                ssh_delete_dir(&host->login, tc(oldpath));
+            str_destroy(&oldpath);
+        }
+
+        /* Partial tree of an interrupted untar */
+        if (ssh_dir_exists(&host->login, tc(treepath)) == TRUE)
+            ssh_delete_dir(&host->login, tc(treepath));
+
+        ok = ssh_create_dir(&host->login, tc(rootpath));
+        if (ok == FALSE)
+            *error_msg = str_printf("Error creating '%s'", tc(rootpath));
+
+        if (ok == TRUE)
+            ok = i_get_source_package(host, wpaths, tc(rootpath), tarname, tc(treepath), runner_id, error_msg);
+
+        if (ok == TRUE)
+        {
+            ssh_delete_file(&host->login, tc(tarpath));
+            ok = ssh_create_file(&host->login, tc(rootpath), tc(marker), tc(vers));
+            if (ok == FALSE)
+                *error_msg = str_printf("Error writing '%s' in '%s'", tc(marker), tc(rootpath));
+        }
+
+        str_destroy(&markpath);
+        str_destroy(&tarpath);
+    }
+    else
+    {
+        log_printf("%s Runner %s[%d]%s '%s%s%s' reusing '%s%s%s' source tree", kASCII_SCHED, kASCII_VERSION, runner_id, kASCII_RESET, kASCII_PATH, tc(host->name), kASCII_RESET, kASCII_PATH, tc(treepath), kASCII_RESET);
+    }
+
+    str_destroy(&rootpath);
+    str_destroy(&treepath);
+    str_destroy(&marker);
+    str_destopt(&current);
+    str_destroy(&vers);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t host_run_build(const Host *host, HostCaps *caps, const Drive *drive, const Job *job, const Global *global, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
 {
-    unref(repo_vers);
-    return i_run_build(host, drive, project, job, wpaths, flowid, runner_id, cmake_log, build_log, install_log, warns, errors, nwarns, nerrors, error_msg);
+    return i_run_build(host, caps, drive, global, job, wpaths, repo_vers, flowid, runner_id, njobs, warm, cmake_log, build_log, install_log, warns, errors, nwarns, nerrors, error_msg);
 }
 
 /*---------------------------------------------------------------------------*/
 
-bool_t host_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+bool_t host_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
 {
-    unref(repo_vers);
-    return i_run_test(host, job, tests, wpaths, flowid, runner_id, cmake_log, build_log, install_log, warns, errors, nwarns, nerrors, error_msg);
+    return i_run_test(host, job, tests, repo_vers, flowid, runner_id, njobs, cmake_log, build_log, results, warns, errors, nwarns, nerrors, error_msg);
 }
@@ -36,11 +36,17 @@ const char_t *host_macos_host(const Host *host);
 
 const char_t *host_macos_volume(const Host *host);
 
+uint32_t host_slots(const Host *host);
+
+uint32_t host_njobs(const Host *host);
+
+uint32_t host_keepalive(const Host *host);
+
 const Login *host_login(const Host *host);
 
 void host_localhost(ArrSt(Host) *hosts, const ArrSt(uint32_t) *ips);
 
-const Host *host_match_job(const ArrSt(Host) *hosts, const Job *job);
+bool_t host_can_run_job(const Host *host, const Job *job);
 
 const Host *host_by_name(const ArrSt(Host) *hosts, const char_t *name);
 
@@ -48,6 +54,10 @@ const Host *host_macos_alive(const ArrSt(Host) *hosts, const char_t *macos_host)
 
 macos_t host_macos_version(const Host *host);
 
-bool_t host_run_build(const Host *host, const Drive *drive, const Job *job, const char_t *project, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
+HostCaps *host_probe_caps(const Host *host);
+
+bool_t host_prepare_sources(const Host *host, const WorkPaths *wpaths, const char_t *flowid, const char_t *kind, const char_t *tarname, const uint32_t repo_vers, const uint32_t runner_id, String **error_msg);
+
+bool_t host_run_build(const Host *host, HostCaps *caps, const Drive *drive, const Job *job, const Global *global, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
 
-bool_t host_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
+bool_t host_run_test(const Host *host, const Job *job, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
@@ -0,0 +1,158 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hostcaps.c
+ *
+ */
+
+/* Toolchain capabilities of a booted host */
+
+#include "hostcaps.h"
+#include <nlib/nlib.h>
+#include <core/arrst.h>
+#include <core/heap.h>
+#include <core/strings.h>
+#include <osbs/bmutex.h>
+#include <sewer/cassert.h>
+
+typedef struct _makeprog_t MakeProg;
+
+struct _makeprog_t
+{
+    String *generator;
+    String *makeprogram;
+};
+
+DeclSt(MakeProg);
+
+/*
+ * Probed once after boot. The answers don't change while the host is running.
+ * A new boot (maybe a different toolchain) creates a new cache.
+ */
+struct _hostcaps_t
+{
+    uint32_t ncpus;
+    Vers cmake_vers;
+    /* Free space in host workpath (0 unknown) */
+    uint32_t free_mb;
+    String *compiler;
+    /* Make program by generator. Filled on demand by concurrent slots */
+    Mutex *mutex;
+    ArrSt(MakeProg) *makeprogs;
+};
+
+/*---------------------------------------------------------------------------*/
+
+HostCaps *hostcaps_create(const uint32_t ncpus, const Vers *cmake_vers, const uint32_t free_mb, const char_t *compiler)
+{
+    HostCaps *caps = heap_new0(HostCaps);
+    cassert_no_null(cmake_vers);
+    caps->ncpus = ncpus;
+    caps->cmake_vers = *cmake_vers;
+    caps->free_mb = free_mb;
+    caps->compiler = str_c(compiler);
+    caps->mutex = bmutex_create();
+    caps->makeprogs = arrst_create(MakeProg);
+    return caps;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_makeprog(MakeProg *makeprog)
+{
+    cassert_no_null(makeprog);
+    str_destroy(&makeprog->generator);
+    str_destroy(&makeprog->makeprogram);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hostcaps_destroy(HostCaps **caps)
+{
+    cassert_no_null(caps);
+    cassert_no_null(*caps);
+    str_destroy(&(*caps)->compiler);
+    arrst_destroy(&(*caps)->makeprogs, i_remove_makeprog, MakeProg);
+    bmutex_close(&(*caps)->mutex);
+    heap_delete(caps, HostCaps);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t hostcaps_ncpus(const HostCaps *caps)
+{
+    cassert_no_null(caps);
+    return caps->ncpus;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const Vers *hostcaps_cmake_vers(const HostCaps *caps)
+{
+    cassert_no_null(caps);
+    return &caps->cmake_vers;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t hostcaps_free_mb(const HostCaps *caps)
+{
+    cassert_no_null(caps);
+    return caps->free_mb;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *hostcaps_compiler(const HostCaps *caps)
+{
+    cassert_no_null(caps);
+    return tc(caps->compiler);
+}
+
+/*---------------------------------------------------------------------------*/
+
+String *hostcaps_make_program(const HostCaps *caps, const char_t *generator)
+{
+    String *makeprogram = NULL;
+    cassert_no_null(caps);
+    bmutex_lock(caps->mutex);
+    arrst_foreach_const(makeprog, caps->makeprogs, MakeProg)
+        if (str_equ(makeprog->generator, generator) == TRUE)
+        {
+            makeprogram = str_copy(makeprog->makeprogram);
+            break;
+        }
+    arrst_end()
+    bmutex_unlock(caps->mutex);
+    return makeprogram;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hostcaps_add_make_program(HostCaps *caps, const char_t *generator, const char_t *makeprogram)
+{
+    bool_t exists = FALSE;
+    cassert_no_null(caps);
+    bmutex_lock(caps->mutex);
+
+    /* Two slots can probe the same generator at the same time */
+    arrst_foreach_const(makeprog, caps->makeprogs, MakeProg)
+        if (str_equ(makeprog->generator, generator) == TRUE)
+        {
+            exists = TRUE;
+            break;
+        }
+    arrst_end()
+
+    if (exists == FALSE)
+    {
+        MakeProg *makeprog = arrst_new(caps->makeprogs, MakeProg);
+        makeprog->generator = str_c(generator);
+        makeprog->makeprogram = str_c(makeprogram);
+    }
+
+    bmutex_unlock(caps->mutex);
+}
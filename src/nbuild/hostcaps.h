@@ -0,0 +1,29 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hostcaps.h
+ *
+ */
+
+/* Toolchain capabilities of a booted host */
+
+#include "nbuild.hxx"
+
+HostCaps *hostcaps_create(const uint32_t ncpus, const Vers *cmake_vers, const uint32_t free_mb, const char_t *compiler);
+
+void hostcaps_destroy(HostCaps **caps);
+
+uint32_t hostcaps_ncpus(const HostCaps *caps);
+
+const Vers *hostcaps_cmake_vers(const HostCaps *caps);
+
+uint32_t hostcaps_free_mb(const HostCaps *caps);
+
+const char_t *hostcaps_compiler(const HostCaps *caps);
+
+String *hostcaps_make_program(const HostCaps *caps, const char_t *generator);
+
+void hostcaps_add_make_program(HostCaps *caps, const char_t *generator, const char_t *makeprogram);
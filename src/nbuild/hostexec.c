@@ -0,0 +1,356 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hostexec.c
+ *
+ */
+
+/* Host execution backend */
+
+#include "hostexec.h"
+#include "host.h"
+#include "nboot.h"
+#include "nbuild.h"
+#include <nlib/nlib.h>
+#include <nlib/ssh.h>
+#include <core/arrst.h>
+#include <core/heap.h>
+#include <core/hfile.h>
+#include <core/stream.h>
+#include <core/strings.h>
+#include <osbs/bfile.h>
+#include <osbs/btime.h>
+#include <osbs/bthread.h>
+#include <osbs/log.h>
+#include <sewer/cassert.h>
+
+/* A leased host in use by a running nbuild (seconds). Reaped if that run dies */
+static const uint32_t i_LEASE_BUSY = 12 * 3600;
+
+/*
+ * Leases live in a shared directory. A busy lease records the run that holds it,
+ * an idle keepalive lease has no owner (0).
+ */
+typedef struct _leases_t Leases;
+
+struct _leases_t
+{
+    String *path;
+    uint32_t owner;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_now(void)
+{
+    return (uint32_t)(btime_now() / 1000000);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static String *i_lease_file(const String *path, const Host *host)
+{
+    return str_cpath("%s/%s.lease", tc(path), host_name(host));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_lease_read(const String *path, const Host *host, uint32_t *expires, runstate_t *state, uint32_t *owner)
+{
+    bool_t ok = FALSE;
+    String *file = i_lease_file(path, host);
+    Stream *stm = NULL;
+    cassert_no_null(expires);
+    cassert_no_null(state);
+    cassert_no_null(owner);
+    if (hfile_exists(tc(file), NULL) == TRUE)
+        stm = stm_from_file(tc(file), NULL);
+
+    if (stm != NULL)
+    {
+        bool_t err1 = FALSE, err2 = FALSE, err3 = FALSE;
+        uint32_t lexpires = str_to_u32(stm_read_trim(stm), 10, &err1);
+        uint32_t lstate = str_to_u32(stm_read_trim(stm), 10, &err2);
+        uint32_t lowner = str_to_u32(stm_read_trim(stm), 10, &err3);
+        if (err1 == FALSE && err2 == FALSE)
+        {
+            *expires = lexpires;
+            *state = (runstate_t)lstate;
+            *owner = err3 == FALSE ? lowner : 0;
+            ok = TRUE;
+        }
+        stm_close(&stm);
+    }
+
+    str_destroy(&file);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_lease_write(const String *path, const Host *host, const uint32_t expires, const runstate_t state, const uint32_t owner)
+{
+    String *file = i_lease_file(path, host);
+    Stream *stm = stm_to_file(tc(file), NULL);
+    if (stm != NULL)
+    {
+        stm_printf(stm, "%d\n%d\n%d\n", expires, (uint32_t)state, owner);
+        stm_close(&stm);
+    }
+    else
+    {
+        log_printf("%s Error writing lease '%s'", kASCII_BOOT_FAIL, tc(file));
+    }
+
+    str_destroy(&file);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_lease_delete(const String *path, const Host *host)
+{
+    String *file = i_lease_file(path, host);
+    if (hfile_exists(tc(file), NULL) == TRUE)
+        bfile_delete(tc(file), NULL);
+    str_destroy(&file);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_keepable(const runstate_t state)
+{
+    /* Virtual machines booted by nbuild. Other states are never shutdown */
+    if (state == ekRUNSTATE_VBOX_WAKE_UP || state == ekRUNSTATE_UTM_WAKE_UP || state == ekRUNSTATE_VMWARE_WAKE_UP)
+        return TRUE;
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_boot(void *data, const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
+{
+    Leases *leases = (Leases *)data;
+    bool_t warm = FALSE;
+    uint32_t expires = 0;
+    uint32_t owner = 0;
+    runstate_t lstate = ekRUNSTATE_NOT_INIT;
+    cassert_no_null(leases);
+    cassert_no_null(state);
+
+    if (i_lease_read(leases->path, host, &expires, &lstate, &owner) == TRUE)
+    {
+        if (owner != 0 && owner != leases->owner && i_now() < expires)
+        {
+            /*
+             * Busy, in use by another nbuild. We share the host, but the lease
+             * (and the shutdown duty) remains with its owner.
+             */
+            log_printf("%s '%s%s%s' in use by another run", kASCII_BOOT, kASCII_PATH, host_name(host), kASCII_RESET);
+            *state = ekRUNSTATE_ALREADY_RUNNING;
+            warm = TRUE;
+        }
+        /*
+         * Kept alive by a previous run. The lease (and the shutdown duty) passes to this run.
+         * Reported as already running, so it doesn't count as a boot time sample.
+         */
+        else if (nboot_ready(host) == TRUE)
+        {
+            i_lease_write(leases->path, host, i_now() + i_LEASE_BUSY, lstate, leases->owner);
+            log_printf("%s Warm '%s%s%s' kept alive by a previous run", kASCII_BOOT, kASCII_PATH, host_name(host), kASCII_RESET);
+            *state = ekRUNSTATE_ALREADY_RUNNING;
+            warm = TRUE;
+        }
+        else
+        {
+            i_lease_delete(leases->path, host);
+        }
+    }
+
+    if (warm == TRUE)
+        return TRUE;
+
+    return nboot_boot(host, hosts, expect_seconds, state);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_shutdown(void *data, const Host *host, const ArrSt(Host) *hosts, const runstate_t state)
+{
+    Leases *leases = (Leases *)data;
+    uint32_t keepalive = host_keepalive(host);
+    uint32_t expires = 0;
+    uint32_t owner = 0;
+    runstate_t hstate = state;
+    cassert_no_null(leases);
+
+    /* A warm host taken from a lease keeps the state of its original boot */
+    if (state == ekRUNSTATE_ALREADY_RUNNING)
+    {
+        /* Not our lease (running before nbuild or busy by another run). Left untouched */
+        if (i_lease_read(leases->path, host, &expires, &hstate, &owner) == FALSE || owner != leases->owner)
+            return nboot_shutdown(host, hosts, state);
+    }
+
+    if (keepalive > 0 && i_keepable(hstate) == TRUE)
+    {
+        /* Idle keepalive. The next run (or the reaper) takes care of it */
+        i_lease_write(leases->path, host, i_now() + keepalive * 60, hstate, 0);
+        log_printf("%s '%s%s%s' kept alive for %s%d%s minutes", kASCII_BOOT, kASCII_PATH, host_name(host), kASCII_RESET, kASCII_VERSION, keepalive, kASCII_RESET);
+        return FALSE;
+    }
+
+    i_lease_delete(leases->path, host);
+    return nboot_shutdown(host, hosts, hstate);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_ready(void *data, const Host *host)
+{
+    Leases *leases = (Leases *)data;
+    uint32_t expires = 0;
+    uint32_t owner = 0;
+    runstate_t state = ekRUNSTATE_NOT_INIT;
+    cassert_no_null(leases);
+
+    /* Kept warm by a lease or already answering ssh. No boot cost */
+    if (i_lease_read(leases->path, host, &expires, &state, &owner) == TRUE && i_now() < expires)
+        return TRUE;
+
+    return nboot_ready(host);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static HostCaps *i_caps(void *data, const Host *host)
+{
+    unref(data);
+    return host_probe_caps(host);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_fetch(void *data, const Drive *drive, const WorkPaths *wpaths, const char_t *tarname)
+{
+    bool_t ok = TRUE;
+    String *tarpath = NULL;
+    unref(data);
+    cassert_no_null(drive);
+    cassert_no_null(wpaths);
+    tarpath = str_cpath("%s/%s", tc(wpaths->tmp_path), tarname);
+    if (hfile_exists(tc(tarpath), NULL) == FALSE)
+    {
+        ok = ssh_copy(&drive->login, tc(wpaths->drive_path), tarname, NULL, tc(wpaths->tmp_path), tarname, FALSE);
+        if (ok == FALSE)
+            log_printf("%s Error copying '%s' from '%s'", kASCII_SCHED_FAIL, tarname, tc(wpaths->drive_path));
+    }
+
+    str_destroy(&tarpath);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_sources(void *data, const Host *host, const WorkPaths *wpaths, const char_t *flowid, const char_t *kind, const char_t *tarname, const uint32_t repo_vers, const uint32_t runner_id, String **error_msg)
+{
+    unref(data);
+    return host_prepare_sources(host, wpaths, flowid, kind, tarname, repo_vers, runner_id, error_msg);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_build(void *data, const Host *host, HostCaps *caps, const Drive *drive, const SJob *sjob, const Global *global, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+{
+    unref(data);
+    cassert_no_null(sjob);
+    return host_run_build(host, caps, drive, sjob->job, global, wpaths, repo_vers, flowid, runner_id, njobs, warm, cmake_log, build_log, install_log, warns, errors, nwarns, nerrors, error_msg);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_test(void *data, const Host *host, const SJob *sjob, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+{
+    unref(data);
+    cassert_no_null(sjob);
+    return host_run_test(host, sjob->job, tests, repo_vers, flowid, runner_id, njobs, cmake_log, build_log, results, warns, errors, nwarns, nerrors, error_msg);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_sleep(void *data, const uint32_t milliseconds)
+{
+    unref(data);
+    bthread_sleep(milliseconds);
+}
+
+/*---------------------------------------------------------------------------*/
+
+HostExec *hostexec_create(const char_t *lease_path)
+{
+    HostExec *exec = heap_new0(HostExec);
+    Leases *leases = heap_new0(Leases);
+    if (hfile_exists(lease_path, NULL) == FALSE)
+        hfile_dir_create(lease_path, NULL);
+
+    /* Any non-zero value unlikely to match a concurrent run */
+    leases->path = str_c(lease_path);
+    leases->owner = (uint32_t)btime_now();
+    if (leases->owner == 0)
+        leases->owner = 1;
+
+    /* Real hosts in network.json, reached by ssh */
+    exec->data = leases;
+    exec->func_boot = i_boot;
+    exec->func_shutdown = i_shutdown;
+    exec->func_ready = i_ready;
+    exec->func_caps = i_caps;
+    exec->func_fetch = i_fetch;
+    exec->func_sources = i_sources;
+    exec->func_build = i_build;
+    exec->func_test = i_test;
+    exec->func_sleep = i_sleep;
+    return exec;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hostexec_destroy(HostExec **exec)
+{
+    Leases *leases = NULL;
+    cassert_no_null(exec);
+    cassert_no_null(*exec);
+    leases = cast((*exec)->data, Leases);
+    cassert_no_null(leases);
+    str_destroy(&leases->path);
+    heap_delete(&leases, Leases);
+    heap_delete(exec, HostExec);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void hostexec_reap(const HostExec *exec, const ArrSt(Host) *hosts)
+{
+    const Leases *leases = NULL;
+    uint32_t i, n = arrst_size(hosts, Host);
+    cassert_no_null(exec);
+    leases = cast_const(exec->data, Leases);
+    cassert_no_null(leases);
+
+    /* Expired leases of previous runs. Their hosts are shutdown */
+    for (i = 0; i < n; ++i)
+    {
+        const Host *host = arrst_get_const(hosts, i, Host);
+        uint32_t expires = 0;
+        uint32_t owner = 0;
+        runstate_t state = ekRUNSTATE_NOT_INIT;
+        if (i_lease_read(leases->path, host, &expires, &state, &owner) == TRUE && i_now() >= expires)
+        {
+            if (nboot_ready(host) == TRUE && nboot_shutdown(host, hosts, state) == TRUE)
+                log_printf("%s Lease of '%s%s%s' expired, shutting down", kASCII_BOOT, kASCII_PATH, host_name(host), kASCII_RESET);
+            i_lease_delete(leases->path, host);
+        }
+    }
+}
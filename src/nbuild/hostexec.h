@@ -0,0 +1,19 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: hostexec.h
+ *
+ */
+
+/* Host execution backend */
+
+#include "nbuild.hxx"
+
+HostExec *hostexec_create(const char_t *lease_path);
+
+void hostexec_destroy(HostExec **exec);
+
+void hostexec_reap(const HostExec *exec, const ArrSt(Host) *hosts);
@@ -0,0 +1,186 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: logstore.c
+ *
+ */
+
+/* Content-addressed compressed log blobs in drive */
+
+#include "logstore.h"
+#include "cachedir.h"
+#include <nlib/nlib.h>
+#include <nlib/ssh.h>
+#include <core/bhash.h>
+#include <core/buffer.h>
+#include <core/heap.h>
+#include <core/hfile.h>
+#include <core/strings.h>
+#include <osbs/bfile.h>
+#include <osbs/log.h>
+#include <sewer/cassert.h>
+
+struct _logstore_t
+{
+    const Login *drive;
+    String *drive_path;
+    String *local_path;
+    uint32_t nstored;
+    uint32_t nreused;
+    uint32_t nfetched;
+};
+
+static const char_t *i_LOG_FILE = "log.txt";
+
+/*---------------------------------------------------------------------------*/
+
+LogStore *logstore_create(const Login *drive, const char_t *drive_path, const char_t *local_path)
+{
+    LogStore *store = heap_new0(LogStore);
+    cassert_no_null(drive);
+
+    /* Local blobs are kept between runs, as a cache of the drive ones */
+    if (hfile_dir(local_path) == FALSE)
+    {
+        hfile_dir_create(local_path, NULL);
+    }
+    else
+    {
+        uint32_t n = cachedir_prune(local_path);
+        if (n > 0)
+            log_printf("%s Log store: %d expired local blobs removed", kASCII_OK, n);
+    }
+
+    /* Blobs of old reports are never read again. Used ones are uploaded again when refreshed */
+    if (ssh_create_dir(drive, drive_path) == FALSE)
+        log_printf("%s Creating log store '%s'", kASCII_FAIL, drive_path);
+    else if (cachedir_prune_drive(drive, drive_path, "*.tar.gz") == FALSE)
+        log_printf("%s Removing expired blobs from '%s'", kASCII_WARN, drive_path);
+
+    store->drive = drive;
+    store->drive_path = str_c(drive_path);
+    store->local_path = str_c(local_path);
+    return store;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void logstore_destroy(LogStore **store)
+{
+    cassert_no_null(store);
+    cassert_no_null(*store);
+    if ((*store)->nstored > 0 || (*store)->nfetched > 0)
+        log_printf("%s Log store: %d blobs stored, %d reused, %d fetched", kASCII_OK, (*store)->nstored, (*store)->nreused, (*store)->nfetched);
+    str_destroy(&(*store)->drive_path);
+    str_destroy(&(*store)->local_path);
+    heap_delete(store, LogStore);
+}
+
+/*---------------------------------------------------------------------------*/
+
+String *logstore_put(LogStore *store, const byte_t *data, const uint32_t size)
+{
+    bool_t ok = TRUE;
+    String *hash = NULL;
+    String *tarname = NULL;
+    String *tarpath = NULL;
+    String *blobpath = NULL;
+    cassert_no_null(store);
+    hash = str_printf("%08x%08x%08x", bhash_from_block(data, size), cachedir_fnv(CACHEDIR_FNV_SEED, data, size), size);
+    tarname = str_printf("%s.tar.gz", tc(hash));
+    tarpath = str_cpath("%s/%s", tc(store->local_path), tc(tarname));
+
+    /* The local package only exists if it was already uploaded */
+    if (hfile_exists(tc(tarpath), NULL) == TRUE)
+    {
+        /* Renew the drive copy too, or it would expire while still referenced */
+        if (cachedir_refresh(tc(tarpath)) == TRUE)
+            ssh_copy(NULL, tc(store->local_path), tc(tarname), store->drive, tc(store->drive_path), tc(tarname), FALSE);
+        store->nreused += 1;
+    }
+    else
+    {
+        String *logpath = NULL;
+        blobpath = str_cpath("%s/%s", tc(store->local_path), tc(hash));
+        logpath = str_cpath("%s/%s", tc(blobpath), i_LOG_FILE);
+
+        if (hfile_dir(tc(blobpath)) == FALSE)
+            ok = hfile_dir_create(tc(blobpath), NULL);
+
+        if (ok == TRUE)
+            ok = hfile_from_data(tc(logpath), data, size, NULL);
+
+        if (ok == TRUE)
+            ok = ssh_cmake_tar(NULL, tc(blobpath), tc(tarpath));
+
+        if (ok == TRUE)
+            ok = ssh_copy(NULL, tc(store->local_path), tc(tarname), store->drive, tc(store->drive_path), tc(tarname), FALSE);
+
+        if (ok == TRUE)
+        {
+            store->nstored += 1;
+        }
+        else
+        {
+            log_printf("%s Storing log blob '%s'", kASCII_FAIL, tc(tarname));
+            bfile_delete(tc(tarpath), NULL);
+            str_destroy(&hash);
+        }
+
+        str_destroy(&logpath);
+    }
+
+    str_destopt(&blobpath);
+    str_destroy(&tarpath);
+    str_destroy(&tarname);
+    return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+
+Buffer *logstore_get(LogStore *store, const char_t *hash)
+{
+    bool_t ok = TRUE;
+    String *blobpath = NULL;
+    String *logpath = NULL;
+    Buffer *buffer = NULL;
+    cassert_no_null(store);
+    blobpath = str_cpath("%s/%s", tc(store->local_path), hash);
+    logpath = str_cpath("%s/%s", tc(blobpath), i_LOG_FILE);
+
+    /* Not in local cache, download and uncompress */
+    if (hfile_exists(tc(logpath), NULL) == FALSE)
+    {
+        String *tarname = str_printf("%s.tar.gz", hash);
+        String *tarpath = str_cpath("%s/%s", tc(store->local_path), tc(tarname));
+        ok = ssh_copy(store->drive, tc(store->drive_path), tc(tarname), NULL, tc(store->local_path), tc(tarname), FALSE);
+
+        if (ok == TRUE && hfile_dir(tc(blobpath)) == FALSE)
+            ok = hfile_dir_create(tc(blobpath), NULL);
+
+        if (ok == TRUE)
+            ok = ssh_cmake_untar(NULL, tc(blobpath), tc(tarpath));
+
+        if (ok == TRUE)
+            store->nfetched += 1;
+        else
+            log_printf("%s Fetching log blob '%s'", kASCII_FAIL, tc(tarname));
+
+        str_destroy(&tarname);
+        str_destroy(&tarpath);
+    }
+    else
+    {
+        cachedir_refresh(tc(logpath));
+    }
+
+    if (ok == TRUE)
+        buffer = hfile_buffer(tc(logpath), NULL);
+
+    str_destroy(&blobpath);
+    str_destroy(&logpath);
+    return buffer;
+}
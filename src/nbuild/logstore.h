@@ -0,0 +1,21 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: logstore.h
+ *
+ */
+
+/* Content-addressed compressed log blobs in drive */
+
+#include "nbuild.hxx"
+
+LogStore *logstore_create(const Login *drive, const char_t *drive_path, const char_t *local_path);
+
+void logstore_destroy(LogStore **store);
+
+String *logstore_put(LogStore *store, const byte_t *data, const uint32_t size);
+
+Buffer *logstore_get(LogStore *store, const char_t *hash);
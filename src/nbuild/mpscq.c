@@ -0,0 +1,112 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: mpscq.c
+ *
+ */
+
+/* Intrusive multi-producer single-consumer queue */
+
+#include "mpscq.h"
+#include <core/heap.h>
+#include <sewer/cassert.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define i_xchg(ptr, value) _InterlockedExchangePointer((void *volatile *)(ptr), (value))
+#define i_load(ptr) (_ReadWriteBarrier(), *(ptr))
+#define i_store(ptr, value) (_ReadWriteBarrier(), *(ptr) = (value))
+#else
+#define i_xchg(ptr, value) __atomic_exchange_n((ptr), (value), __ATOMIC_ACQ_REL)
+#define i_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define i_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#endif
+
+/*
+ * D. Vyukov queue. Producers only do one atomic exchange. The total order of
+ * nodes is the order of the exchanges, and the nodes of one thread keep their order.
+ */
+struct _mpscq_t
+{
+    MPSCNode *head;
+    MPSCNode *tail;
+    MPSCNode stub;
+};
+
+/*---------------------------------------------------------------------------*/
+
+MPSCQueue *mpscq_create(void)
+{
+    MPSCQueue *queue = heap_new0(MPSCQueue);
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+    return queue;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void mpscq_destroy(MPSCQueue **queue)
+{
+    cassert_no_null(queue);
+    cassert_no_null(*queue);
+    /* The nodes belong to the producers, the queue must be drained */
+    cassert((*queue)->tail == &(*queue)->stub || (*queue)->tail->next == NULL);
+    heap_delete(queue, MPSCQueue);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void mpscq_push(MPSCQueue *queue, MPSCNode *node)
+{
+    MPSCNode *prev = NULL;
+    cassert_no_null(queue);
+    cassert_no_null(node);
+    i_store(&node->next, NULL);
+    prev = (MPSCNode *)i_xchg(&queue->head, node);
+    /* Between the exchange and this store the queue is momentarily cut */
+    i_store(&prev->next, node);
+}
+
+/*---------------------------------------------------------------------------*/
+
+MPSCNode *mpscq_pop(MPSCQueue *queue)
+{
+    MPSCNode *tail = NULL;
+    MPSCNode *next = NULL;
+    cassert_no_null(queue);
+    tail = queue->tail;
+    next = (MPSCNode *)i_load(&tail->next);
+
+    if (tail == &queue->stub)
+    {
+        if (next == NULL)
+            return NULL;
+        queue->tail = next;
+        tail = next;
+        next = (MPSCNode *)i_load(&next->next);
+    }
+
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
+
+    /* A producer is in the middle of a push */
+    if (tail != (MPSCNode *)i_load(&queue->head))
+        return NULL;
+
+    mpscq_push(queue, &queue->stub);
+    next = (MPSCNode *)i_load(&tail->next);
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
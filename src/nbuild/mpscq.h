@@ -0,0 +1,21 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: mpscq.h
+ *
+ */
+
+/* Intrusive multi-producer single-consumer queue */
+
+#include "nbuild.hxx"
+
+MPSCQueue *mpscq_create(void);
+
+void mpscq_destroy(MPSCQueue **queue);
+
+void mpscq_push(MPSCQueue *queue, MPSCNode *node);
+
+MPSCNode *mpscq_pop(MPSCQueue *queue);
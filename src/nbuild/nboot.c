@@ -21,6 +21,15 @@
 #include <osbs/log.h>
 #include <sewer/cassert.h>
 
+/* Boot timeout without history and its adaptive bounds (seconds) */
+static const uint32_t i_BOOT_TIMEOUT = 60 * 5;
+static const uint32_t i_BOOT_TIMEOUT_MIN = 60;
+static const uint32_t i_BOOT_TIMEOUT_MAX = 60 * 15;
+/* ssh probe connect/banner timeout and backoff between probes (milliseconds) */
+static const uint32_t i_PROBE_TIMEOUT = 1000;
+static const uint32_t i_PROBE_MIN_DELAY = 250;
+static const uint32_t i_PROBE_MAX_DELAY = 4000;
+
 /*---------------------------------------------------------------------------*/
 
 static bool_t i_boot_metal(runstate_t *state)
@@ -33,35 +42,56 @@ static bool_t i_boot_metal(runstate_t *state)
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_ping_with_timeout(const Login *login, const uint32_t timeout_seconds)
+static bool_t i_wait_ssh(const Login *login, const uint32_t expect_seconds)
 {
-    uint64_t st = btime_now() / 1000000;
+    uint64_t st = btime_now() / 1000;
+    uint32_t timeout_ms = i_BOOT_TIMEOUT * 1000;
+    uint32_t max_delay = i_PROBE_MAX_DELAY;
+    uint32_t delay = i_PROBE_MIN_DELAY;
+    cassert_no_null(login);
+
+    /*
+     * Limits learned from previous boots of this host (median, UINT32_MAX if unknown).
+     * A host that boots quickly is probed more often and given up sooner.
+     */
+    if (expect_seconds != UINT32_MAX)
+    {
+        timeout_ms = expect_seconds * 3 * 1000;
+        if (timeout_ms < i_BOOT_TIMEOUT_MIN * 1000)
+            timeout_ms = i_BOOT_TIMEOUT_MIN * 1000;
+        if (timeout_ms > i_BOOT_TIMEOUT_MAX * 1000)
+            timeout_ms = i_BOOT_TIMEOUT_MAX * 1000;
+
+        max_delay = expect_seconds * 1000 / 16;
+        if (max_delay < i_PROBE_MIN_DELAY)
+            max_delay = i_PROBE_MIN_DELAY;
+        if (max_delay > i_PROBE_MAX_DELAY)
+            max_delay = i_PROBE_MAX_DELAY;
+    }
+
     for (;;)
     {
-        if (ssh_ping(tc(login->ip)) == TRUE)
-        {
-            /* Win7 runners receive ping before they are ready, improve */
-            if (login->platform == ekWINDOWS)
-                bthread_sleep(15 * 1000);
+        uint64_t elapsed = 0;
 
+        /* Ready when sshd accepts connections. No ping process, no blind sleep */
+        if (ssh_probe(tc(login->ip), i_PROBE_TIMEOUT) == TRUE)
             return TRUE;
-        }
 
-        {
-            uint64_t now = btime_now() / 1000000;
-            if (now - st >= timeout_seconds)
-                return FALSE;
-        }
+        elapsed = btime_now() / 1000 - st;
+        if (elapsed >= timeout_ms)
+            return FALSE;
 
-        bthread_sleep(500);
+        /* Exponential backoff */
+        bthread_sleep(delay);
+        delay *= 2;
+        if (delay > max_delay)
+            delay = max_delay;
     }
-
-    /* return FALSE;*/
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_boot_vbox(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
+static bool_t i_boot_vbox(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
 {
     const char_t *name = host_name(host);
     const char_t *vbox_uuid = host_vbox_uuid(host);
@@ -77,7 +107,7 @@ static bool_t i_boot_vbox(const Host *host, const ArrSt(Host) *hosts, runstate_t
         ok = ssh_vbox_start(plogin, vbox_uuid);
         if (ok == TRUE)
         {
-            ok = i_ping_with_timeout(login, 60 * 5);
+            ok = i_wait_ssh(login, expect_seconds);
             if (ok == TRUE)
             {
                 *state = ekRUNSTATE_VBOX_WAKE_UP;
@@ -204,7 +234,7 @@ static bool_t i_utm_start(const Login *plogin, const char_t *utm_host, const cha
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_boot_utm(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
+static bool_t i_boot_utm(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
 {
     const char_t *name = host_name(host);
     const char_t *utm_uuid = host_utm_uuid(host);
@@ -220,7 +250,7 @@ static bool_t i_boot_utm(const Host *host, const ArrSt(Host) *hosts, runstate_t
         ok = i_utm_start(plogin, utm_host, utm_uuid);
         if (ok == TRUE)
         {
-            ok = i_ping_with_timeout(login, 60 * 5);
+            ok = i_wait_ssh(login, expect_seconds);
             if (ok == TRUE)
             {
                 *state = ekRUNSTATE_UTM_WAKE_UP;
@@ -278,7 +308,7 @@ static bool_t i_vmware_start(const Login *plogin, const char_t *vmware_path)
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_boot_vmware(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
+static bool_t i_boot_vmware(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
 {
     const char_t *name = host_name(host);
     const char_t *vmware_path = host_vmware_path(host);
@@ -294,7 +324,7 @@ static bool_t i_boot_vmware(const Host *host, const ArrSt(Host) *hosts, runstate
         ok = i_vmware_start(plogin, vmware_path);
         if (ok == TRUE)
         {
-            ok = i_ping_with_timeout(login, 60 * 5);
+            ok = i_wait_ssh(login, expect_seconds);
             if (ok == TRUE)
             {
                 *state = ekRUNSTATE_VMWARE_WAKE_UP;
@@ -413,7 +443,7 @@ static String *i_macos_disk_from_volume(const Login *login, const char_t *volume
 /*---------------------------------------------------------------------------*/
 
 /* Reboot a mac using another boot volume connected at same machine */
-static bool_t i_boot_from_bless(const Host *from_host, const Host *to_host, runstate_t *state)
+static bool_t i_boot_from_bless(const Host *from_host, const Host *to_host, const uint32_t expect_seconds, runstate_t *state)
 {
     bool_t ok = TRUE;
     /* The boot volume actually running */
@@ -487,7 +517,7 @@ static bool_t i_boot_from_bless(const Host *from_host, const Host *to_host, runs
      */
     if (ok == TRUE)
     {
-        if (i_ping_with_timeout(to_login, 60 * 5) == TRUE)
+        if (i_wait_ssh(to_login, expect_seconds) == TRUE)
         {
             *state = ekRUNSTATE_MACOS_WAKE_UP;
             return TRUE;
@@ -507,7 +537,7 @@ static bool_t i_boot_from_bless(const Host *from_host, const Host *to_host, runs
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_boot_macos(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
+static bool_t i_boot_macos(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
 {
     /* const char_t *name = host_name(host);*/
     const char_t *macos_host = host_macos_host(host);
@@ -522,7 +552,7 @@ static bool_t i_boot_macos(const Host *host, const ArrSt(Host) *hosts, runstate_
         {
             if (i_macos_can_boot_direct(alive_os, host_os) == TRUE)
             {
-                return i_boot_from_bless(alive_host, host, state);
+                return i_boot_from_bless(alive_host, host, expect_seconds, state);
             }
             else
             {
@@ -546,19 +576,26 @@ static bool_t i_boot_macos(const Host *host, const ArrSt(Host) *hosts, runstate_
 
 /*---------------------------------------------------------------------------*/
 
-bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
+bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
 {
     const Login *login = host_login(host);
     /* const char_t *name = host_name(host);*/
     const char_t *type = host_type(host);
     cassert_no_null(state);
     cassert_no_null(login);
-    if (ssh_ping(tc(login->ip)) == TRUE)
+    if (ssh_probe(tc(login->ip), i_PROBE_TIMEOUT) == TRUE)
     {
         *state = ekRUNSTATE_ALREADY_RUNNING;
         return TRUE;
     }
 
+    /* The host is alive but sshd is still starting (booted by someone else) */
+    if (ssh_ping(tc(login->ip)) == TRUE)
+    {
+        *state = ekRUNSTATE_ALREADY_RUNNING;
+        return i_wait_ssh(login, expect_seconds);
+    }
+
     /* The host is not accesible. We can try boot it */
     if (str_equ_c(type, "metal") == TRUE)
     {
@@ -567,22 +604,22 @@ bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
     /* The host is a VirtualBox machine */
     else if (str_equ_c(type, "vbox") == TRUE)
     {
-        return i_boot_vbox(host, hosts, state);
+        return i_boot_vbox(host, hosts, expect_seconds, state);
     }
     /* The host is a UTM virtual machine */
     else if (str_equ_c(type, "utm") == TRUE)
     {
-        return i_boot_utm(host, hosts, state);
+        return i_boot_utm(host, hosts, expect_seconds, state);
     }
     /* The host is a VMware virtual machine */
     else if (str_equ_c(type, "vmware") == TRUE)
     {
-        return i_boot_vmware(host, hosts, state);
+        return i_boot_vmware(host, hosts, expect_seconds, state);
     }
     /* The host is a macOS volume */
     else if (str_equ_c(type, "macos") == TRUE)
     {
-        return i_boot_macos(host, hosts, state);
+        return i_boot_macos(host, hosts, expect_seconds, state);
     }
 
     return FALSE;
@@ -590,6 +627,15 @@ bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, runstate_t *state)
 
 /*---------------------------------------------------------------------------*/
 
+bool_t nboot_ready(const Host *host)
+{
+    const Login *login = host_login(host);
+    cassert_no_null(login);
+    return ssh_probe(tc(login->ip), i_PROBE_TIMEOUT);
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t nboot_shutdown(const Host *host, const ArrSt(Host) *hosts, const runstate_t state)
 {
     unref(hosts);
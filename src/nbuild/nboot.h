@@ -12,6 +12,8 @@
 
 #include "nbuild.hxx"
 
-bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, runstate_t *state);
+bool_t nboot_boot(const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state);
+
+bool_t nboot_ready(const Host *host);
 
 bool_t nboot_shutdown(const Host *host, const ArrSt(Host) *hosts, const runstate_t state);
@@ -33,7 +33,10 @@
 
 const char_t *NBUILD_TMP_FOLDER = "nbuild_master_tmp";
 const char_t *NBUILD_REPORT_JSON = "report.json";
+const char_t *NBUILD_REPORT_JOURNAL = "report.jrn";
 const char_t *NBUILD_LOCKFILE = "nbuild.lock";
+const char_t *NBUILD_LAST_VERS = "last_vers.txt";
+const char_t *NBUILD_DOC_PAGES = "doc_pages.txt";
 const char_t *NBUILD_SRC_TAR = "src.tar.gz";
 const char_t *NBUILD_TEST_TAR = "test.tar.gz";
 const char_t *NBUILD_WEB_TAR = "web.tar.gz";
@@ -59,6 +62,7 @@ static char_t *i_opt(int argc, char *argv[], const char_t *opt)
 static void i_print_usage(void)
 {
     log_printf("Use: nbuild -n network.json -w workflow.json\n");
+    log_printf("Scheduler simulation: nbuild -n network.json -w workflow.json -s report.json\n");
 }
 
 /*---------------------------------------------------------------------------*/
@@ -152,6 +156,14 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* Persistent ssh connections, shared by all commands to the same host */
+    if (ok == TRUE)
+    {
+        String *muxpath = str_cpath("%s/ssh-mux", tc(tmppath));
+        ssh_mux_start(tc(muxpath));
+        str_destroy(&muxpath);
+    }
+
     /* Load build network */
     if (ok == TRUE)
     {
@@ -201,8 +213,14 @@ int main(int argc, char *argv[])
         const char_t *workflow_file = i_opt(argc, argv, "-w");
         if (workflow_file != NULL)
         {
+            const char_t *sim_file = i_opt(argc, argv, "-s");
             Workflows *workflows = workflow_create(workflow_file);
-            if (workflows != NULL)
+            if (workflows != NULL && sim_file != NULL)
+            {
+                /* Simulated hosts with the durations of an existing report. Nothing is booted */
+                ok = workflow_simulate(workflows, network, sim_file);
+            }
+            else if (workflows != NULL)
             {
                 log_printf("%s Drive '%s' '%s%s%s'", kASCII_OK, tc(network->drive.name), kASCII_PATH, tc(network->drive.path), kASCII_RESET);
                 logpath = workflow_run(workflows, network, tc(forced_jobs), tc(logfile), tc(tmppath));
@@ -241,6 +259,7 @@ int main(int argc, char *argv[])
         }
     }
 
+    ssh_mux_finish();
     log_printf("%s", "");
     log_printf("%s", "");
     json_destopt(&network, Network);
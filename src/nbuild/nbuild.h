@@ -14,7 +14,10 @@
 
 extern const char_t *NBUILD_TMP_FOLDER;
 extern const char_t *NBUILD_REPORT_JSON;
+extern const char_t *NBUILD_REPORT_JOURNAL;
 extern const char_t *NBUILD_LOCKFILE;
+extern const char_t *NBUILD_LAST_VERS;
+extern const char_t *NBUILD_DOC_PAGES;
 extern const char_t *NBUILD_SRC_TAR;
 extern const char_t *NBUILD_TEST_TAR;
 extern const char_t *NBUILD_WEB_TAR;
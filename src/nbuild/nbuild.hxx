@@ -44,10 +44,21 @@ typedef enum _runstate_t
     ekRUNSTATE_UNREACHABLE
 } runstate_t;
 
+typedef enum _schedpol_t
+{
+    /* Longest first, reserved to the historically fastest host */
+    ekSCHED_LPT_AFFINITY,
+    /* Longest first, any capable host */
+    ekSCHED_LPT,
+    /* Workflow order, any capable host */
+    ekSCHED_FIFO
+} schedpol_t;
+
 typedef struct _workpaths_t WorkPaths;
 typedef struct _report_t Report;
 typedef struct _revent_t REvent;
 typedef struct _rstate_t RState;
+typedef struct _rjournal_t RJournal;
 typedef struct _workflow_t Workflow;
 typedef struct _workflows_t Workflows;
 typedef struct _global_t Global;
@@ -57,6 +68,17 @@ typedef struct _job_t Job;
 typedef struct _host_t Host;
 typedef struct _network_t Network;
 typedef struct _sjob_t SJob;
+typedef struct _preboot_t Preboot;
+typedef struct _rtest_t RTest;
+typedef struct _rblob_t RBlob;
+typedef struct _srccache_t SrcCache;
+typedef struct _logstore_t LogStore;
+typedef struct _rqueue_t RQueue;
+typedef struct _mpscnode_t MPSCNode;
+typedef struct _mpscq_t MPSCQueue;
+typedef struct _hostexec_t HostExec;
+typedef struct _simul_t Simul;
+typedef struct _hostcaps_t HostCaps;
 
 /* Full set of directories that nbuild will work with during its execution. */
 struct _workpaths_t
@@ -66,12 +88,17 @@ struct _workpaths_t
     String *tmp_test; /* Temporal tests code processing 'nbuild_master_tmp/flowid/test' */
     String *tmp_ndoc; /* Temporal ndoc generator files 'nbuild_master_tmp/flowid/ndoc_out' */
     String *tmp_nrep; /* Temporal ndoc web report files 'nbuild_master_tmp/flowid/ndoc_rep' */
+    String *tmp_wc;   /* Cached repo working copies, kept between runs 'nbuild_master_tmp/flowid-WC' */
+    String *tmp_fmt;  /* Cached processed source files, kept between runs 'nbuild_master_tmp/flowid-FMT' */
+    String *tmp_log;  /* Cached log blobs, kept between runs 'nbuild_master_tmp/flowid-LOG' */
 
+    String *drive_flow;    /* Flow path storage in drive (all repo versions) 'drive/flowid' */
     String *drive_path;    /* Main path storage in drive 'drive/flowid/repo_vers' */
     String *drive_inf;     /* drive reports and logs 'drive/flowid/repo_vers/inf' */
     String *drive_doc;     /* drive documentation 'drive/flowid-DOC/doc_repo_vers' */
     String *drive_rep;     /* drive reports sources 'drive/flowid-REP' */
     String *drive_rep_web; /* drive reports websites 'drive/flowid-REPWEB/repo_vers' */
+    String *drive_log;     /* drive compressed log blobs (all repo versions) 'drive/flowid-LOG' */
 };
 
 struct _rstate_t
@@ -83,6 +110,12 @@ struct _rstate_t
     const char_t *error_msg;
 };
 
+/* Link of an intrusive MPSC queue, first member of the queued record */
+struct _mpscnode_t
+{
+    MPSCNode *next;
+};
+
 struct _drive_t
 {
     String *name;
@@ -121,6 +154,8 @@ struct _global_t
     bool_t hosting_cert;
     String *hosting_docpath;
     String *hosting_buildpath;
+    bool_t incremental;
+    uint32_t clean_loops;
 };
 
 struct _target_t
@@ -129,6 +164,7 @@ struct _target_t
     String *dest;
     String *url;
     String *exec;
+    uint32_t timeout;
     bool_t legal;
     bool_t format;
     bool_t analyzer;
@@ -143,6 +179,7 @@ struct _job_t
     String *config;
     String *generator;
     String *opts;
+    String *host;
     ArrPt(String) *tags;
 };
 
@@ -152,9 +189,53 @@ struct _sjob_t
     uint32_t id;
 };
 
+/* Log stored out of the report, in drive LogStore */
+struct _rblob_t
+{
+    String *hash;
+    uint32_t size; /* Uncompressed */
+};
+
+/* Result of a single test executable */
+struct _rtest_t
+{
+    String *name;
+    uint32_t ret;
+    uint32_t seconds;
+    bool_t timeout;
+    String *log; /* Base64 */
+    RBlob log_blob;
+};
+
 DeclSt(Target);
 DeclSt(Job);
 DeclSt(SJob);
+DeclSt(RTest);
 ArrStFuncs(Host);
 
+typedef bool_t (*FPtr_exec_boot)(void *data, const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state);
+typedef bool_t (*FPtr_exec_shutdown)(void *data, const Host *host, const ArrSt(Host) *hosts, const runstate_t state);
+typedef bool_t (*FPtr_exec_ready)(void *data, const Host *host);
+typedef HostCaps *(*FPtr_exec_caps)(void *data, const Host *host);
+typedef bool_t (*FPtr_exec_fetch)(void *data, const Drive *drive, const WorkPaths *wpaths, const char_t *tarname);
+typedef bool_t (*FPtr_exec_sources)(void *data, const Host *host, const WorkPaths *wpaths, const char_t *flowid, const char_t *kind, const char_t *tarname, const uint32_t repo_vers, const uint32_t runner_id, String **error_msg);
+typedef bool_t (*FPtr_exec_build)(void *data, const Host *host, HostCaps *caps, const Drive *drive, const SJob *sjob, const Global *global, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
+typedef bool_t (*FPtr_exec_test)(void *data, const Host *host, const SJob *sjob, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg);
+typedef void (*FPtr_exec_sleep)(void *data, const uint32_t milliseconds);
+
+/* Host execution backend used by the scheduler (real hosts or simulated) */
+struct _hostexec_t
+{
+    void *data;
+    FPtr_exec_boot func_boot;
+    FPtr_exec_shutdown func_shutdown;
+    FPtr_exec_ready func_ready;
+    FPtr_exec_caps func_caps;
+    FPtr_exec_fetch func_fetch;
+    FPtr_exec_sources func_sources;
+    FPtr_exec_build func_build;
+    FPtr_exec_test func_test;
+    FPtr_exec_sleep func_sleep;
+};
+
 #endif
@@ -302,6 +302,86 @@ static String *i_ndoc_parse(const String *stdout_, const char_t *word, uint32_t
 
 /*---------------------------------------------------------------------------*/
 
+static int i_page_cmp(const String *page1, const String *page2)
+{
+    return str_scmp(page1, page2);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_page_key_cmp(const String *page, const char_t *key)
+{
+    return str_cmp(page, key);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_html_pages(const char_t *dir, const char_t *prefix, ArrPt(String) *pages)
+{
+    ArrSt(DirEntry) *entries = hfile_dir_list(dir, TRUE, NULL);
+    arrst_foreach(entry, entries, DirEntry)
+        String *page = NULL;
+        if (str_empty_c(prefix) == TRUE)
+            page = str_copy(entry->name);
+        else
+            page = str_printf("%s/%s", prefix, tc(entry->name));
+
+        if (entry->type == ekDIRECTORY)
+        {
+            String *subdir = str_cpath("%s/%s", dir, tc(entry->name));
+            i_html_pages(tc(subdir), tc(page), pages);
+            str_destroy(&subdir);
+            str_destroy(&page);
+        }
+        else
+        {
+            const char_t *ext = str_filext(tc(entry->name));
+            if (ext != NULL && str_equ_c(ext, "html") == TRUE)
+                arrpt_append(pages, page, String);
+            else
+                str_destroy(&page);
+        }
+    arrst_end()
+    arrst_destroy(&entries, hfile_dir_entry_remove, DirEntry);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_store_doc_pages(const Login *drive, const char_t *tmp_ndoc, const char_t *drive_doc)
+{
+    /* Sorted list of published pages, relative to the website root */
+    bool_t ok = TRUE;
+    String *websrc = str_cpath("%s/web", tmp_ndoc);
+    String *doc_flow = NULL;
+    ArrPt(String) *pages = arrpt_create(String);
+    Stream *stm = stm_memory(4096);
+    i_html_pages(tc(websrc), "", pages);
+    arrpt_sort(pages, i_page_cmp, String);
+    arrpt_foreach(page, pages, String)
+        str_writef(stm, page);
+        stm_writef(stm, "\n");
+    arrpt_end()
+
+    /* Manifest of this doc version and latest manifest of the flow */
+    str_split_pathname(drive_doc, &doc_flow, NULL);
+    ok = ssh_to_file(drive, drive_doc, NBUILD_DOC_PAGES, stm);
+    if (ok == TRUE)
+        ok = ssh_to_file(drive, tc(doc_flow), NBUILD_DOC_PAGES, stm);
+
+    if (ok == TRUE)
+        log_printf("%s Documentation manifest '%s%s%s' with %d pages", kASCII_OK, kASCII_PATH, NBUILD_DOC_PAGES, kASCII_RESET, arrpt_size(pages, String));
+    else
+        log_printf("%s Error copying '%s' to '%s'", kASCII_WARN, NBUILD_DOC_PAGES, drive_doc);
+
+    str_destroy(&websrc);
+    str_destroy(&doc_flow);
+    arrpt_destroy(&pages, str_destroy, String);
+    stm_close(&stm);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static bool_t i_generate_doc(const Global *global, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const uint32_t doc_repo_vers, const WorkPaths *wpaths, Report *report, String **error_msg)
 {
     bool_t ok = TRUE;
@@ -443,6 +523,10 @@ static bool_t i_generate_doc(const Global *global, const Login *drive, const cha
                     copy_error_msg = str_printf("%s Error copying ndoc stderr to '%s'", kASCII_FAIL, tc(wpaths->drive_doc));
             }
 
+            /* Without manifest, links of source headers are checked by http */
+            if (ok == TRUE)
+                i_store_doc_pages(drive, tc(wpaths->tmp_ndoc), tc(wpaths->drive_doc));
+
             if (ok == FALSE)
             {
                 cassert_no_null(copy_error_msg);
@@ -581,6 +665,53 @@ bool_t prdoc_generate(const Global *global, const Login *drive, const char_t *pr
 
 /*---------------------------------------------------------------------------*/
 
+ArrPt(String) *prdoc_pages(const Login *drive, const WorkPaths *wpaths)
+{
+    Stream *stm = NULL;
+    ArrPt(String) *pages = NULL;
+    cassert_no_null(wpaths);
+
+    /* Manifest of the current doc version or, if not yet generated, the latest one */
+    if (str_empty(wpaths->drive_doc) == FALSE)
+    {
+        if (ssh_file_exists(drive, tc(wpaths->drive_doc), NBUILD_DOC_PAGES) == TRUE)
+        {
+            stm = ssh_file_cat(drive, tc(wpaths->drive_doc), NBUILD_DOC_PAGES);
+        }
+        else
+        {
+            String *doc_flow = NULL;
+            str_split_pathname(tc(wpaths->drive_doc), &doc_flow, NULL);
+            if (ssh_file_exists(drive, tc(doc_flow), NBUILD_DOC_PAGES) == TRUE)
+                stm = ssh_file_cat(drive, tc(doc_flow), NBUILD_DOC_PAGES);
+            str_destroy(&doc_flow);
+        }
+    }
+
+    if (stm != NULL)
+    {
+        pages = arrpt_create(String);
+        stm_lines(line, stm)
+            if (str_empty_c(line) == FALSE)
+                arrpt_append(pages, str_c(line), String);
+        stm_next(line, stm)
+        arrpt_sort(pages, i_page_cmp, String);
+        stm_close(&stm);
+        log_printf("%s Documentation manifest with %d pages", kASCII_OK, arrpt_size(pages, String));
+    }
+
+    return pages;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t prdoc_page_exists(const ArrPt(String) *pages, const char_t *page)
+{
+    return (bool_t)(arrpt_bsearch_const(pages, i_page_key_cmp, page, NULL, String, char_t) != NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static bool_t i_delete_report_path(const char_t *reppath)
 {
     bool_t ok = TRUE;
@@ -634,10 +765,10 @@ static bool_t i_get_previous_reports(const Login *drive, const char_t *drive_rep
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_generate_current_report(const Global *global, const ArrSt(Job) *jobs, const char_t *repfile, const Report *report, const char_t *project_vers)
+static bool_t i_generate_current_report(const Global *global, const ArrSt(Job) *jobs, const char_t *repfile, const Report *report, LogStore *logstore, const char_t *project_vers)
 {
     bool_t ok = TRUE;
-    Stream *stm = report_ndoc_page(report, jobs, global, project_vers);
+    Stream *stm = report_ndoc_page(report, logstore, jobs, global, project_vers);
     const byte_t *data = stm_buffer(stm);
     uint32_t size = stm_buffer_size(stm);
     if (hfile_from_data(repfile, data, size, NULL) == FALSE)
@@ -837,7 +968,7 @@ static bool_t i_upload_rep_website(const Global *global, const char_t *tmp_nrep,
 
 /*---------------------------------------------------------------------------*/
 
-bool_t prdoc_buildrep_generate(const Global *global, const ArrSt(Job) *jobs, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const WorkPaths *wpaths, const Report *report)
+bool_t prdoc_buildrep_generate(const Global *global, const ArrSt(Job) *jobs, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const WorkPaths *wpaths, const Report *report, LogStore *logstore)
 {
     bool_t ok = TRUE;
     String *repsrc = NULL;
@@ -858,7 +989,7 @@ bool_t prdoc_buildrep_generate(const Global *global, const ArrSt(Job) *jobs, con
         ok = i_get_previous_reports(drive, tc(wpaths->drive_rep), tc(repsrc));
 
     if (ok == TRUE)
-        ok = i_generate_current_report(global, jobs, tc(repfile), report, project_vers);
+        ok = i_generate_current_report(global, jobs, tc(repfile), report, logstore, project_vers);
 
     if (ok == TRUE)
         ok = i_store_current_report(drive, tc(wpaths->drive_rep), tc(repfile));
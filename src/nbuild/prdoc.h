@@ -14,6 +14,10 @@
 
 void prdoc_dbind(void);
 
+ArrPt(String) *prdoc_pages(const Login *drive, const WorkPaths *wpaths);
+
+bool_t prdoc_page_exists(const ArrPt(String) *pages, const char_t *page);
+
 bool_t prdoc_generate(const Global *global, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const uint32_t doc_repo_vers, const WorkPaths *wpaths, Report *report);
 
-bool_t prdoc_buildrep_generate(const Global *global, const ArrSt(Job) *jobs, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const WorkPaths *wpaths, const Report *report);
+bool_t prdoc_buildrep_generate(const Global *global, const ArrSt(Job) *jobs, const Login *drive, const char_t *project_vers, const uint32_t repo_vers, const WorkPaths *wpaths, const Report *report, LogStore *logstore);
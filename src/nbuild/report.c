@@ -12,13 +12,17 @@
 
 #include "report.h"
 #include "host.h"
+#include "nbuild.h"
+#include "logstore.h"
 #include <nlib/nlib.h>
+#include <nlib/ssh.h>
 #include <encode/base64.h>
 #include <core/arrst.h>
 #include <core/arrpt.h>
 #include <core/buffer.h>
 #include <core/date.h>
 #include <core/dbind.h>
+#include <core/heap.h>
 #include <core/regex.h>
 #include <core/strings.h>
 #include <core/stream.h>
@@ -32,12 +36,17 @@ typedef struct _rtarget_t RTarget;
 typedef struct _rdoc_t RDoc;
 typedef struct _rstep_t RStep;
 typedef struct _rjob_t RJob;
+typedef struct _rtime_t RTime;
+typedef struct _rhost_t RHost;
+typedef struct _rjstep_t RJStep;
 
 struct _rloop_t
 {
     Date init;
     Date end;
     String *log;
+    RBlob log_blob;
+    ArrSt(REvent) *stages;
 };
 
 struct _revent_t
@@ -87,8 +96,17 @@ struct _rstep_t
     String *install_log;
     String *warns;
     String *errors;
+    RBlob cmake_blob;
+    RBlob build_blob;
+    RBlob install_blob;
+    RBlob warns_blob;
+    RBlob errors_blob;
     uint32_t nwarns;
     uint32_t nerrors;
+    ArrSt(RTest) *tests;
+    uint32_t njobs;
+    bool_t incremental;
+    bool_t warm;
 };
 
 struct _rjob_t
@@ -100,6 +118,23 @@ struct _rjob_t
     ArrSt(RStep) *steps;
 };
 
+struct _rtime_t
+{
+    String *job;
+    String *step;
+    String *hostname;
+    uint32_t repo_vers;
+    bool_t warm;
+    int32_t seconds;
+};
+
+/* Host cores probed after its last boot */
+struct _rhost_t
+{
+    String *name;
+    uint32_t ncpus;
+};
+
 struct _report_t
 {
     String *repo_url;
@@ -110,9 +145,47 @@ struct _report_t
     ArrSt(RTarget) *tests;
     ArrSt(RDoc) *docs;
     ArrSt(RJob) *jobs;
+    ArrSt(RTime) *times;
+    ArrSt(RHost) *hosts;
     REvent build_file;
     REvent src_tar;
     REvent test_tar;
+    /* Snapshot generation. Journal records of older generations are stale */
+    uint32_t journal_gen;
+};
+
+/* Job step state, as a journal record. The job is identified by name, ids are positions */
+struct _rjstep_t
+{
+    String *job;
+    String *generator;
+    uint32_t priority;
+    uint32_t nsteps;
+    String *step;
+    REvent event;
+    bool_t incremental;
+    bool_t warm;
+    uint32_t njobs;
+};
+
+typedef enum _jrecord_t
+{
+    ekJRECORD_JOB_ADD = 1,
+    ekJRECORD_JOB_INIT,
+    ekJRECORD_JOB_MODE,
+    ekJRECORD_JOB_END,
+    ekJRECORD_TIME,
+    ekJRECORD_HOST
+} jrecord_t;
+
+/* Typed records pending to be appended to the journal */
+struct _rjournal_t
+{
+    const Login *login;
+    String *path;
+    Stream *pending;
+    uint32_t nrecords;
+    uint32_t gen;
 };
 
 DeclSt(RLoop);
@@ -121,6 +194,14 @@ DeclSt(RTarget);
 DeclSt(RDoc);
 DeclSt(RStep);
 DeclSt(RJob);
+DeclSt(RTime);
+DeclSt(RHost);
+
+/* Max duration samples kept for each job step */
+static const uint32_t i_MAX_TIMES = 8;
+
+/* 'NBJE' at the beginning of each journal record, followed by the generation */
+static const uint32_t i_JOURNAL_MAGIC = 0x454A424E;
 
 /*---------------------------------------------------------------------------*/
 
@@ -135,13 +216,17 @@ void report_dbind(void)
     dbind(Date, uint8_t, second);
     dbind(RLoop, Date, init);
     dbind(RLoop, Date, end);
+    dbind(RBlob, String *, hash);
+    dbind(RBlob, uint32_t, size);
     dbind(RLoop, String *, log);
+    dbind(RLoop, RBlob, log_blob);
     dbind(REvent, String *, name);
     dbind(REvent, uint32_t, loop_id);
     dbind(REvent, Date, init);
     dbind(REvent, Date, end);
     dbind(REvent, int32_t, seconds);
     dbind(REvent, String *, error_msg);
+    dbind(RLoop, ArrSt(REvent) *, stages);
     dbind(RTarget, REvent, event);
     dbind(RTarget, bool_t, legal);
     dbind(RTarget, bool_t, format);
@@ -169,13 +254,36 @@ void report_dbind(void)
     dbind(RStep, String *, install_log);
     dbind(RStep, String *, warns);
     dbind(RStep, String *, errors);
+    dbind(RStep, RBlob, cmake_blob);
+    dbind(RStep, RBlob, build_blob);
+    dbind(RStep, RBlob, install_blob);
+    dbind(RStep, RBlob, warns_blob);
+    dbind(RStep, RBlob, errors_blob);
     dbind(RStep, uint32_t, nwarns);
     dbind(RStep, uint32_t, nerrors);
+    dbind(RTest, String *, name);
+    dbind(RTest, uint32_t, ret);
+    dbind(RTest, uint32_t, seconds);
+    dbind(RTest, bool_t, timeout);
+    dbind(RTest, String *, log);
+    dbind(RTest, RBlob, log_blob);
+    dbind(RStep, ArrSt(RTest) *, tests);
+    dbind(RStep, uint32_t, njobs);
+    dbind(RStep, bool_t, incremental);
+    dbind(RStep, bool_t, warm);
     dbind(RJob, uint32_t, priority);
     dbind(RJob, String *, name);
     dbind(RJob, String *, hostname);
     dbind(RJob, String *, generator);
     dbind(RJob, ArrSt(RStep) *, steps);
+    dbind(RTime, String *, job);
+    dbind(RTime, String *, step);
+    dbind(RTime, String *, hostname);
+    dbind(RTime, uint32_t, repo_vers);
+    dbind(RTime, bool_t, warm);
+    dbind(RTime, int32_t, seconds);
+    dbind(RHost, String *, name);
+    dbind(RHost, uint32_t, ncpus);
     dbind(Report, String *, repo_url);
     dbind(Report, uint32_t, repo_vers);
     dbind(Report, uint32_t, loop_id);
@@ -184,9 +292,21 @@ void report_dbind(void)
     dbind(Report, ArrSt(RTarget) *, tests);
     dbind(Report, ArrSt(RDoc) *, docs);
     dbind(Report, ArrSt(RJob) *, jobs);
+    dbind(Report, ArrSt(RTime) *, times);
+    dbind(Report, ArrSt(RHost) *, hosts);
     dbind(Report, REvent, build_file);
     dbind(Report, REvent, src_tar);
     dbind(Report, REvent, test_tar);
+    dbind(Report, uint32_t, journal_gen);
+    dbind(RJStep, String *, job);
+    dbind(RJStep, String *, generator);
+    dbind(RJStep, uint32_t, priority);
+    dbind(RJStep, uint32_t, nsteps);
+    dbind(RJStep, String *, step);
+    dbind(RJStep, REvent, event);
+    dbind(RJStep, bool_t, incremental);
+    dbind(RJStep, bool_t, warm);
+    dbind(RJStep, uint32_t, njobs);
     dbind_default(REvent, uint32_t, loop_id, UINT32_MAX);
 }
 
@@ -254,7 +374,7 @@ static RDoc *i_get_doc(ArrSt(RDoc) *docs, const uint32_t doc_repo_vers)
 
 /*---------------------------------------------------------------------------*/
 
-static void i_add_job(ArrSt(RJob) *jobs, const char_t *name, const char_t *generator, const uint32_t priority, const bool_t with_tests)
+static bool_t i_add_job(ArrSt(RJob) *jobs, const char_t *name, const char_t *generator, const uint32_t priority, const bool_t with_tests)
 {
     RJob *job = arrst_search(jobs, i_job_cmp, name, NULL, RJob, char_t);
     if (job == NULL)
@@ -278,7 +398,11 @@ static void i_add_job(ArrSt(RJob) *jobs, const char_t *name, const char_t *gener
             dbind_init(step, RStep);
             str_upd(&step->name, "test");
         }
+
+        return TRUE;
     }
+
+    return FALSE;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -414,6 +538,104 @@ void report_loop_end(Report *report, const char_t *logfile)
 
 /*---------------------------------------------------------------------------*/
 
+static void i_store_log(LogStore *logstore, String **log, RBlob *blob, const bool_t base64, uint32_t *nlogs, uint32_t *nbytes)
+{
+    cassert_no_null(log);
+    cassert_no_null(blob);
+    cassert_no_null(nlogs);
+    cassert_no_null(nbytes);
+    if (str_empty(*log) == FALSE)
+    {
+        String *hash = NULL;
+        uint32_t size = 0;
+        if (base64 == TRUE)
+        {
+            Buffer *buffer = b64_decode_from_str(*log);
+            size = buffer_size(buffer);
+            hash = logstore_put(logstore, buffer_const(buffer), size);
+            buffer_destroy(&buffer);
+        }
+        else
+        {
+            size = str_len(*log);
+            hash = logstore_put(logstore, cast_const(tc(*log), byte_t), size);
+        }
+
+        /* If the blob can't be stored, the log remains inside the report */
+        if (hash != NULL)
+        {
+            str_destroy(&blob->hash);
+            blob->hash = hash;
+            blob->size = size;
+            str_upd(log, "");
+            *nlogs += 1;
+            *nbytes += size;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_store_logs(Report *report, LogStore *logstore)
+{
+    uint32_t nlogs = 0, nbytes = 0;
+    cassert_no_null(report);
+    cassert_no_null(logstore);
+
+    /* Reports from previous versions still have inline logs (migrated here) */
+    arrst_foreach(loop, report->loops, RLoop)
+        i_store_log(logstore, &loop->log, &loop->log_blob, TRUE, &nlogs, &nbytes);
+    arrst_end()
+
+    arrst_foreach(job, report->jobs, RJob)
+        arrst_foreach(step, job->steps, RStep)
+            /* Test step keeps warns, errors and run log in base64 */
+            bool_t base64 = (bool_t)(step_i > 0);
+            i_store_log(logstore, &step->cmake_log, &step->cmake_blob, FALSE, &nlogs, &nbytes);
+            i_store_log(logstore, &step->build_log, &step->build_blob, FALSE, &nlogs, &nbytes);
+            i_store_log(logstore, &step->install_log, &step->install_blob, base64, &nlogs, &nbytes);
+            i_store_log(logstore, &step->warns, &step->warns_blob, base64, &nlogs, &nbytes);
+            i_store_log(logstore, &step->errors, &step->errors_blob, base64, &nlogs, &nbytes);
+            arrst_foreach(test, step->tests, RTest)
+                i_store_log(logstore, &test->log, &test->log_blob, TRUE, &nlogs, &nbytes);
+            arrst_end()
+        arrst_end()
+    arrst_end()
+
+    if (nlogs > 0)
+        log_printf("%s Moved %d logs (%d KB) out of '%sreport.json%s'", kASCII_OK, nlogs, nbytes / 1024, kASCII_TARGET, kASCII_RESET);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_event_cmp(const REvent *event, const char_t *name)
+{
+    cassert_no_null(event);
+    return str_cmp(event->name, name);
+}
+
+/*---------------------------------------------------------------------------*/
+
+REvent *report_stage_event(Report *report, const char_t *name)
+{
+    RLoop *loop = NULL;
+    REvent *event = NULL;
+    cassert_no_null(report);
+    cassert(arrst_size(report->loops, RLoop) == report->loop_id + 1);
+    loop = arrst_last(report->loops, RLoop);
+    event = arrst_search(loop->stages, i_event_cmp, name, NULL, REvent, char_t);
+    if (event == NULL)
+    {
+        event = arrst_new(loop->stages, REvent);
+        dbind_init(event, REvent);
+        str_upd(&event->name, name);
+    }
+
+    return event;
+}
+
+/*---------------------------------------------------------------------------*/
+
 uint32_t report_loop_current(const Report *report)
 {
     cassert_no_null(report);
@@ -749,6 +971,90 @@ static REvent *i_get_event(ArrSt(RJob) *jobs, const uint32_t job_id, const char_
 
 /*---------------------------------------------------------------------------*/
 
+static void i_journal_write(RJournal *journal, const jrecord_t type, const Stream *item)
+{
+    uint32_t size = stm_buffer_size(item);
+    cassert_no_null(journal);
+    stm_write_u32(journal->pending, i_JOURNAL_MAGIC);
+    stm_write_u32(journal->pending, journal->gen);
+    stm_write_u32(journal->pending, (uint32_t)type);
+    stm_write_u32(journal->pending, size);
+    stm_write(journal->pending, stm_buffer(item), size);
+    journal->nrecords += 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_journal_step(RJournal *journal, const jrecord_t type, const Report *report, const uint32_t job_id, const char_t *step_id)
+{
+    const RJob *job = NULL;
+    const RStep *step = NULL;
+    Stream *item = stm_memory(512);
+    RJStep jstep;
+    cassert_no_null(report);
+    job = arrst_get_const(report->jobs, job_id, RJob);
+    step = i_get_step(report->jobs, job_id, step_id);
+    cassert_no_null(step);
+    jstep.job = job->name;
+    jstep.generator = job->generator;
+    jstep.priority = job->priority;
+    jstep.nsteps = arrst_size(job->steps, RStep);
+    jstep.step = step->name;
+    jstep.event = step->event;
+    jstep.incremental = step->incremental;
+    jstep.warm = step->warm;
+    jstep.njobs = step->njobs;
+    dbind_write(item, &jstep, RJStep);
+    i_journal_write(journal, type, item);
+    stm_close(&item);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static RHost *i_set_ncpus(ArrSt(RHost) *hosts, const char_t *hostname, const uint32_t ncpus)
+{
+    RHost *host = NULL;
+    arrst_foreach(rhost, hosts, RHost)
+        if (str_equ(rhost->name, hostname) == TRUE)
+        {
+            host = rhost;
+            break;
+        }
+    arrst_end()
+
+    if (host == NULL)
+    {
+        host = arrst_new0(hosts, RHost);
+        host->name = str_c(hostname);
+    }
+
+    host->ncpus = ncpus;
+    return host;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_journal_host(RJournal *journal, const RHost *host)
+{
+    Stream *item = stm_memory(64);
+    dbind_write(item, host, RHost);
+    i_journal_write(journal, ekJRECORD_HOST, item);
+    stm_close(&item);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_journal_time(RJournal *journal, const Report *report)
+{
+    Stream *item = stm_memory(256);
+    cassert_no_null(report);
+    dbind_write(item, arrst_last_const(report->times, RTime), RTime);
+    i_journal_write(journal, ekJRECORD_TIME, item);
+    stm_close(&item);
+}
+
+/*---------------------------------------------------------------------------*/
+
 void report_job_state(Report *report, const uint32_t job_id, const char_t *step_id, RState *state)
 {
     REvent *event = NULL;
@@ -759,34 +1065,105 @@ void report_job_state(Report *report, const uint32_t job_id, const char_t *step_
 
 /*---------------------------------------------------------------------------*/
 
-void report_job_init(Report *report, const uint32_t job_id, const char_t *step_id)
+void report_job_init(Report *report, const uint32_t job_id, const char_t *step_id, RJournal *journal)
 {
     REvent *event = NULL;
     cassert_no_null(report);
     event = i_get_event(report->jobs, job_id, step_id);
     i_event_init(event, report);
+    if (journal != NULL)
+        i_journal_step(journal, ekJRECORD_JOB_INIT, report, job_id, step_id);
 }
 
 /*---------------------------------------------------------------------------*/
 
-void report_job_end(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg)
+void report_job_build_mode(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t incremental, const bool_t warm, const uint32_t njobs, RJournal *journal)
+{
+    RStep *step = NULL;
+    cassert_no_null(report);
+    step = i_get_step(report->jobs, job_id, step_id);
+    cassert_no_null(step);
+    step->incremental = incremental;
+    step->warm = warm;
+    step->njobs = njobs;
+    if (journal != NULL)
+        i_journal_step(journal, ekJRECORD_JOB_MODE, report, job_id, step_id);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_job_end(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg, RJournal *journal)
 {
     REvent *event = NULL;
     cassert_no_null(report);
     event = i_get_event(report->jobs, job_id, step_id);
     i_event_end(event, ok, error_msg);
+    if (journal != NULL)
+        i_journal_step(journal, ekJRECORD_JOB_END, report, job_id, step_id);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_time(RTime *time)
+{
+    dbind_remove(time, RTime);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_add_time(ArrSt(RTime) *times, const char_t *job, const char_t *step, const char_t *hostname, const uint32_t repo_vers, const bool_t warm, const int32_t seconds)
+{
+    RTime *time = NULL;
+    uint32_t n = 0, first = UINT32_MAX;
+
+    /* Drop the oldest sample of this job step and build mode (keep the last cold one) */
+    arrst_foreach(ctime, times, RTime)
+        if (ctime->warm == warm && str_equ(ctime->job, job) == TRUE && str_equ(ctime->step, step) == TRUE)
+        {
+            if (first == UINT32_MAX)
+                first = ctime_i;
+            n += 1;
+        }
+    arrst_end()
+
+    if (n >= i_MAX_TIMES)
+        arrst_delete(times, first, i_remove_time, RTime);
+
+    time = arrst_new(times, RTime);
+    dbind_init(time, RTime);
+    str_upd(&time->job, job);
+    str_upd(&time->step, step);
+    str_upd(&time->hostname, hostname);
+    time->repo_vers = repo_vers;
+    time->warm = warm;
+    time->seconds = seconds;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_test(RTest *test)
+{
+    dbind_remove(test, RTest);
 }
 
 /*---------------------------------------------------------------------------*/
 
-void report_job(Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors)
+static void i_blob_clear(RBlob *blob)
+{
+    cassert_no_null(blob);
+    str_upd(&blob->hash, "");
+    blob->size = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_job(Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, ArrSt(RTest) **tests, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors, RJournal *journal)
 {
     RJob *job = NULL;
     RStep *step = NULL;
     cassert_no_null(report);
     job = arrst_get(report->jobs, job_id, RJob);
     cassert_no_null(job);
-    cassert(str_empty(job->hostname) || str_equ(job->hostname, hostname));
     cassert_no_null(cmake_log);
     cassert_no_null(build_log);
     cassert_no_null(install_log);
@@ -801,6 +1178,7 @@ void report_job(Report *report, const uint32_t job_id, const char_t *step_id, co
         str_destroy(&step->cmake_log);
         step->cmake_log = *cmake_log;
         *cmake_log = NULL;
+        i_blob_clear(&step->cmake_blob);
     }
 
     if (*build_log != NULL)
@@ -808,6 +1186,7 @@ void report_job(Report *report, const uint32_t job_id, const char_t *step_id, co
         str_destroy(&step->build_log);
         step->build_log = *build_log;
         *build_log = NULL;
+        i_blob_clear(&step->build_blob);
     }
 
     if (*install_log != NULL)
@@ -815,6 +1194,17 @@ void report_job(Report *report, const uint32_t job_id, const char_t *step_id, co
         str_destroy(&step->install_log);
         step->install_log = *install_log;
         *install_log = NULL;
+        i_blob_clear(&step->install_blob);
+    }
+
+    /* Individual test results replace the old concatenated test log */
+    if (tests != NULL && *tests != NULL)
+    {
+        arrst_destroy(&step->tests, i_remove_test, RTest);
+        str_upd(&step->install_log, "");
+        i_blob_clear(&step->install_blob);
+        step->tests = *tests;
+        *tests = NULL;
     }
 
     if (*warns != NULL)
@@ -822,6 +1212,7 @@ void report_job(Report *report, const uint32_t job_id, const char_t *step_id, co
         str_destroy(&step->warns);
         step->warns = *warns;
         *warns = NULL;
+        i_blob_clear(&step->warns_blob);
     }
 
     if (*errors != NULL)
@@ -829,10 +1220,19 @@ void report_job(Report *report, const uint32_t job_id, const char_t *step_id, co
         str_destroy(&step->errors);
         step->errors = *errors;
         *errors = NULL;
+        i_blob_clear(&step->errors_blob);
     }
 
     step->nerrors = nerrors;
     step->nwarns = nwarns;
+
+    /* Only successful steps are useful as duration samples */
+    if (i_is_done(&step->event) == TRUE && str_empty(step->event.error_msg) == TRUE)
+    {
+        i_add_time(report->times, tc(job->name), step_id, hostname, report->repo_vers, step->incremental == TRUE && step->warm == TRUE, step->event.seconds);
+        if (journal != NULL)
+            i_journal_time(journal, report);
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -887,65 +1287,344 @@ const char_t *report_job_host(const Report *report, const SJob *sjob)
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_block_jobs(const REvent *event, const uint32_t loop_id)
+void report_job_times(const Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds)
+{
+    const RJob *rjob = NULL;
+    cassert_no_null(report);
+    rjob = arrst_get_const(report->jobs, job_id, RJob);
+    cassert_no_null(rjob);
+    report_times(report, tc(rjob->name), step_id, hostname, seconds);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_times(const Report *report, const char_t *job, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds)
+{
+    /* NULL job or hostname matches any of them */
+    cassert_no_null(report);
+    arrst_clear(seconds, NULL, uint32_t);
+    arrst_foreach_const(time, report->times, RTime)
+        if ((job == NULL || str_equ(time->job, job) == TRUE) && str_equ(time->step, step_id) == TRUE)
+        {
+            if (hostname == NULL || str_equ(time->hostname, hostname) == TRUE)
+                arrst_append(seconds, (uint32_t)time->seconds, uint32_t);
+        }
+    arrst_end()
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_boot_time(Report *report, const char_t *hostname, const uint32_t seconds, RJournal *journal)
+{
+    /* Boot durations are kept as 'boot' samples of the host itself */
+    cassert_no_null(report);
+    i_add_time(report->times, hostname, "boot", hostname, report->repo_vers, FALSE, (int32_t)seconds);
+    if (journal != NULL)
+        i_journal_time(journal, report);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_host_ncpus(Report *report, const char_t *hostname, const uint32_t ncpus, RJournal *journal)
+{
+    const RHost *host = NULL;
+    cassert_no_null(report);
+    host = i_set_ncpus(report->hosts, hostname, ncpus);
+    if (journal != NULL)
+        i_journal_host(journal, host);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t report_ncpus(const Report *report, const char_t *hostname)
+{
+    /* 0 if the host has never been probed */
+    cassert_no_null(report);
+    arrst_foreach_const(host, report->hosts, RHost)
+        if (str_equ(host->name, hostname) == TRUE)
+            return host->ncpus;
+    arrst_end()
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_times_import(Report *report, const Report *from)
+{
+    cassert_no_null(report);
+    cassert_no_null(from);
+    arrst_foreach_const(time, from->times, RTime)
+        i_add_time(report->times, tc(time->job), tc(time->step), tc(time->hostname), time->repo_vers, time->warm, time->seconds);
+    arrst_end()
+
+    arrst_foreach_const(host, from->hosts, RHost)
+        i_set_ncpus(report->hosts, tc(host->name), host->ncpus);
+    arrst_end()
+}
+
+/*---------------------------------------------------------------------------*/
+
+RJournal *report_journal_create(const Login *login, const char_t *path, const Report *report, const uint32_t nrecords)
+{
+    RJournal *journal = heap_new0(RJournal);
+    cassert_no_null(report);
+    journal->login = login;
+    journal->path = str_c(path);
+    journal->pending = stm_memory(1024);
+    journal->nrecords = nrecords;
+    journal->gen = report->journal_gen;
+    return journal;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_journal_destroy(RJournal **journal)
+{
+    cassert_no_null(journal);
+    cassert_no_null(*journal);
+    str_destroy(&(*journal)->path);
+    stm_close(&(*journal)->pending);
+    heap_delete(journal, RJournal);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t report_journal_flush(RJournal *journal)
+{
+    cassert_no_null(journal);
+    if (stm_buffer_size(journal->pending) == 0)
+        return TRUE;
+
+    /* On failure, the records are kept and go with the next flush */
+    if (ssh_append_file(journal->login, tc(journal->path), NBUILD_REPORT_JOURNAL, journal->pending) == FALSE)
+        return FALSE;
+
+    stm_close(&journal->pending);
+    journal->pending = stm_memory(1024);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t report_journal_nrecords(const RJournal *journal)
+{
+    cassert_no_null(journal);
+    return journal->nrecords;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t report_journal_gen(const Report *report)
+{
+    cassert_no_null(report);
+    return report->journal_gen;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_journal_set_gen(Report *report, const uint32_t gen)
+{
+    cassert_no_null(report);
+    report->journal_gen = gen;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_journal_compacted(RJournal *journal, const Report *report)
+{
+    cassert_no_null(journal);
+    cassert_no_null(report);
+    /* The snapshot already has the records not flushed yet */
+    stm_close(&journal->pending);
+    journal->pending = stm_memory(1024);
+    journal->nrecords = 0;
+    journal->gen = report->journal_gen;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_replay_step(Report *report, const jrecord_t type, Stream *stm)
+{
+    RJStep *jstep = dbind_read(stm, RJStep);
+    cassert_no_null(report);
+    if (jstep != NULL)
+    {
+        RJob *job = NULL;
+        RStep *step = NULL;
+        if (type == ekJRECORD_JOB_ADD)
+            i_add_job(report->jobs, tc(jstep->job), tc(jstep->generator), jstep->priority, (bool_t)(jstep->nsteps == 2));
+
+        job = i_get_job(report->jobs, tc(jstep->job), NULL);
+        if (job != NULL && type != ekJRECORD_JOB_ADD)
+        {
+            arrst_foreach(cstep, job->steps, RStep)
+                if (str_equ(cstep->name, tc(jstep->step)) == TRUE)
+                    step = cstep;
+            arrst_end()
+        }
+
+        if (step != NULL)
+        {
+            if (type == ekJRECORD_JOB_MODE)
+            {
+                step->incremental = jstep->incremental;
+                step->warm = jstep->warm;
+                step->njobs = jstep->njobs;
+            }
+            else
+            {
+                REvent swap = step->event;
+                step->event = jstep->event;
+                jstep->event = swap;
+            }
+        }
+
+        dbind_destroy(&jstep, RJStep);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_replay_host(Report *report, Stream *stm)
+{
+    RHost *host = dbind_read(stm, RHost);
+    cassert_no_null(report);
+    if (host != NULL)
+    {
+        i_set_ncpus(report->hosts, tc(host->name), host->ncpus);
+        dbind_destroy(&host, RHost);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_replay_time(Report *report, Stream *stm)
+{
+    RTime *time = dbind_read(stm, RTime);
+    cassert_no_null(report);
+    if (time != NULL)
+    {
+        i_add_time(report->times, tc(time->job), tc(time->step), tc(time->hostname), time->repo_vers, time->warm, time->seconds);
+        dbind_destroy(&time, RTime);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t report_journal_replay(Report *report, const Stream *journal)
+{
+    const byte_t *data = stm_buffer(journal);
+    uint32_t size = stm_buffer_size(journal);
+    uint32_t pos = 0, nrecords = 0;
+    cassert_no_null(report);
+
+    /*
+     * A torn record at the end (interrupted append) is ignored.
+     * Records of other generations are already in the snapshot (the journal
+     * was not deleted after the last compaction), so they are skipped.
+     */
+    while (pos + 16 <= size)
+    {
+        Stream *head = stm_from_block(data + pos, 16);
+        uint32_t magic = stm_read_u32(head);
+        uint32_t gen = stm_read_u32(head);
+        uint32_t type = stm_read_u32(head);
+        uint32_t isize = stm_read_u32(head);
+        stm_close(&head);
+
+        if (magic != i_JOURNAL_MAGIC || pos + 16 + isize > size)
+            break;
+
+        if (gen == report->journal_gen)
+        {
+            Stream *stm = stm_from_block(data + pos + 16, isize);
+            switch ((jrecord_t)type)
+            {
+            case ekJRECORD_JOB_ADD:
+            case ekJRECORD_JOB_INIT:
+            case ekJRECORD_JOB_MODE:
+            case ekJRECORD_JOB_END:
+                i_replay_step(report, (jrecord_t)type, stm);
+                break;
+            case ekJRECORD_TIME:
+                i_replay_time(report, stm);
+                break;
+            case ekJRECORD_HOST:
+                i_replay_host(report, stm);
+                break;
+            default:
+                break;
+            }
+            stm_close(&stm);
+            nrecords += 1;
+        }
+
+        pos += 16 + isize;
+    }
+
+    return nrecords;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_block_jobs(const REvent *event)
 {
     cassert_no_null(event);
-    cassert(event->loop_id == UINT32_MAX || event->loop_id <= loop_id);
     if (i_is_done(event) == FALSE)
         return TRUE;
-    if (event->loop_id == loop_id)
+    if (str_empty(event->error_msg) == FALSE)
         return TRUE;
     return FALSE;
 }
 
 /*---------------------------------------------------------------------------*/
 
-bool_t report_can_start_jobs(const Report *report, const uint32_t doc_repo_vers)
+bool_t report_can_start_jobs(const Report *report)
 {
     cassert_no_null(report);
     /*
-     * Build jobs can start only if all events related with
-     * 'sources' and 'documentation' were done if previous loops
+     * Build jobs can start only if all events related with 'sources' were done.
+     * Documentation is generated concurrently and doesn't block the jobs.
      * */
     arrst_foreach_const(target, report->targets, RTarget)
-        if (i_block_jobs(&target->event, report->loop_id) == TRUE)
+        if (i_block_jobs(&target->event) == TRUE)
             return FALSE;
     arrst_end()
 
     arrst_foreach_const(path, report->tests, RTarget)
-        if (i_block_jobs(&path->event, report->loop_id) == TRUE)
+        if (i_block_jobs(&path->event) == TRUE)
             return FALSE;
     arrst_end()
 
-    if (i_block_jobs(&report->build_file, report->loop_id) == TRUE)
+    if (i_block_jobs(&report->build_file) == TRUE)
         return FALSE;
 
-    if (i_block_jobs(&report->src_tar, report->loop_id) == TRUE)
+    if (i_block_jobs(&report->src_tar) == TRUE)
         return FALSE;
 
-    if (doc_repo_vers != UINT32_MAX)
-    {
-        const RDoc *rdoc = i_get_doc(report->docs, doc_repo_vers);
-        cassert_no_null(rdoc);
-        if (i_block_jobs(&rdoc->event, report->loop_id) == TRUE)
-            return FALSE;
-    }
-
     return TRUE;
 }
 
 /*---------------------------------------------------------------------------*/
 
-void report_force_jobs(Report *report, const char_t *job_pattern, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests)
+static void i_add_jobs(Report *report, const ArrSt(Job) *jobs, const bool_t with_tests, RJournal *journal)
+{
+    /* Check that all jobs are in report. New ones are journaled, in order, before their events */
+    arrst_foreach_const(job, jobs, Job)
+        if (i_add_job(report->jobs, tc(job->name), tc(job->generator), job->priority, with_tests) == TRUE && journal != NULL)
+            i_journal_step(journal, ekJRECORD_JOB_ADD, report, arrst_size(report->jobs, RJob) - 1, "build");
+    arrst_end()
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_force_jobs(Report *report, const char_t *job_pattern, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests, RJournal *journal)
 {
     RegEx *regex = regex_create(job_pattern);
     cassert_no_null(report);
     arrst_clear(seljobs, NULL, SJob);
 
-    /* Check that all jobs are in report */
-    arrst_foreach_const(job, jobs, Job)
-        i_add_job(report->jobs, tc(job->name), tc(job->generator), job->priority, with_tests);
-    arrst_end()
+    i_add_jobs(report, jobs, with_tests, journal);
 
     /* Select all jobs to be done. Doesn't matter if have be done in previous loops.  */
     arrst_foreach_const(job, jobs, Job)
@@ -972,16 +1651,13 @@ void report_force_jobs(Report *report, const char_t *job_pattern, const ArrSt(Jo
 
 /*---------------------------------------------------------------------------*/
 
-void report_select_jobs(Report *report, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests)
+void report_select_jobs(Report *report, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests, RJournal *journal)
 {
     uint32_t i = 1, max_priority = 50;
     cassert_no_null(report);
     arrst_clear(seljobs, NULL, SJob);
 
-    /* Check that all jobs are in report */
-    arrst_foreach_const(job, jobs, Job)
-        i_add_job(report->jobs, tc(job->name), tc(job->generator), job->priority, with_tests);
-    arrst_end()
+    i_add_jobs(report, jobs, with_tests, journal);
 
     /* Select all jobs to be done in this loop */
     for (i = 1; i <= max_priority; ++i)
@@ -1042,6 +1718,50 @@ static void i_stm_date(Stream *stm, const Date *d)
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_has_log(const String *log, const RBlob *blob)
+{
+    cassert_no_null(blob);
+    if (str_empty(log) == FALSE)
+        return TRUE;
+    return (bool_t)(str_empty(blob->hash) == FALSE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_stm_log(Stream *stm, LogStore *logstore, const String *log, const RBlob *blob, const bool_t base64)
+{
+    cassert_no_null(blob);
+    if (str_empty(log) == FALSE)
+    {
+        if (base64 == TRUE)
+        {
+            Buffer *buffer = b64_decode_from_str(log);
+            stm_write(stm, buffer_const(buffer), buffer_size(buffer));
+            buffer_destroy(&buffer);
+        }
+        else
+        {
+            stm_writef(stm, tc(log));
+        }
+    }
+    /* Out-of-line logs are only loaded when the page needs them */
+    else if (str_empty(blob->hash) == FALSE)
+    {
+        Buffer *buffer = logstore_get(logstore, tc(blob->hash));
+        if (buffer != NULL)
+        {
+            stm_write(stm, buffer_const(buffer), buffer_size(buffer));
+            buffer_destroy(&buffer);
+        }
+        else
+        {
+            stm_printf(stm, "Log '%s' (%d bytes) not available\n", tc(blob->hash), blob->size);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_stm_datetime(Stream *stm, const Date *d, const bool_t paragraph)
 {
     char_t date[64];
@@ -1180,6 +1900,19 @@ static bool_t i_job_done(const RJob *job)
 
 /*---------------------------------------------------------------------------*/
 
+/* Most recent duration of a job step in the history, by build mode */
+static int32_t i_last_time(const ArrSt(RTime) *times, const char_t *job, const char_t *step, const bool_t warm)
+{
+    int32_t seconds = 0;
+    arrst_foreach_const(time, times, RTime)
+        if (time->warm == warm && str_equ(time->job, job) == TRUE && str_equ(time->step, step) == TRUE)
+            seconds = time->seconds;
+    arrst_end()
+    return seconds;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static uint32_t i_jobs_done(const ArrSt(RJob) *jobs)
 {
     uint32_t n = 0;
@@ -1328,7 +2061,7 @@ static const char_t *i_job_bgcolor(const uint32_t priority)
 
 /*---------------------------------------------------------------------------*/
 
-Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Global *global, const char_t *project_vers)
+Stream *report_ndoc_page(const Report *report, LogStore *logstore, const ArrSt(Job) *jobs, const Global *global, const char_t *project_vers)
 {
     Stream *stm = stm_memory(1024);
     uint32_t nloops = UINT32_MAX;
@@ -1514,7 +2247,10 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
 
                 stm_printf(stm, "p.%s\n", tc(job->hostname));
                 stm_printf(stm, "p.%s\n", tc(job->generator));
-                stm_printf(stm, "p.%ds\n", bstep->event.seconds);
+                if (bstep->incremental == TRUE)
+                    stm_printf(stm, "p.%ds (%s)\n", bstep->event.seconds, bstep->warm == TRUE ? "warm" : "cold");
+                else
+                    stm_printf(stm, "p.%ds\n", bstep->event.seconds);
 
                 if (tstep != NULL && i_is_done(&tstep->event) == TRUE)
                     stm_printf(stm, "p.%ds\n", tstep->event.seconds);
@@ -1576,6 +2312,18 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
 
             stm_printf(stm, "h2.%s\n", tc(job->name));
 
+            if (bstep->njobs > 0)
+                stm_printf(stm, "p.Built in <b>%s</b> with <b>%d</b> parallel jobs.\n", tc(job->hostname), bstep->njobs);
+
+            /* Incremental build win */
+            if (bstep->incremental == TRUE)
+            {
+                int32_t warm_seconds = i_last_time(report->times, tc(job->name), tc(bstep->name), TRUE);
+                int32_t cold_seconds = i_last_time(report->times, tc(job->name), tc(bstep->name), FALSE);
+                if (cold_seconds > 0 && warm_seconds > 0)
+                    stm_printf(stm, "p.Incremental build: last warm <b>%ds</b>, last cold <b>%ds</b>.\n", warm_seconds, cold_seconds);
+            }
+
             /* Execution errors */
             if (str_empty(bstep->event.error_msg) == FALSE)
             {
@@ -1589,14 +2337,14 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
             if (bstep->nerrors > 0)
             {
                 stm_printf(stm, "code(text,,1,open).Build <b>%d</b> errors\n", bstep->nerrors);
-                stm_writef(stm, tc(bstep->errors));
+                i_stm_log(stm, logstore, bstep->errors, &bstep->errors_blob, FALSE);
                 stm_writef(stm, "code.\n");
             }
 
             if (bstep->nwarns > 0)
             {
                 stm_printf(stm, "code(text,,1,open).Build <b>%d</b> warnings\n", bstep->nwarns);
-                stm_writef(stm, tc(bstep->warns));
+                i_stm_log(stm, logstore, bstep->warns, &bstep->warns_blob, FALSE);
                 stm_writef(stm, "code.\n");
             }
 
@@ -1613,69 +2361,74 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
 
                 if (tstep->nerrors > 0)
                 {
-                    Buffer *buffer = b64_decode_from_str(tstep->errors);
                     stm_printf(stm, "code(ansi,,1,open).Test <b>%d</b> errors\n", tstep->nerrors);
-                    stm_write(stm, buffer_const(buffer), buffer_size(buffer));
+                    i_stm_log(stm, logstore, tstep->errors, &tstep->errors_blob, TRUE);
                     stm_writef(stm, "code.\n");
-                    buffer_destroy(&buffer);
                 }
 
                 if (tstep->nwarns > 0)
                 {
-                    Buffer *buffer = b64_decode_from_str(tstep->warns);
                     stm_printf(stm, "code(ansi,,1,open).Test <b>%d</b> warnings\n", tstep->nwarns);
-                    stm_write(stm, buffer_const(buffer), buffer_size(buffer));
+                    i_stm_log(stm, logstore, tstep->warns, &tstep->warns_blob, TRUE);
                     stm_writef(stm, "code.\n");
-                    buffer_destroy(&buffer);
                 }
             }
 
             /* Build logs */
-            if (str_empty(bstep->cmake_log) == FALSE)
+            if (i_has_log(bstep->cmake_log, &bstep->cmake_blob) == TRUE)
             {
                 stm_writef(stm, "code(text,,1,close).Build cmake log\n");
-                stm_writef(stm, tc(bstep->cmake_log));
+                i_stm_log(stm, logstore, bstep->cmake_log, &bstep->cmake_blob, FALSE);
                 stm_writef(stm, "code.\n");
             }
 
-            if (str_empty(bstep->build_log) == FALSE)
+            if (i_has_log(bstep->build_log, &bstep->build_blob) == TRUE)
             {
                 stm_writef(stm, "code(text,,1,close).Build log\n");
-                stm_writef(stm, tc(bstep->build_log));
+                i_stm_log(stm, logstore, bstep->build_log, &bstep->build_blob, FALSE);
                 stm_writef(stm, "code.\n");
             }
 
-            if (str_empty(bstep->install_log) == FALSE)
+            if (i_has_log(bstep->install_log, &bstep->install_blob) == TRUE)
             {
                 stm_writef(stm, "code(text,,1,close).Install log\n");
-                stm_writef(stm, tc(bstep->install_log));
+                i_stm_log(stm, logstore, bstep->install_log, &bstep->install_blob, FALSE);
                 stm_writef(stm, "code.\n");
             }
 
             if (tstep != NULL)
             {
-                if (str_empty(tstep->cmake_log) == FALSE)
+                if (i_has_log(tstep->cmake_log, &tstep->cmake_blob) == TRUE)
                 {
                     stm_writef(stm, "code(text,,1,close).Test cmake log\n");
-                    stm_writef(stm, tc(tstep->cmake_log));
+                    i_stm_log(stm, logstore, tstep->cmake_log, &tstep->cmake_blob, FALSE);
                     stm_writef(stm, "code.\n");
                 }
 
-                if (str_empty(tstep->build_log) == FALSE)
+                if (i_has_log(tstep->build_log, &tstep->build_blob) == TRUE)
                 {
                     stm_writef(stm, "code(text,,1,close).Test build log\n");
-                    stm_writef(stm, tc(tstep->build_log));
+                    i_stm_log(stm, logstore, tstep->build_log, &tstep->build_blob, FALSE);
                     stm_writef(stm, "code.\n");
                 }
 
-                if (str_empty(tstep->install_log) == FALSE)
+                if (i_has_log(tstep->install_log, &tstep->install_blob) == TRUE)
                 {
-                    Buffer *buffer = b64_decode_from_str(tstep->install_log);
                     stm_writef(stm, "code(ansi,,1,close).Test run log\n");
-                    stm_write(stm, buffer_const(buffer), buffer_size(buffer));
+                    i_stm_log(stm, logstore, tstep->install_log, &tstep->install_blob, TRUE);
                     stm_writef(stm, "code.\n");
-                    buffer_destroy(&buffer);
                 }
+
+                arrst_foreach_const(test, tstep->tests, RTest)
+                    const char_t *state = (test->ret == 0 && test->timeout == FALSE) ? "close" : "open";
+                    if (test->timeout == TRUE)
+                        stm_printf(stm, "code(ansi,,1,%s).Test '%s' <b>timeout</b> after %ds\n", state, tc(test->name), test->seconds);
+                    else
+                        stm_printf(stm, "code(ansi,,1,%s).Test '%s' exit <b>%d</b> in %ds\n", state, tc(test->name), test->ret, test->seconds);
+
+                    i_stm_log(stm, logstore, test->log, &test->log_blob, TRUE);
+                    stm_writef(stm, "code.\n");
+                arrst_end()
             }
         }
     arrst_end()
@@ -1714,12 +2467,9 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
             }
 
             /* Loop log */
-            if (str_empty(loop->log) == FALSE)
+            if (i_has_log(loop->log, &loop->log_blob) == TRUE)
             {
                 const char_t *state = ntasks > 0 ? "close" : "open";
-                Buffer *buffer = b64_decode_from_str(loop->log);
-                const byte_t *data = buffer_const(buffer);
-                uint32_t size = buffer_size(buffer);
                 int32_t seconds = (int32_t)date_ellapsed_seconds(&loop->init, &loop->end);
                 stm_printf(stm, "code(ansi,,1,%s).", state);
 
@@ -1728,9 +2478,8 @@ Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Glo
                 stm_printf(stm, "%d tasks completed in %d sec on ", ntasks, seconds);
                 i_stm_datetime(stm, &loop->init, FALSE);
                 stm_writef(stm, "\n");
-                stm_write(stm, data, size);
+                i_stm_log(stm, logstore, loop->log, &loop->log_blob, TRUE);
                 stm_writef(stm, "code.\n");
-                buffer_destroy(&buffer);
             }
 
             stm_writef(stm, "\n");
@@ -22,10 +22,30 @@ void report_loop_init(Report *report);
 
 void report_loop_end(Report *report, const char_t *logfile);
 
+void report_store_logs(Report *report, LogStore *logstore);
+
+RJournal *report_journal_create(const Login *login, const char_t *path, const Report *report, const uint32_t nrecords);
+
+void report_journal_destroy(RJournal **journal);
+
+bool_t report_journal_flush(RJournal *journal);
+
+uint32_t report_journal_nrecords(const RJournal *journal);
+
+uint32_t report_journal_gen(const Report *report);
+
+void report_journal_set_gen(Report *report, const uint32_t gen);
+
+void report_journal_compacted(RJournal *journal, const Report *report);
+
+uint32_t report_journal_replay(Report *report, const Stream *journal);
+
 uint32_t report_loop_current(const Report *report);
 
 uint32_t report_loop_seconds(const Report *report, const uint32_t loop_id);
 
+REvent *report_stage_event(Report *report, const char_t *name);
+
 void report_event_state(Report *report, const REvent *event, RState *state);
 
 void report_event_init(Report *report, REvent *event);
@@ -84,24 +104,38 @@ void report_doc(Report *report, const uint32_t doc_repo_vers, String **hosting_u
 
 void report_job_state(Report *report, const uint32_t job_id, const char_t *step_id, RState *state);
 
-void report_job_init(Report *report, const uint32_t job_id, const char_t *step_id);
+void report_job_init(Report *report, const uint32_t job_id, const char_t *step_id, RJournal *journal);
+
+void report_job_build_mode(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t incremental, const bool_t warm, const uint32_t njobs, RJournal *journal);
 
-void report_job_end(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg);
+void report_job_end(Report *report, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg, RJournal *journal);
 
-void report_job(Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors);
+void report_job(Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, ArrSt(RTest) **tests, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors, RJournal *journal);
 
 bool_t report_job_can_test(const Report *report, const uint32_t job_id);
 
 const char_t *report_job_host(const Report *report, const SJob *sjob);
 
-bool_t report_can_start_jobs(const Report *report, const uint32_t doc_repo_vers);
+void report_job_times(const Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds);
+
+void report_times(const Report *report, const char_t *job, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds);
+
+void report_boot_time(Report *report, const char_t *hostname, const uint32_t seconds, RJournal *journal);
+
+void report_host_ncpus(Report *report, const char_t *hostname, const uint32_t ncpus, RJournal *journal);
+
+uint32_t report_ncpus(const Report *report, const char_t *hostname);
+
+void report_times_import(Report *report, const Report *from);
+
+bool_t report_can_start_jobs(const Report *report);
 
-void report_force_jobs(Report *report, const char_t *job_pattern, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests);
+void report_force_jobs(Report *report, const char_t *job_pattern, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests, RJournal *journal);
 
-void report_select_jobs(Report *report, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests);
+void report_select_jobs(Report *report, const ArrSt(Job) *jobs, ArrSt(SJob) *seljobs, const bool_t with_tests, RJournal *journal);
 
 void report_log(const Report *report, const Global *global, const uint32_t repo_vers);
 
-Stream *report_ndoc_page(const Report *report, const ArrSt(Job) *jobs, const Global *global, const char_t *project_vers);
+Stream *report_ndoc_page(const Report *report, LogStore *logstore, const ArrSt(Job) *jobs, const Global *global, const char_t *project_vers);
 
 void report_state_log(const RState *state, const char_t *msg);
@@ -0,0 +1,382 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: rqueue.c
+ *
+ */
+
+/* Report updates from runner threads, applied by a single writer */
+
+#include "rqueue.h"
+#include "mpscq.h"
+#include "report.h"
+#include <nlib/nlib.h>
+#include <core/arrst.h>
+#include <core/heap.h>
+#include <core/strings.h>
+#include <osbs/bmutex.h>
+#include <osbs/bthread.h>
+#include <osbs/log.h>
+#include <sewer/bmem.h>
+#include <sewer/cassert.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define i_load(ptr) (_ReadWriteBarrier(), *(ptr))
+#define i_store(ptr, value) (_ReadWriteBarrier(), *(ptr) = (value))
+#else
+#define i_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define i_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#endif
+
+typedef struct _rrecord_t RRecord;
+
+typedef enum _rtype_t
+{
+    ekRTYPE_SYNC,
+    ekRTYPE_JOB_INIT,
+    ekRTYPE_JOB_MODE,
+    ekRTYPE_JOB_END,
+    ekRTYPE_JOB,
+    ekRTYPE_BOOT,
+    ekRTYPE_NCPUS
+} rtype_t;
+
+/* Immutable once pushed. The writer takes the ownership (except SYNC) */
+struct _rrecord_t
+{
+    MPSCNode node;
+    rtype_t type;
+    uint32_t job_id;
+    String *step_id;
+    String *hostname;
+    String *msg;
+    String *error_msg;
+    String *cmake_log;
+    String *build_log;
+    String *install_log;
+    ArrSt(RTest) *tests;
+    String *warns;
+    String *errors;
+    uint32_t nwarns;
+    uint32_t nerrors;
+    uint32_t njobs;
+    uint32_t seconds;
+    uint32_t ncpus;
+    bool_t ok;
+    bool_t incremental;
+    bool_t warm;
+    bool_t done;
+};
+
+struct _rqueue_t
+{
+    /* Producers only do one atomic exchange, see 'mpscq.c' */
+    MPSCQueue *records;
+    Report *report;
+    /* Optional. Records are appended as they are applied */
+    RJournal *journal;
+    /* Report reads from runners don't overlap the writer */
+    Mutex *mutex;
+    Thread *writer;
+    bool_t stop;
+};
+
+/* Writer poll interval when the queue is empty */
+static const uint32_t i_IDLE_MS = 5;
+
+/*---------------------------------------------------------------------------*/
+
+static void i_push(RQueue *queue, RRecord *record)
+{
+    cassert_no_null(queue);
+    cassert_no_null(record);
+    mpscq_push(queue->records, &record->node);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static RRecord *i_record(const rtype_t type, const uint32_t job_id, const char_t *step_id)
+{
+    RRecord *record = heap_new0(RRecord);
+    record->type = type;
+    record->job_id = job_id;
+    record->step_id = str_c(step_id);
+    return record;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_destroy_record(RRecord **record)
+{
+    cassert_no_null(record);
+    cassert_no_null(*record);
+    str_destroy(&(*record)->step_id);
+    str_destopt(&(*record)->hostname);
+    str_destopt(&(*record)->msg);
+    str_destopt(&(*record)->error_msg);
+    str_destopt(&(*record)->cmake_log);
+    str_destopt(&(*record)->build_log);
+    str_destopt(&(*record)->install_log);
+    str_destopt(&(*record)->warns);
+    str_destopt(&(*record)->errors);
+    cassert((*record)->tests == NULL);
+    heap_delete(record, RRecord);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_apply(Report *report, RJournal *journal, RRecord *record)
+{
+    cassert_no_null(record);
+    switch (record->type)
+    {
+    case ekRTYPE_JOB_INIT:
+        report_job_init(report, record->job_id, tc(record->step_id), journal);
+        break;
+
+    case ekRTYPE_JOB_MODE:
+        report_job_build_mode(report, record->job_id, tc(record->step_id), record->incremental, record->warm, record->njobs, journal);
+        break;
+
+    case ekRTYPE_JOB_END:
+    {
+        RState state;
+        report_job_end(report, record->job_id, tc(record->step_id), record->ok, &record->error_msg, journal);
+        report_job_state(report, record->job_id, tc(record->step_id), &state);
+        report_state_log(&state, tc(record->msg));
+        break;
+    }
+
+    case ekRTYPE_JOB:
+        report_job(report, record->job_id, tc(record->step_id), tc(record->hostname), &record->cmake_log, &record->build_log, &record->install_log, record->tests != NULL ? &record->tests : NULL, &record->warns, &record->errors, record->nwarns, record->nerrors, journal);
+        break;
+
+    case ekRTYPE_BOOT:
+        report_boot_time(report, tc(record->hostname), record->seconds, journal);
+        break;
+
+    case ekRTYPE_NCPUS:
+        report_host_ncpus(report, tc(record->hostname), record->ncpus, journal);
+        break;
+
+    case ekRTYPE_SYNC:
+    default:
+        cassert_default(record->type);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_drain(RQueue *queue)
+{
+    uint32_t n = 0;
+    RRecord *record = NULL;
+    cassert_no_null(queue);
+    while ((record = (RRecord *)mpscq_pop(queue->records)) != NULL)
+    {
+        if (record->type == ekRTYPE_SYNC)
+        {
+            /* The record belongs to the waiting thread */
+            i_store(&record->done, TRUE);
+        }
+        else
+        {
+            bmutex_lock(queue->mutex);
+            i_apply(queue->report, queue->journal, record);
+            bmutex_unlock(queue->mutex);
+            i_destroy_record(&record);
+        }
+
+        n += 1;
+    }
+
+    /* The whole batch in a single append */
+    if (n > 0 && queue->journal != NULL)
+    {
+        if (report_journal_flush(queue->journal) == FALSE)
+            log_printf("%s Appending report journal records", kASCII_WARN);
+    }
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_writer_thread(RQueue *queue)
+{
+    cassert_no_null(queue);
+    for (;;)
+    {
+        bool_t stop = i_load(&queue->stop);
+        if (i_drain(queue) == 0)
+        {
+            if (stop == TRUE)
+                break;
+            bthread_sleep(i_IDLE_MS);
+        }
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+RQueue *rqueue_create(Report *report, RJournal *journal)
+{
+    RQueue *queue = heap_new0(RQueue);
+    cassert_no_null(report);
+    queue->records = mpscq_create();
+    queue->report = report;
+    queue->journal = journal;
+    queue->mutex = bmutex_create();
+    queue->stop = FALSE;
+    queue->writer = bthread_create(i_writer_thread, queue, RQueue);
+    return queue;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_destroy(RQueue **queue)
+{
+    cassert_no_null(queue);
+    cassert_no_null(*queue);
+    /* All pushed records are applied before the writer finishes */
+    i_store(&(*queue)->stop, TRUE);
+    bthread_wait((*queue)->writer);
+    bthread_close(&(*queue)->writer);
+    mpscq_destroy(&(*queue)->records);
+    bmutex_close(&(*queue)->mutex);
+    heap_delete(queue, RQueue);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_sync(RQueue *queue)
+{
+    RRecord record;
+    cassert_no_null(queue);
+    bmem_zero(&record, RRecord);
+    record.type = ekRTYPE_SYNC;
+    record.done = FALSE;
+    i_push(queue, &record);
+    /* Every record pushed before by this thread is already applied */
+    while (i_load(&record.done) == FALSE)
+        bthread_sleep(1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_job_state(RQueue *queue, const uint32_t job_id, const char_t *step_id, bool_t *done)
+{
+    RState state;
+    cassert_no_null(queue);
+    cassert_no_null(done);
+    rqueue_sync(queue);
+    bmutex_lock(queue->mutex);
+    report_job_state(queue->report, job_id, step_id, &state);
+    bmutex_unlock(queue->mutex);
+    *done = state.done;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t rqueue_job_can_test(RQueue *queue, const uint32_t job_id)
+{
+    bool_t can_test = FALSE;
+    cassert_no_null(queue);
+    rqueue_sync(queue);
+    bmutex_lock(queue->mutex);
+    can_test = report_job_can_test(queue->report, job_id);
+    bmutex_unlock(queue->mutex);
+    return can_test;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_job_init(RQueue *queue, const uint32_t job_id, const char_t *step_id)
+{
+    i_push(queue, i_record(ekRTYPE_JOB_INIT, job_id, step_id));
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_job_build_mode(RQueue *queue, const uint32_t job_id, const char_t *step_id, const bool_t incremental, const bool_t warm, const uint32_t njobs)
+{
+    RRecord *record = i_record(ekRTYPE_JOB_MODE, job_id, step_id);
+    record->incremental = incremental;
+    record->warm = warm;
+    record->njobs = njobs;
+    i_push(queue, record);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_job_end(RQueue *queue, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg, String **msg)
+{
+    RRecord *record = i_record(ekRTYPE_JOB_END, job_id, step_id);
+    cassert_no_null(error_msg);
+    cassert_no_null(msg);
+    record->ok = ok;
+    record->error_msg = *error_msg;
+    record->msg = *msg;
+    *error_msg = NULL;
+    *msg = NULL;
+    i_push(queue, record);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_job(RQueue *queue, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, ArrSt(RTest) **tests, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors)
+{
+    RRecord *record = i_record(ekRTYPE_JOB, job_id, step_id);
+    cassert_no_null(cmake_log);
+    cassert_no_null(build_log);
+    cassert_no_null(install_log);
+    cassert_no_null(warns);
+    cassert_no_null(errors);
+    record->hostname = str_c(hostname);
+    record->cmake_log = *cmake_log;
+    record->build_log = *build_log;
+    record->install_log = *install_log;
+    record->warns = *warns;
+    record->errors = *errors;
+    record->nwarns = nwarns;
+    record->nerrors = nerrors;
+    *cmake_log = NULL;
+    *build_log = NULL;
+    *install_log = NULL;
+    *warns = NULL;
+    *errors = NULL;
+
+    if (tests != NULL)
+    {
+        record->tests = *tests;
+        *tests = NULL;
+    }
+
+    i_push(queue, record);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_boot_time(RQueue *queue, const char_t *hostname, const uint32_t seconds)
+{
+    RRecord *record = i_record(ekRTYPE_BOOT, UINT32_MAX, "boot");
+    record->hostname = str_c(hostname);
+    record->seconds = seconds;
+    i_push(queue, record);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void rqueue_host_ncpus(RQueue *queue, const char_t *hostname, const uint32_t ncpus)
+{
+    RRecord *record = i_record(ekRTYPE_NCPUS, UINT32_MAX, "ncpus");
+    record->hostname = str_c(hostname);
+    record->ncpus = ncpus;
+    i_push(queue, record);
+}
@@ -0,0 +1,35 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: rqueue.h
+ *
+ */
+
+/* Report updates from runner threads, applied by a single writer */
+
+#include "nbuild.hxx"
+
+RQueue *rqueue_create(Report *report, RJournal *journal);
+
+void rqueue_destroy(RQueue **queue);
+
+void rqueue_sync(RQueue *queue);
+
+void rqueue_job_state(RQueue *queue, const uint32_t job_id, const char_t *step_id, bool_t *done);
+
+bool_t rqueue_job_can_test(RQueue *queue, const uint32_t job_id);
+
+void rqueue_job_init(RQueue *queue, const uint32_t job_id, const char_t *step_id);
+
+void rqueue_job_build_mode(RQueue *queue, const uint32_t job_id, const char_t *step_id, const bool_t incremental, const bool_t warm, const uint32_t njobs);
+
+void rqueue_job_end(RQueue *queue, const uint32_t job_id, const char_t *step_id, const bool_t ok, String **error_msg, String **msg);
+
+void rqueue_job(RQueue *queue, const uint32_t job_id, const char_t *step_id, const char_t *hostname, String **cmake_log, String **build_log, String **install_log, ArrSt(RTest) **tests, String **warns, String **errors, const uint32_t nwarns, const uint32_t nerrors);
+
+void rqueue_boot_time(RQueue *queue, const char_t *hostname, const uint32_t seconds);
+
+void rqueue_host_ncpus(RQueue *queue, const char_t *hostname, const uint32_t ncpus);
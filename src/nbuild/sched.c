@@ -11,16 +11,17 @@
 /* nbuild scheduler */
 
 #include "sched.h"
+#include "estim.h"
 #include "host.h"
+#include "hostcaps.h"
 #include "report.h"
-#include "nboot.h"
+#include "rqueue.h"
 #include "nbuild.h"
 #include <nlib/nlib.h>
-#include <nlib/ssh.h>
 #include <core/arrst.h>
 #include <core/heap.h>
-#include <core/hfile.h>
 #include <core/strings.h>
+#include <osbs/btime.h>
 #include <osbs/bthread.h>
 #include <osbs/bmutex.h>
 #include <osbs/log.h>
@@ -29,6 +30,8 @@
 typedef struct _runner_t Runner;
 typedef struct _task_t Task;
 typedef struct _schedul_t Schedul;
+typedef struct _slot_t Slot;
+typedef struct _pboot_t PBoot;
 
 typedef enum _taskst_t
 {
@@ -47,11 +50,25 @@ struct _runner_t
     const ArrSt(Target) *tests;
     const WorkPaths *wpaths;
     const char_t *flowid;
-    Report *report;
+    const HostExec *exec;
+    Preboot *preboot;
     uint32_t repo_vers;
+    /* Median of past boot durations (UINT32_MAX if unknown) */
+    uint32_t boot_expect;
     runstate_t state;
+    bool_t active;
+    /* The runner has got its turn (and booted the host) */
+    bool_t turned;
+    /* macOS volume running on its Mac when the scheduler started */
+    bool_t macos_alive;
+    /* Its turn switched the Mac from another volume (a reboot) */
+    bool_t macos_switch;
     uint32_t thread_id;
     Thread *thread;
+    /* Slots of the same host share the source trees */
+    Mutex *src_mutex;
+    /* Toolchain probed after boot. NULL while the host is down */
+    HostCaps *caps;
 
     /* Access to 'sched' from runner thread must be mutual exclusion */
     Schedul *sched;
@@ -60,27 +77,79 @@ struct _runner_t
 struct _task_t
 {
     const SJob *sjob;
+    /* Pinned host. NULL if any capable host can run the task */
+    const Host *host;
+    /* Runner that took the task from the pool */
     const Runner *runner;
+    /* Historically fastest host for this task (NULL if unknown) */
+    const Host *fast_host;
+    /* Estimated duration (UINT32_MAX if unknown) */
+    uint32_t seconds;
     uint32_t job_id;
     taskst_t state;
+    /* Failure of a job pinned to a host out of network.json */
+    const char_t *error_step;
+    String *error_msg;
+};
+
+struct _slot_t
+{
+    /* A runner can execute several tasks at the same time */
+    Runner *runner;
+    uint32_t slot_id;
+    uint32_t njobs;
+    Thread *thread;
+};
+
+struct _pboot_t
+{
+    const HostExec *exec;
+    const Host *host;
+    const ArrSt(Host) *all_hosts;
+    uint32_t expect;
+    uint32_t seconds;
+    runstate_t state;
+    bool_t ok;
+    bool_t used;
+    Thread *thread;
+};
+
+struct _preboot_t
+{
+    Mutex *mutex;
+    ArrSt(PBoot) *boots;
 };
 
 struct _schedul_t
 {
+    /* Protects tasks and runners state */
     Mutex *mutex;
+    /* Report updates from runners */
+    RQueue *queue;
     ArrSt(Runner) *runners;
     ArrSt(Task) *tasks;
+    schedpol_t policy;
+    uint32_t next_slot_id;
 };
 
 /*---------------------------------------------------------------------------*/
 
 DeclSt(Runner);
 DeclSt(Task);
+DeclSt(Slot);
+DeclSt(PBoot);
 
 /*---------------------------------------------------------------------------*/
 
 static const char_t *i_BUILD_STEP = "build";
 static const char_t *i_TEST_STEP = "test";
+static const uint32_t i_CORES_PER_SLOT = 8;
+static const uint32_t i_DEFAULT_NJOBS = 4;
+/* Toolchain probes after boot, 5 seconds apart */
+static const uint32_t i_CAPS_PROBES = 3;
+/* Unknown durations in host selection (seconds) */
+static const uint32_t i_DEFAULT_JOB_SECONDS = 600;
+static const uint32_t i_DEFAULT_BOOT_SECONDS = 60;
 
 /*---------------------------------------------------------------------------*/
 
@@ -98,62 +167,63 @@ static void i_remove_runner(Runner *runner)
     cassert_no_null(runner);
     if (runner->thread != NULL)
         bthread_close(&runner->thread);
+    bmutex_close(&runner->src_mutex);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static Schedul *i_scheduler(void)
+static Schedul *i_scheduler(const schedpol_t policy)
 {
     Schedul *schel = heap_new0(Schedul);
     schel->mutex = bmutex_create();
     schel->runners = arrst_create(Runner);
     schel->tasks = arrst_create(Task);
+    schel->policy = policy;
     return schel;
 }
 
 /*---------------------------------------------------------------------------*/
 
+static void i_remove_task(Task *task)
+{
+    cassert_no_null(task);
+    str_destopt(&task->error_msg);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void i_destroy_scheduler(Schedul **sched)
 {
     cassert_no_null(sched);
     cassert_no_null(*sched);
     arrst_destroy(&(*sched)->runners, i_remove_runner, Runner);
-    arrst_destroy(&(*sched)->tasks, NULL, Task);
+    arrst_destroy(&(*sched)->tasks, i_remove_task, Task);
     bmutex_close(&(*sched)->mutex);
     heap_delete(sched, Schedul);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static Runner *i_add_runner(const Global *global, ArrSt(Runner) *runners, const Host *host, const ArrSt(Host) *all_hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, Report *report, uint32_t repo_vers)
+static void i_add_runner(const Global *global, ArrSt(Runner) *runners, const Host *host, const ArrSt(Host) *all_hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const HostExec *exec, Preboot *preboot, uint32_t repo_vers, const uint32_t boot_expect)
 {
-    /* Check if runner already exists */
-    {
-        const char_t *hname = host_name(host);
-        arrst_foreach(runner, runners, Runner)
-            const char_t *rname = host_name(runner->host);
-            if (str_equ_c(hname, rname) == TRUE)
-            {
-                cassert(host == runner->host);
-                return runner;
-            }
-        arrst_end()
-    }
-
-    {
-        Runner *runner = arrst_new0(runners, Runner);
-        runner->global = global;
-        runner->host = host;
-        runner->all_hosts = all_hosts;
-        runner->drive = drive;
-        runner->tests = tests;
-        runner->wpaths = wpaths;
-        runner->flowid = flowid;
-        runner->report = report;
-        runner->repo_vers = repo_vers;
-        runner->state = ekRUNSTATE_NOT_INIT;
-        return runner;
-    }
+    Runner *runner = arrst_new0(runners, Runner);
+    runner->global = global;
+    runner->host = host;
+    runner->all_hosts = all_hosts;
+    runner->drive = drive;
+    runner->tests = tests;
+    runner->wpaths = wpaths;
+    runner->flowid = flowid;
+    runner->exec = exec;
+    runner->preboot = preboot;
+    runner->repo_vers = repo_vers;
+    runner->boot_expect = boot_expect;
+    runner->state = ekRUNSTATE_NOT_INIT;
+    runner->active = FALSE;
+    runner->turned = FALSE;
+    runner->macos_alive = FALSE;
+    runner->macos_switch = FALSE;
+    runner->src_mutex = bmutex_create();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -217,257 +287,1273 @@ static const char_t *i_state_str(const runstate_t state)
 
 /*---------------------------------------------------------------------------*/
 
-static Task *i_select_task_for_runner(Runner *runner)
+static bool_t i_state_booted(const runstate_t state)
 {
-    Task *stask = NULL;
-    cassert_no_null(runner);
-    cassert_no_null(runner->sched);
-    bmutex_lock(runner->sched->mutex);
-    arrst_foreach(task, runner->sched->tasks, Task)
-        cassert(!(task->state == ekTASK_RUNNING && task->runner == runner));
-        if (task->state == ekTASK_PENDING && task->runner == runner)
-        {
-            stask = task;
-            task->state = ekTASK_RUNNING;
-            break;
-        }
-    arrst_end()
-    bmutex_unlock(runner->sched->mutex);
-    return stask;
+    /* The host was really booted by nbuild (its duration is a sample for the next boots) */
+    switch (state)
+    {
+    case ekRUNSTATE_VBOX_WAKE_UP:
+    case ekRUNSTATE_UTM_WAKE_UP:
+    case ekRUNSTATE_VMWARE_WAKE_UP:
+    case ekRUNSTATE_MACOS_WAKE_UP:
+        return TRUE;
+    case ekRUNSTATE_NOT_INIT:
+    case ekRUNSTATE_ALREADY_RUNNING:
+    case ekRUNSTATE_VBOX_HOST_DOWN:
+    case ekRUNSTATE_VBOX_HOST_SSH:
+    case ekRUNSTATE_VBOX_HOST_VBOXMANAGE:
+    case ekRUNSTATE_VBOX_TIMEOUT:
+    case ekRUNSTATE_UTM_HOST_DOWN:
+    case ekRUNSTATE_UTM_HOST_SSH:
+    case ekRUNSTATE_UTM_HOST_UTMCTL:
+    case ekRUNSTATE_UTM_TIMEOUT:
+    case ekRUNSTATE_VMWARE_HOST_DOWN:
+    case ekRUNSTATE_VMWARE_HOST_SSH:
+    case ekRUNSTATE_VMWARE_HOST_VMRUN:
+    case ekRUNSTATE_VMWARE_TIMEOUT:
+    case ekRUNSTATE_MACOS_UNKNOWN_VERSION:
+    case ekRUNSTATE_MACOS_NOT_BOOTABLE:
+    case ekRUNSTATE_MACOS_CANT_BOOT_FROM_VOLUME:
+    case ekRUNSTATE_MACOS_TIMEOUT:
+    case ekRUNSTATE_UNREACHABLE:
+        return FALSE;
+    default:
+        cassert_default(state);
+    }
+
+    return FALSE;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void i_finish_runner_task(Task *task)
+static bool_t i_task_runnable(const Task *task, const Host *host)
 {
     cassert_no_null(task);
-    cassert(task->runner != NULL);
-    bmutex_lock(task->runner->sched->mutex);
-    cassert(task->state == ekTASK_RUNNING);
-    task->state = ekTASK_DONE;
-    bmutex_unlock(task->runner->sched->mutex);
+    cassert_no_null(task->sjob);
+    /* Pinned tasks only can be executed by its own host */
+    if (task->host != NULL)
+        return (bool_t)(task->host == host);
+    return host_can_run_job(host, task->sjob->job);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static uint32_t i_run_runner_thread(Runner *runner)
+static bool_t i_with_pending_tasks(const Schedul *sched, const Host *host)
 {
-    bool_t ok = TRUE;
-    const Login *login = NULL;
-    cassert_no_null(runner);
-    cassert_no_null(runner->global);
-    login = host_login(runner->host);
-
-    /* Booting the runner */
-    log_printf("%s Runner %s[%d]%s '%s%s%s' booting '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_TARGET, tc(login->ip), kASCII_RESET);
-    ok = nboot_boot(runner->host, runner->all_hosts, &runner->state);
-    if (ok == FALSE)
-        log_printf("%s Runner %s[%d]%s '%s%s%s' cannot be booted '%s%s::%s%s'", kASCII_SCHED_FAIL, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_ERROR, tc(login->ip), i_state_str(runner->state), kASCII_RESET);
+    cassert_no_null(sched);
+    arrst_foreach_const(task, sched->tasks, Task)
+        if (task->state == ekTASK_PENDING && i_task_runnable(task, host) == TRUE)
+            return TRUE;
+    arrst_end()
+    return FALSE;
+}
 
-    /* The runner is up */
-    if (ok == TRUE)
-    {
-        for (;;)
-        {
-            Task *task = i_select_task_for_runner(runner);
-            if (task != NULL)
-            {
-                /* Ready for configurable steps/pipeline */
-                {
-                    RState build_state;
-                    report_job_state(runner->report, task->sjob->id, i_BUILD_STEP, &build_state);
+/*---------------------------------------------------------------------------*/
 
-                    if (build_state.done == FALSE)
-                    {
-                        bool_t tok = TRUE;
-                        String *msg = str_printf("Job '%s%s%s'", kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                        String *error_msg = NULL;
-                        String *cmake_log = NULL;
-                        String *build_log = NULL;
-                        String *install_log = NULL;
-                        String *warns = NULL;
-                        String *errors = NULL;
-                        uint32_t nwarns = 0;
-                        uint32_t nerrors = 0;
-                        const char_t *hostname = host_name(runner->host);
-                        report_job_init(runner->report, task->sjob->id, i_BUILD_STEP);
-                        log_printf("%s Runner %s[%d]%s '%s%s%s' beginning job %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                        tok = host_run_build(runner->host, runner->drive, task->sjob->job, tc(runner->global->project), runner->wpaths, runner->repo_vers, runner->flowid, runner->thread_id, &cmake_log, &build_log, &install_log, &warns, &errors, &nwarns, &nerrors, &error_msg);
-                        report_job_end(runner->report, task->sjob->id, i_BUILD_STEP, tok, &error_msg);
-                        report_job_state(runner->report, task->sjob->id, i_BUILD_STEP, &build_state);
-                        log_printf("%s Runner %s[%d]%s '%s%s%s' complete job %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                        report_job(runner->report, task->sjob->id, i_BUILD_STEP, hostname, &cmake_log, &build_log, &install_log, &warns, &errors, nwarns, nerrors);
-                        report_state_log(&build_state, tc(msg));
-                        str_destroy(&msg);
-                    }
-                }
+static bool_t i_physical_host_busy(const Schedul *sched, const Runner *runner)
+{
+    const char_t *macos_host = NULL;
+    cassert_no_null(sched);
+    cassert_no_null(runner);
 
-                if (report_job_can_test(runner->report, task->sjob->id) == TRUE)
-                {
-                    RState test_state;
-                    bool_t tok = TRUE;
-                    String *msg = str_printf("Test '%s%s%s'", kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                    String *error_msg = NULL;
-                    String *cmake_log = NULL;
-                    String *build_log = NULL;
-                    String *install_log = NULL;
-                    String *warns = NULL;
-                    String *errors = NULL;
-                    uint32_t nwarns = 0;
-                    uint32_t nerrors = 0;
-                    const char_t *hostname = host_name(runner->host);
-                    report_job_init(runner->report, task->sjob->id, i_TEST_STEP);
-                    log_printf("%s Runner %s[%d]%s '%s%s%s' beginning test %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                    tok = host_run_test(runner->host, task->sjob->job, runner->tests, runner->wpaths, runner->repo_vers, runner->flowid, runner->thread_id, &cmake_log, &build_log, &install_log, &warns, &errors, &nwarns, &nerrors, &error_msg);
-                    report_job_end(runner->report, task->sjob->id, i_TEST_STEP, tok, &error_msg);
-                    report_job_state(runner->report, task->sjob->id, i_TEST_STEP, &test_state);
-                    log_printf("%s Runner %s[%d]%s '%s%s%s' complete test %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
-                    report_job(runner->report, task->sjob->id, i_TEST_STEP, hostname, &cmake_log, &build_log, &install_log, &warns, &errors, nwarns, nerrors);
-                    report_state_log(&test_state, tc(msg));
-                    str_destroy(&msg);
-                }
+    /* Several macOS volumes in the same Mac computer can't be running at the same time */
+    if (str_equ_c(host_type(runner->host), "macos") == FALSE)
+        return FALSE;
 
-                i_finish_runner_task(task);
-            }
-            else
-            {
-                break;
-            }
+    macos_host = host_macos_host(runner->host);
+    arrst_foreach_const(other, sched->runners, Runner)
+        if (other != runner && other->active == TRUE)
+        {
+            if (str_equ_c(host_type(other->host), "macos") == TRUE && str_equ_c(host_macos_host(other->host), macos_host) == TRUE)
+                return TRUE;
         }
-    }
+    arrst_end()
+    return FALSE;
+}
 
-    /* Shutdown */
-    if (ok == TRUE)
-    {
-        bool_t shutdown = nboot_shutdown(runner->host, runner->all_hosts, runner->state);
-        if (shutdown == TRUE)
-            log_printf("%s Runner %s[%d]%s '%s%s%s' shutting down", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET);
-    }
+/*---------------------------------------------------------------------------*/
 
-    return 0;
+static bool_t i_same_macos(const Runner *runner1, const Runner *runner2)
+{
+    if (str_equ_c(host_type(runner1->host), "macos") == FALSE || str_equ_c(host_type(runner2->host), "macos") == FALSE)
+        return FALSE;
+    return str_equ_c(host_macos_host(runner1->host), host_macos_host(runner2->host));
 }
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_prepare_before_runners(const Login *drive, const ArrSt(Task) *tasks, const ArrSt(Target) *tests, const WorkPaths *wpaths)
+static bool_t i_first_macos(const Schedul *sched, const Runner *runner)
 {
-    bool_t ok = TRUE;
-    bool_t with_build_tasks = FALSE;
-    bool_t with_test_tasks = FALSE;
-    cassert_no_null(wpaths);
+    /* The first runner of a Mac represents the whole computer */
+    cassert_no_null(sched);
+    arrst_foreach_const(other, sched->runners, Runner)
+        if (other == runner)
+            return TRUE;
+        if (i_same_macos(runner, other) == TRUE)
+            return FALSE;
+    arrst_end()
+    return FALSE;
+}
 
-    if (arrst_size(tasks, Task) > 0)
-        with_build_tasks = TRUE;
+/*---------------------------------------------------------------------------*/
 
-    arrst_foreach_const(test, tests, Target)
-        if (str_empty(test->exec) == FALSE)
+static void i_macos_alive(Schedul *sched, const ArrSt(Host) *hosts)
+{
+    cassert_no_null(sched);
+    arrst_foreach_const(runner, sched->runners, Runner)
+        if (str_equ_c(host_type(runner->host), "macos") == TRUE && i_first_macos(sched, runner) == TRUE)
         {
-            with_test_tasks = TRUE;
-            break;
+            const Host *alive = host_macos_alive(hosts, host_macos_host(runner->host));
+            arrst_foreach(other, sched->runners, Runner)
+                if (other->host == alive)
+                    other->macos_alive = TRUE;
+            arrst_end()
         }
     arrst_end()
+}
 
-    /*
-     * Get the source package from drive.
-     * Runners will not get the source code from repo, but from previous generated src package.
-     * This action will leave the package ready for distribute to runners
-     */
-    if (with_build_tasks == TRUE)
-    {
-        String *tarpath = str_cpath("%s/%s", tc(wpaths->tmp_path), NBUILD_SRC_TAR);
-        if (hfile_exists(tc(tarpath), NULL) == FALSE)
-        {
-            ok = ssh_copy(drive, tc(wpaths->drive_path), NBUILD_SRC_TAR, NULL, tc(wpaths->tmp_path), NBUILD_SRC_TAR, FALSE);
-            if (ok == FALSE)
-                log_printf("%s Error copying '%s' from '%s'", kASCII_SCHED_FAIL, NBUILD_SRC_TAR, tc(wpaths->drive_path));
-        }
+/*---------------------------------------------------------------------------*/
 
-        str_destroy(&tarpath);
-    }
+static bool_t i_preboot_pending(Preboot *preboot, const Host *host)
+{
+    bool_t pending = FALSE;
+    if (preboot == NULL)
+        return FALSE;
 
-    /* Same for tests */
-    if (with_test_tasks == TRUE)
-    {
-        String *tarpath = str_cpath("%s/%s", tc(wpaths->tmp_path), NBUILD_TEST_TAR);
-        if (hfile_exists(tc(tarpath), NULL) == FALSE)
+    bmutex_lock(preboot->mutex);
+    arrst_foreach_const(pboot, preboot->boots, PBoot)
+        if (pboot->host == host && pboot->used == FALSE)
         {
-            ok = ssh_copy(drive, tc(wpaths->drive_path), NBUILD_TEST_TAR, NULL, tc(wpaths->tmp_path), NBUILD_TEST_TAR, FALSE);
-            if (ok == FALSE)
-                log_printf("%s Error copying '%s' from '%s'", kASCII_SCHED_FAIL, NBUILD_TEST_TAR, tc(wpaths->drive_path));
+            pending = TRUE;
+            break;
         }
+    arrst_end()
+    bmutex_unlock(preboot->mutex);
+    return pending;
+}
 
-        str_destroy(&tarpath);
-    }
+/*---------------------------------------------------------------------------*/
 
-    return ok;
+static void i_macos_work(const Schedul *sched, const Runner *runner, uint32_t *exclusive, uint32_t *total)
+{
+    cassert_no_null(sched);
+    cassert_no_null(exclusive);
+    cassert_no_null(total);
+    *exclusive = 0;
+    *total = 0;
+    arrst_foreach_const(task, sched->tasks, Task)
+        if (task->state == ekTASK_PENDING && i_task_runnable(task, runner->host) == TRUE)
+        {
+            bool_t shared = FALSE;
+            arrst_foreach_const(other, sched->runners, Runner)
+                if (other != runner && other->turned == FALSE && i_same_macos(runner, other) == TRUE && i_task_runnable(task, other->host) == TRUE)
+                {
+                    shared = TRUE;
+                    break;
+                }
+            arrst_end()
+
+            if (shared == FALSE)
+                *exclusive += 1;
+            *total += 1;
+        }
+    arrst_end()
 }
 
 /*---------------------------------------------------------------------------*/
 
-void sched_start(const Global *global, ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const uint32_t repo_vers, Report *report)
+static bool_t i_macos_elected(const Schedul *sched, const Runner *runner)
 {
-    bool_t ok = TRUE;
-    Schedul *sched = i_scheduler();
+    const Runner *elected = NULL;
+    bool_t elected_booted = FALSE;
+    bool_t elected_alive = FALSE;
+    uint32_t elected_exclusive = 0;
+    uint32_t elected_total = 0;
+    cassert_no_null(sched);
+    cassert_no_null(runner);
 
-    cassert_no_null(drive);
+    if (str_equ_c(host_type(runner->host), "macos") == FALSE)
+        return TRUE;
 
-    /* Initial log messages */
-    log_printf("%s Beginning jobs with %s%d%s priority", kASCII_SCHED, kASCII_VERSION, i_priority(seljobs), kASCII_RESET);
-    arrst_foreach_const(sjob, seljobs, SJob)
-        cassert_no_null(sjob->job);
-        log_printf("%s %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, sjob_i, kASCII_RESET, kASCII_TARGET, tc(sjob->job->name), kASCII_RESET);
+    /*
+     * Each volume switch is a Mac reboot. The Mac goes to the volume being pre-booted
+     * first, or to the volume running on it, so all its jobs are done before the first
+     * switch. Then, to the volume with more jobs that no other waiting volume
+     * can run. Jobs shared between volumes are absorbed by the volumes that must boot
+     * anyway, so volumes left without work are never booted.
+     */
+    arrst_foreach_const(other, sched->runners, Runner)
+        if (other->turned == FALSE && (other == runner || i_same_macos(runner, other) == TRUE))
+        {
+            bool_t booted = i_preboot_pending(other->preboot, other->host);
+            uint32_t exclusive, total;
+            i_macos_work(sched, other, &exclusive, &total);
+            if (total > 0)
+            {
+                bool_t better = FALSE;
+                if (elected == NULL)
+                    better = TRUE;
+                else if (booted != elected_booted)
+                    better = booted;
+                else if (other->macos_alive != elected_alive)
+                    better = other->macos_alive;
+                else if (exclusive != elected_exclusive)
+                    better = (bool_t)(exclusive > elected_exclusive);
+                else
+                    better = (bool_t)(total > elected_total);
+
+                if (better == TRUE)
+                {
+                    elected = other;
+                    elected_booted = booted;
+                    elected_alive = other->macos_alive;
+                    elected_exclusive = exclusive;
+                    elected_total = total;
+                }
+            }
+        }
     arrst_end()
 
-    /* Look for runners that can run the jobs */
-    arrst_foreach_const(sjob, seljobs, SJob)
-        Task *task = arrst_new(sched->tasks, Task);
-        const char_t *hostname = report_job_host(report, sjob);
-        const Host *host = NULL;
+    return (bool_t)(elected == runner);
+}
 
-        task->sjob = sjob;
-        task->runner = NULL;
-        task->job_id = sjob_i;
-        task->state = ekTASK_PENDING;
+/*---------------------------------------------------------------------------*/
 
-        /* First, we check if this job has a pre-assigned host */
-        if (str_empty_c(hostname) == FALSE)
-            host = host_by_name(hosts, hostname);
-        else
-            host = host_match_job(hosts, sjob->job);
+static bool_t i_macos_switch(const Schedul *sched, const Runner *runner)
+{
+    /* The volume already running is not a reboot, unless another volume took the Mac before */
+    cassert_no_null(sched);
+    cassert_no_null(runner);
+    if (str_equ_c(host_type(runner->host), "macos") == FALSE)
+        return FALSE;
 
-        if (host != NULL)
-            task->runner = i_add_runner(global, sched->runners, host, hosts, drive, tests, wpaths, flowid, report, repo_vers);
+    if (runner->macos_alive == FALSE)
+        return TRUE;
 
+    arrst_foreach_const(other, sched->runners, Runner)
+        if (other != runner && other->turned == TRUE && i_same_macos(runner, other) == TRUE)
+            return TRUE;
     arrst_end()
+    return FALSE;
+}
 
-    if (ok == TRUE)
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_runner_wait_turn(Runner *runner)
+{
+    cassert_no_null(runner);
+    cassert_no_null(runner->sched);
+    for (;;)
     {
-        if (arrst_size(sched->runners, Runner) == 0)
+        bool_t with_work = FALSE;
+        bool_t busy = FALSE;
+        bmutex_lock(runner->sched->mutex);
+        with_work = i_with_pending_tasks(runner->sched, runner->host);
+        if (with_work == TRUE)
+            busy = i_physical_host_busy(runner->sched, runner);
+        if (with_work == TRUE && busy == FALSE && i_macos_elected(runner->sched, runner) == FALSE)
+            busy = TRUE;
+        if (with_work == TRUE && busy == FALSE)
         {
-            log_printf("%s No work can be started, as there is no host capable of doing so", kASCII_FAIL);
-            ok = FALSE;
+            runner->macos_switch = i_macos_switch(runner->sched, runner);
+            runner->active = TRUE;
+            runner->turned = TRUE;
         }
+        bmutex_unlock(runner->sched->mutex);
+
+        /* Other runners have taken all the work this runner could do */
+        if (with_work == FALSE)
+            return FALSE;
+
+        if (busy == FALSE)
+            return TRUE;
+
+        runner->exec->func_sleep(runner->exec->data, 5000);
     }
+}
 
-    if (ok == TRUE)
-        ok = i_prepare_before_runners(&drive->login, sched->tasks, tests, wpaths);
+/*---------------------------------------------------------------------------*/
 
-    if (ok == TRUE)
+static void i_runner_release(Runner *runner)
+{
+    cassert_no_null(runner);
+    bmutex_lock(runner->sched->mutex);
+    runner->active = FALSE;
+    bmutex_unlock(runner->sched->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_reserved_task(const Schedul *sched, const Task *task, const Runner *runner)
+{
+    cassert_no_null(sched);
+    cassert_no_null(task);
+    cassert_no_null(runner);
+    if (sched->policy != ekSCHED_LPT_AFFINITY)
+        return FALSE;
+
+    if (task->fast_host == NULL || task->fast_host == runner->host)
+        return FALSE;
+
+    /* The task is reserved to its fastest host, only if this host is alive */
+    arrst_foreach_const(other, sched->runners, Runner)
+        if (other->host == task->fast_host)
+            return other->active;
+    arrst_end()
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static Task *i_select_task_for_runner(Runner *runner)
+{
+    Task *stask = NULL;
+    uint32_t pass = 0;
+    cassert_no_null(runner);
+    cassert_no_null(runner->sched);
+    bmutex_lock(runner->sched->mutex);
+
+    /*
+     * Shared pool: The runner takes the first pending task (LPT sorted, except in FIFO policy)
+     * its host is capable to run. In first pass, tasks that historically are faster
+     * in another alive host are skipped. In second pass, any runnable task is taken.
+     */
+    for (pass = 0; pass < 2 && stask == NULL; ++pass)
     {
-        arrst_foreach(runner, sched->runners, Runner)
-            cassert(runner->thread == NULL);
-            cassert(runner->sched == NULL);
-            runner->thread_id = runner_i;
-            runner->sched = sched;
-            runner->thread = bthread_create(i_run_runner_thread, runner, Runner);
+        arrst_foreach(task, runner->sched->tasks, Task)
+            if (task->state == ekTASK_PENDING && i_task_runnable(task, runner->host) == TRUE)
+            {
+                if (pass == 1 || i_reserved_task(runner->sched, task, runner) == FALSE)
+                {
+                    stask = task;
+                    task->runner = runner;
+                    task->state = ekTASK_RUNNING;
+                    break;
+                }
+            }
         arrst_end()
+    }
 
-        /* Wait all threads for finish */
-        arrst_foreach(runner, sched->runners, Runner)
-            bthread_wait(runner->thread);
-        arrst_end()
+    bmutex_unlock(runner->sched->mutex);
+    return stask;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_finish_runner_task(Task *task)
+{
+    cassert_no_null(task);
+    cassert(task->runner != NULL);
+    bmutex_lock(task->runner->sched->mutex);
+    cassert(task->state == ekTASK_RUNNING);
+    task->state = ekTASK_DONE;
+    bmutex_unlock(task->runner->sched->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const char_t *i_pinned_hostname(Report *report, const SJob *sjob)
+{
+    RState build_state;
+    cassert_no_null(sjob);
+    cassert_no_null(sjob->job);
+
+    /* Pinning a job to a host is an explicit opt-in ('host' in workflow) */
+    if (str_empty(sjob->job->host) == FALSE)
+        return tc(sjob->job->host);
+
+    /* A job with the build done and test pending is pinned to build host, where binaries are installed */
+    report_job_state(report, sjob->id, i_BUILD_STEP, &build_state);
+    if (build_state.done == TRUE)
+        return report_job_host(report, sjob);
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_preboot_thread(PBoot *pboot)
+{
+    bool_t ok = FALSE;
+    runstate_t state = ekRUNSTATE_NOT_INIT;
+    uint64_t st = btime_now();
+    cassert_no_null(pboot);
+    cassert_no_null(pboot->exec);
+    ok = pboot->exec->func_boot(pboot->exec->data, pboot->host, pboot->all_hosts, pboot->expect, &state);
+    pboot->seconds = (uint32_t)((btime_now() - st) / 1000000);
+    pboot->state = state;
+    pboot->ok = ok;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_pboot(PBoot *pboot)
+{
+    cassert_no_null(pboot);
+    cassert(pboot->thread == NULL);
+    unref(pboot);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_same_physical_host(const Host *host1, const Host *host2)
+{
+    if (host1 == host2)
+        return TRUE;
+
+    /* Only one macOS volume can be booted in a Mac computer */
+    if (str_equ_c(host_type(host1), "macos") == TRUE && str_equ_c(host_type(host2), "macos") == TRUE)
+        return str_equ_c(host_macos_host(host1), host_macos_host(host2));
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_known(const uint32_t seconds, const uint32_t default_seconds)
+{
+    return seconds != UINT32_MAX ? seconds : default_seconds;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_host_index(const ArrSt(Host) *hosts, const Host *host)
+{
+    uint32_t i, n = arrst_size(hosts, Host);
+    for (i = 0; i < n; ++i)
+    {
+        if (arrst_get_const(hosts, i, Host) == host)
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_best_host(const ArrSt(Host) *hosts, Report *report, const SJob *sjob, const ArrSt(uint32_t) *queued, const ArrSt(bool_t) *booting, uint32_t *seconds)
+{
+    uint32_t i, n = arrst_size(hosts, Host);
+    uint32_t best = UINT32_MAX;
+    uint32_t best_time = UINT32_MAX;
+    uint32_t any_seconds = 0;
+    RState build_state;
+    cassert_no_null(sjob);
+    cassert_no_null(seconds);
+    report_job_state(report, sjob->id, i_BUILD_STEP, &build_state);
+    any_seconds = i_known(estim_job_seconds(report, sjob->id, build_state.done, NULL), i_DEFAULT_JOB_SECONDS);
+
+    /*
+     * Minimum expected completion time between capable hosts: work already predicted
+     * for the host, boot (if it isn't up or booting yet), slots and historical speed in the host.
+     * Without 'slots' in network.json, the capacity comes from the cores probed in
+     * the last boot of the host. Ties go to the first host in network.json.
+     */
+    for (i = 0; i < n; ++i)
+    {
+        const Host *host = arrst_get_const(hosts, i, Host);
+        if (host_can_run_job(host, sjob->job) == TRUE)
+        {
+            uint32_t job_seconds = i_known(estim_job_seconds(report, sjob->id, build_state.done, host_name(host)), any_seconds);
+            uint32_t boot = 0;
+            uint32_t time = 0;
+            if (*arrst_get_const(booting, i, bool_t) == FALSE)
+                boot = i_known(estim_boot_seconds(report, host_name(host)), i_DEFAULT_BOOT_SECONDS);
+
+            time = estim_completion(*arrst_get_const(queued, i, uint32_t), sched_num_slots(host, report_ncpus(report, host_name(host))), boot, job_seconds);
+            if (time < best_time)
+            {
+                best = i;
+                best_time = time;
+                *seconds = job_seconds;
+            }
+        }
+    }
+
+    return best;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_queue_host(const ArrSt(Host) *hosts, const uint32_t index, const uint32_t seconds, ArrSt(uint32_t) *queued, ArrSt(bool_t) *booting)
+{
+    const Host *host = arrst_get_const(hosts, index, Host);
+    uint32_t i, n = arrst_size(hosts, Host);
+
+    /* Volumes of the same Mac share the machine time */
+    for (i = 0; i < n; ++i)
+    {
+        if (i_same_physical_host(host, arrst_get_const(hosts, i, Host)) == TRUE)
+        {
+            uint32_t *load = arrst_get(queued, i, uint32_t);
+            *load = (*load > UINT32_MAX - seconds) ? UINT32_MAX : *load + seconds;
+        }
+    }
+
+    *arrst_get(booting, index, bool_t) = TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+Preboot *sched_preboot(const ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, Report *report, const HostExec *exec)
+{
+    Preboot *preboot = heap_new0(Preboot);
+    ArrSt(uint32_t) *queued = arrst_create(uint32_t);
+    ArrSt(bool_t) *booting = arrst_create(bool_t);
+    uint32_t i, n = arrst_size(hosts, Host);
+    cassert_no_null(exec);
+    preboot->mutex = bmutex_create();
+    preboot->boots = arrst_create(PBoot);
+
+    /* Hosts already up (kept warm or always on) don't pay the boot */
+    for (i = 0; i < n; ++i)
+    {
+        const Host *host = arrst_get_const(hosts, i, Host);
+        bool_t ready = FALSE;
+        arrst_foreach_const(sjob, seljobs, SJob)
+            if (host_can_run_job(host, sjob->job) == TRUE)
+            {
+                ready = exec->func_ready(exec->data, host);
+                break;
+            }
+        arrst_end()
+
+        if (ready == TRUE)
+            log_printf("%s '%s%s%s' already up", kASCII_SCHED, kASCII_PATH, host_name(host), kASCII_RESET);
+
+        arrst_append(queued, 0, uint32_t);
+        arrst_append(booting, ready, bool_t);
+    }
+
+    /* Predict the hosts that selected jobs will need, balancing the expected load */
+    arrst_foreach_const(sjob, seljobs, SJob)
+        const char_t *hostname = i_pinned_hostname(report, sjob);
+        const Host *host = NULL;
+        uint32_t index = UINT32_MAX;
+        uint32_t seconds = i_DEFAULT_JOB_SECONDS;
+        bool_t add = TRUE;
+
+        if (str_empty_c(hostname) == FALSE)
+            index = i_host_index(hosts, host_by_name(hosts, hostname));
+        else
+            index = i_best_host(hosts, report, sjob, queued, booting, &seconds);
+
+        if (index != UINT32_MAX)
+        {
+            host = arrst_get_const(hosts, index, Host);
+            i_queue_host(hosts, index, seconds, queued, booting);
+        }
+        else
+        {
+            add = FALSE;
+        }
+
+        arrst_foreach_const(pboot, preboot->boots, PBoot)
+            if (add == TRUE && i_same_physical_host(pboot->host, host) == TRUE)
+                add = FALSE;
+        arrst_end()
+
+        if (add == TRUE)
+        {
+            PBoot *pboot = arrst_new0(preboot->boots, PBoot);
+            pboot->exec = exec;
+            pboot->host = host;
+            pboot->all_hosts = hosts;
+            pboot->expect = estim_boot_seconds(report, host_name(host));
+            pboot->state = ekRUNSTATE_NOT_INIT;
+        }
+    arrst_end()
+
+    arrst_destroy(&queued, NULL, uint32_t);
+    arrst_destroy(&booting, NULL, bool_t);
+
+    /* All boots in parallel, the pipeline doesn't wait for them */
+    arrst_foreach(pboot, preboot->boots, PBoot)
+        log_printf("%s Pre-booting '%s%s%s'", kASCII_SCHED, kASCII_PATH, host_name(pboot->host), kASCII_RESET);
+        pboot->thread = bthread_create(i_preboot_thread, pboot, PBoot);
+    arrst_end()
+
+    return preboot;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_preboot_take(Preboot *preboot, const Host *host, bool_t *ok, runstate_t *state, uint32_t *seconds)
+{
+    bool_t taken = FALSE;
+    cassert_no_null(ok);
+    cassert_no_null(state);
+    cassert_no_null(seconds);
+    if (preboot == NULL)
+        return FALSE;
+
+    bmutex_lock(preboot->mutex);
+    arrst_foreach(pboot, preboot->boots, PBoot)
+        if (pboot->host == host && pboot->used == FALSE)
+        {
+            pboot->used = TRUE;
+            taken = TRUE;
+            break;
+        }
+    arrst_end()
+    bmutex_unlock(preboot->mutex);
+
+    /* The runner waits for the boot started at workflow beginning */
+    if (taken == TRUE)
+    {
+        arrst_foreach(pboot, preboot->boots, PBoot)
+            if (pboot->host == host)
+            {
+                bthread_wait(pboot->thread);
+                bthread_close(&pboot->thread);
+                *ok = pboot->ok;
+                *state = pboot->state;
+                *seconds = pboot->seconds;
+                break;
+            }
+        arrst_end()
+    }
+
+    return taken;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void sched_preboot_end(Preboot **preboot)
+{
+    cassert_no_null(preboot);
+    if (*preboot != NULL)
+    {
+        /* Mispredicted hosts (not used by any runner) are turned off */
+        arrst_foreach(pboot, (*preboot)->boots, PBoot)
+            if (pboot->used == FALSE)
+            {
+                cassert(pboot->thread != NULL);
+                bthread_wait(pboot->thread);
+                bthread_close(&pboot->thread);
+                if (pboot->ok == TRUE)
+                {
+                    bool_t shutdown = pboot->exec->func_shutdown(pboot->exec->data, pboot->host, pboot->all_hosts, pboot->state);
+                    if (shutdown == TRUE)
+                        log_printf("%s Pre-booted '%s%s%s' not used, shutting down", kASCII_SCHED_WARN, kASCII_PATH, host_name(pboot->host), kASCII_RESET);
+                }
+            }
+        arrst_end()
+
+        arrst_destroy(&(*preboot)->boots, i_remove_pboot, PBoot);
+        bmutex_close(&(*preboot)->mutex);
+        heap_delete(preboot, Preboot);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_runner_sources(Runner *runner, const char_t *kind, const char_t *tarname, const uint32_t slot_id, String **error_msg)
+{
+    bool_t ok = TRUE;
+    cassert_no_null(runner);
+    bmutex_lock(runner->src_mutex);
+    ok = runner->exec->func_sources(runner->exec->data, runner->host, runner->wpaths, runner->flowid, kind, tarname, runner->repo_vers, slot_id, error_msg);
+    bmutex_unlock(runner->src_mutex);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_run_task(Runner *runner, Task *task, const uint32_t slot_id, const uint32_t njobs)
+{
+    Schedul *sched = NULL;
+    bool_t can_test = FALSE;
+    cassert_no_null(runner);
+    cassert_no_null(task);
+    sched = runner->sched;
+
+    /* Ready for configurable steps/pipeline */
+    {
+        bool_t build_done = FALSE;
+        rqueue_job_state(sched->queue, task->sjob->id, i_BUILD_STEP, &build_done);
+        if (build_done == FALSE)
+            rqueue_job_init(sched->queue, task->sjob->id, i_BUILD_STEP);
+
+        if (build_done == FALSE)
+        {
+            bool_t tok = TRUE;
+            bool_t warm = FALSE;
+            String *msg = str_printf("Job '%s%s%s'", kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+            String *error_msg = NULL;
+            String *cmake_log = NULL;
+            String *build_log = NULL;
+            String *install_log = NULL;
+            String *warns = NULL;
+            String *errors = NULL;
+            uint32_t nwarns = 0;
+            uint32_t nerrors = 0;
+            const char_t *hostname = host_name(runner->host);
+            log_printf("%s Runner %s[%d]%s '%s%s%s' beginning job %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, slot_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+            tok = i_runner_sources(runner, "src", NBUILD_SRC_TAR, slot_id, &error_msg);
+            if (tok == TRUE)
+                tok = runner->exec->func_build(runner->exec->data, runner->host, runner->caps, runner->drive, task->sjob, runner->global, runner->wpaths, runner->repo_vers, runner->flowid, slot_id, njobs, &warm, &cmake_log, &build_log, &install_log, &warns, &errors, &nwarns, &nerrors, &error_msg);
+            log_printf("%s Runner %s[%d]%s '%s%s%s' complete job %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, slot_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+            /* The report writer applies the results. The runner doesn't wait */
+            rqueue_job_build_mode(sched->queue, task->sjob->id, i_BUILD_STEP, runner->global->incremental, warm, njobs);
+            rqueue_job_end(sched->queue, task->sjob->id, i_BUILD_STEP, tok, &error_msg, &msg);
+            rqueue_job(sched->queue, task->sjob->id, i_BUILD_STEP, hostname, &cmake_log, &build_log, &install_log, NULL, &warns, &errors, nwarns, nerrors);
+        }
+    }
+
+    can_test = rqueue_job_can_test(sched->queue, task->sjob->id);
+    if (can_test == TRUE)
+        rqueue_job_init(sched->queue, task->sjob->id, i_TEST_STEP);
+
+    if (can_test == TRUE)
+    {
+        bool_t tok = TRUE;
+        String *msg = str_printf("Test '%s%s%s'", kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+        String *error_msg = NULL;
+        String *cmake_log = NULL;
+        String *build_log = NULL;
+        String *install_log = NULL;
+        ArrSt(RTest) *tests = arrst_create(RTest);
+        String *warns = NULL;
+        String *errors = NULL;
+        uint32_t nwarns = 0;
+        uint32_t nerrors = 0;
+        const char_t *hostname = host_name(runner->host);
+        log_printf("%s Runner %s[%d]%s '%s%s%s' beginning test %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, slot_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+        tok = i_runner_sources(runner, "test", NBUILD_TEST_TAR, slot_id, &error_msg);
+        if (tok == TRUE)
+            tok = runner->exec->func_test(runner->exec->data, runner->host, task->sjob, runner->tests, runner->repo_vers, runner->flowid, slot_id, njobs, &cmake_log, &build_log, tests, &warns, &errors, &nwarns, &nerrors, &error_msg);
+        log_printf("%s Runner %s[%d]%s '%s%s%s' complete test %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, slot_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+        rqueue_job_end(sched->queue, task->sjob->id, i_TEST_STEP, tok, &error_msg, &msg);
+        rqueue_job(sched->queue, task->sjob->id, i_TEST_STEP, hostname, &cmake_log, &build_log, &install_log, &tests, &warns, &errors, nwarns, nerrors);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_run_slot(Slot *slot)
+{
+    cassert_no_null(slot);
+    for (;;)
+    {
+        Task *task = i_select_task_for_runner(slot->runner);
+        if (task != NULL)
+        {
+            i_run_task(slot->runner, task, slot->slot_id, slot->njobs);
+            i_finish_runner_task(task);
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_run_slot_thread(Slot *slot)
+{
+    i_run_slot(slot);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_remove_slot(Slot *slot)
+{
+    cassert_no_null(slot);
+    if (slot->thread != NULL)
+        bthread_close(&slot->thread);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t sched_num_slots(const Host *host, const uint32_t ncpus)
+{
+    /* Explicit capacity in network.json */
+    uint32_t slots = host_slots(host);
+    if (slots > 0)
+        return slots;
+
+    /* Unknown number of cores */
+    if (ncpus == 0)
+        return 1;
+
+    slots = ncpus / i_CORES_PER_SLOT;
+    return slots > 0 ? slots : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_slot_njobs(const Host *host, const uint32_t ncpus, const uint32_t nslots)
+{
+    /* Explicit build parallelism in network.json or the host cores */
+    uint32_t njobs = host_njobs(host);
+    cassert(nslots > 0);
+    if (njobs == 0)
+        njobs = ncpus;
+    if (njobs == 0)
+        return i_DEFAULT_NJOBS;
+
+    /* Partitioned between slots */
+    njobs /= nslots;
+    return njobs > 0 ? njobs : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_log_caps(const Runner *runner)
+{
+    const Vers *vers = NULL;
+    cassert_no_null(runner);
+    vers = hostcaps_cmake_vers(runner->caps);
+    log_printf("%s Runner %s[%d]%s '%s%s%s' cmake %s%d.%d.%d%s, %d MB free, '%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, vers->major, vers->minor, vers->patch, kASCII_RESET, hostcaps_free_mb(runner->caps), hostcaps_compiler(runner->caps));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_probe_caps(Runner *runner)
+{
+    uint32_t i = 0;
+    cassert_no_null(runner);
+    cassert(runner->caps == NULL);
+
+    /*
+     * The probe batch stops at its first failing command (a host still settling
+     * after boot), so cmake 0.0.0 means an incomplete probe. Never cached.
+     */
+    for (i = 0; i < i_CAPS_PROBES; ++i)
+    {
+        const Vers *vers = NULL;
+        if (i > 0)
+            runner->exec->func_sleep(runner->exec->data, 5000);
+
+        runner->caps = runner->exec->func_caps(runner->exec->data, runner->host);
+        vers = hostcaps_cmake_vers(runner->caps);
+        if (vers->major != 0 || vers->minor != 0 || vers->patch != 0)
+            return TRUE;
+
+        hostcaps_destroy(&runner->caps);
+    }
+
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_run_slots(Runner *runner)
+{
+    ArrSt(Slot) *slots = NULL;
+    uint32_t ncpus = 0;
+    uint32_t nslots = 0;
+    uint32_t njobs = 0;
+    uint32_t i = 0;
+
+    /* Capabilities probe once per boot, shared by all the jobs on this host */
+    if (i_probe_caps(runner) == FALSE)
+    {
+        log_printf("%s Runner %s[%d]%s '%s%s%s' without cmake after %d probes", kASCII_SCHED_FAIL, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, i_CAPS_PROBES);
+        return;
+    }
+
+    ncpus = hostcaps_ncpus(runner->caps);
+    i_log_caps(runner);
+
+    /* Capacity of the host in the next predictions */
+    if (ncpus > 0)
+        rqueue_host_ncpus(runner->sched->queue, host_name(runner->host), ncpus);
+
+    nslots = sched_num_slots(runner->host, ncpus);
+    njobs = i_slot_njobs(runner->host, ncpus, nslots);
+
+    log_printf("%s Runner %s[%d]%s '%s%s%s' with %s%d%s slots (%d cores, %d build jobs per slot)", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_VERSION, nslots, kASCII_RESET, ncpus, njobs);
+
+    /* The first slot runs in runner thread. All slots are created before launching threads */
+    slots = arrst_create(Slot);
+    for (i = 0; i < nslots; ++i)
+    {
+        Slot *slot = arrst_new0(slots, Slot);
+        slot->runner = runner;
+        slot->njobs = njobs;
+        if (i == 0)
+        {
+            slot->slot_id = runner->thread_id;
+        }
+        else
+        {
+            bmutex_lock(runner->sched->mutex);
+            slot->slot_id = runner->sched->next_slot_id++;
+            bmutex_unlock(runner->sched->mutex);
+        }
+    }
+
+    arrst_foreach(slot, slots, Slot)
+        if (slot_i > 0)
+            slot->thread = bthread_create(i_run_slot_thread, slot, Slot);
+    arrst_end()
+
+    i_run_slot(arrst_first(slots, Slot));
+
+    arrst_foreach(slot, slots, Slot)
+        if (slot->thread != NULL)
+            bthread_wait(slot->thread);
+    arrst_end()
+
+    arrst_destroy(&slots, i_remove_slot, Slot);
+
+    /* A reboot can change the toolchain */
+    hostcaps_destroy(&runner->caps);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_run_runner_thread(Runner *runner)
+{
+    bool_t ok = TRUE;
+    uint32_t boot_seconds = 0;
+    const Login *login = NULL;
+    cassert_no_null(runner);
+    cassert_no_null(runner->global);
+    login = host_login(runner->host);
+
+    /* Don't boot the host if there is no pending work for it */
+    ok = i_runner_wait_turn(runner);
+    if (ok == FALSE)
+    {
+        log_printf("%s Runner %s[%d]%s '%s%s%s' without pending jobs", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET);
+        return 0;
+    }
+
+    /* Booting the runner (maybe it was pre-booted at workflow beginning) */
+    if (i_preboot_take(runner->preboot, runner->host, &ok, &runner->state, &boot_seconds) == TRUE)
+    {
+        log_printf("%s Runner %s[%d]%s '%s%s%s' pre-booted '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_TARGET, tc(login->ip), kASCII_RESET);
+    }
+    else
+    {
+        uint64_t st = btime_now();
+        log_printf("%s Runner %s[%d]%s '%s%s%s' booting '%s%s%s'", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_TARGET, tc(login->ip), kASCII_RESET);
+        ok = runner->exec->func_boot(runner->exec->data, runner->host, runner->all_hosts, runner->boot_expect, &runner->state);
+        boot_seconds = (uint32_t)((btime_now() - st) / 1000000);
+    }
+
+    /* Boot duration history, for the adaptive readiness timeouts */
+    if (ok == TRUE && i_state_booted(runner->state) == TRUE)
+        rqueue_boot_time(runner->sched->queue, host_name(runner->host), boot_seconds);
+
+    if (ok == FALSE)
+        log_printf("%s Runner %s[%d]%s '%s%s%s' cannot be booted '%s%s::%s%s'", kASCII_SCHED_FAIL, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET, kASCII_ERROR, tc(login->ip), i_state_str(runner->state), kASCII_RESET);
+
+    /* The runner is up. Concurrent tasks in slots (boot/shutdown once per host) */
+    if (ok == TRUE)
+        i_run_slots(runner);
+
+    /* Shutdown */
+    if (ok == TRUE)
+    {
+        bool_t shutdown = runner->exec->func_shutdown(runner->exec->data, runner->host, runner->all_hosts, runner->state);
+        if (shutdown == TRUE)
+            log_printf("%s Runner %s[%d]%s '%s%s%s' shutting down", kASCII_SCHED, kASCII_VERSION, runner->thread_id, kASCII_RESET, kASCII_PATH, host_name(runner->host), kASCII_RESET);
+    }
+
+    i_runner_release(runner);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_task_cmp(const Task *task1, const Task *task2)
+{
+    /* Longest processing time first. Unknown durations (UINT32_MAX) go first */
+    if (task1->seconds > task2->seconds)
+        return -1;
+    if (task1->seconds < task2->seconds)
+        return 1;
+    if (task1->job_id < task2->job_id)
+        return -1;
+    if (task1->job_id > task2->job_id)
+        return 1;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_prepare_before_runners(const HostExec *exec, const Drive *drive, const ArrSt(Task) *tasks, const ArrSt(Target) *tests, const WorkPaths *wpaths)
+{
+    bool_t ok = TRUE;
+    bool_t with_build_tasks = FALSE;
+    bool_t with_test_tasks = FALSE;
+    cassert_no_null(exec);
+
+    if (arrst_size(tasks, Task) > 0)
+        with_build_tasks = TRUE;
+
+    arrst_foreach_const(test, tests, Target)
+        if (str_empty(test->exec) == FALSE)
+        {
+            with_test_tasks = TRUE;
+            break;
+        }
+    arrst_end()
+
+    /*
+     * Get the source package from drive.
+     * Runners will not get the source code from repo, but from previous generated src package.
+     * This action will leave the package ready for distribute to runners
+     */
+    if (with_build_tasks == TRUE)
+        ok = exec->func_fetch(exec->data, drive, wpaths, NBUILD_SRC_TAR);
+
+    /* Same for tests */
+    if (with_test_tasks == TRUE)
+    {
+        if (exec->func_fetch(exec->data, drive, wpaths, NBUILD_TEST_TAR) == FALSE)
+            ok = FALSE;
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_macos_task(const Task *task, const Runner *runner)
+{
+    /* Task done by some volume of the runner Mac */
+    cassert_no_null(task);
+    if (task->runner == NULL)
+        return FALSE;
+    return (bool_t)(task->runner == runner || i_same_macos(runner, task->runner) == TRUE);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_macos_fifo_switches(const Schedul *sched, const Runner *runner)
+{
+    bool_t first = TRUE;
+    uint32_t nswitches = 0;
+    cassert_no_null(sched);
+
+    /*
+     * First-come order, without grouping. Volumes take the Mac in runner order and
+     * each one runs all the remaining tasks it can. A volume has work if some task
+     * of this Mac can't be run by an earlier volume.
+     */
+    arrst_foreach_const(volume, sched->runners, Runner)
+        if (volume == runner || i_same_macos(runner, volume) == TRUE)
+        {
+            bool_t with_work = FALSE;
+            arrst_foreach_const(task, sched->tasks, Task)
+                if (i_macos_task(task, runner) == TRUE && i_task_runnable(task, volume->host) == TRUE)
+                {
+                    bool_t taken = FALSE;
+                    arrst_foreach_const(earlier, sched->runners, Runner)
+                        if (earlier_i >= volume_i)
+                            break;
+                        if ((earlier == runner || i_same_macos(runner, earlier) == TRUE) && i_task_runnable(task, earlier->host) == TRUE)
+                        {
+                            taken = TRUE;
+                            break;
+                        }
+                    arrst_end()
+
+                    if (taken == FALSE)
+                    {
+                        with_work = TRUE;
+                        break;
+                    }
+                }
+            arrst_end()
+
+            /* Only the first volume can find the Mac already running it */
+            if (with_work == TRUE)
+            {
+                if (first == FALSE || volume->macos_alive == FALSE)
+                    nswitches += 1;
+                first = FALSE;
+            }
+        }
+    arrst_end()
+
+    return nswitches;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_log_macos_reboots(const Schedul *sched)
+{
+    cassert_no_null(sched);
+    arrst_foreach_const(runner, sched->runners, Runner)
+        if (str_equ_c(host_type(runner->host), "macos") == TRUE && i_first_macos(sched, runner) == TRUE)
+        {
+            uint32_t nvolumes = 0, nswitches = 0, nfifo = 0;
+            arrst_foreach_const(other, sched->runners, Runner)
+                if (other == runner || i_same_macos(runner, other) == TRUE)
+                {
+                    if (other->macos_switch == TRUE)
+                        nswitches += 1;
+                    nvolumes += 1;
+                }
+            arrst_end()
+
+            nfifo = i_macos_fifo_switches(sched, runner);
+            if (nvolumes > 1)
+                log_printf("%s Mac '%s%s%s' %s%d%s volume switches, %s%d%s saved over first-come order", kASCII_SCHED, kASCII_PATH, host_macos_host(runner->host), kASCII_RESET, kASCII_VERSION, nswitches, kASCII_RESET, kASCII_VERSION, nfifo > nswitches ? nfifo - nswitches : 0, kASCII_RESET);
+        }
+    arrst_end()
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_unknown_host_jobs(Schedul *sched)
+{
+    /* Recorded as failed steps, so they are not selected again in next loops */
+    cassert_no_null(sched);
+    arrst_foreach(task, sched->tasks, Task)
+        if (task->error_msg != NULL)
+        {
+            String *msg = str_printf("Job '%s%s%s'", kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+            rqueue_job_init(sched->queue, task->sjob->id, task->error_step);
+            rqueue_job_end(sched->queue, task->sjob->id, task->error_step, FALSE, &task->error_msg, &msg);
+        }
+    arrst_end()
+}
+
+/*---------------------------------------------------------------------------*/
+
+void sched_start(const Global *global, ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const uint32_t repo_vers, Preboot *preboot, Report *report, RJournal *journal, const schedpol_t policy, const HostExec *exec)
+{
+    bool_t ok = TRUE;
+    Schedul *sched = i_scheduler(policy);
+
+    cassert_no_null(drive);
+    cassert_no_null(exec);
+
+    /* Initial log messages */
+    log_printf("%s Beginning jobs with %s%d%s priority", kASCII_SCHED, kASCII_VERSION, i_priority(seljobs), kASCII_RESET);
+    arrst_foreach_const(sjob, seljobs, SJob)
+        cassert_no_null(sjob->job);
+        log_printf("%s %s[%d]%s '%s%s%s'", kASCII_SCHED, kASCII_VERSION, sjob_i, kASCII_RESET, kASCII_TARGET, tc(sjob->job->name), kASCII_RESET);
+    arrst_end()
+
+    /* All the jobs go to a shared pool of tasks */
+    arrst_foreach_const(sjob, seljobs, SJob)
+        Task *task = arrst_new(sched->tasks, Task);
+        const char_t *hostname = NULL;
+        RState build_state;
+
+        task->sjob = sjob;
+        task->host = NULL;
+        task->runner = NULL;
+        task->fast_host = NULL;
+        task->job_id = sjob_i;
+        task->state = ekTASK_PENDING;
+        task->error_step = NULL;
+        task->error_msg = NULL;
+
+        /* Median of past durations */
+        report_job_state(report, sjob->id, i_BUILD_STEP, &build_state);
+        task->seconds = estim_job_seconds(report, sjob->id, build_state.done, NULL);
+
+        hostname = i_pinned_hostname(report, sjob);
+        if (str_empty_c(hostname) == FALSE)
+        {
+            task->host = host_by_name(hosts, hostname);
+            if (task->host == NULL)
+            {
+                log_printf("%s Job %s[%d]%s '%s%s%s' pinned to unknown host '%s%s%s'", kASCII_SCHED_WARN, kASCII_VERSION, sjob_i, kASCII_RESET, kASCII_TARGET, tc(sjob->job->name), kASCII_RESET, kASCII_PATH, hostname, kASCII_RESET);
+                task->error_step = build_state.done == TRUE ? i_TEST_STEP : i_BUILD_STEP;
+                task->error_msg = str_printf("Host '%s' is not in network.json", hostname);
+                task->state = ekTASK_DONE;
+            }
+        }
+
+    arrst_end()
+
+    /* Every host capable of running some task will be a runner */
+    {
+        uint32_t i, n = arrst_size(hosts, Host);
+        for (i = 0; i < n; ++i)
+        {
+            const Host *host = arrst_get_const(hosts, i, Host);
+            arrst_foreach_const(task, sched->tasks, Task)
+                if (i_task_runnable(task, host) == TRUE)
+                {
+                    i_add_runner(global, sched->runners, host, hosts, drive, tests, wpaths, flowid, exec, preboot, repo_vers, estim_boot_seconds(report, host_name(host)));
+                    break;
+                }
+            arrst_end()
+        }
+    }
+
+    /* Volume booted in each Mac, preferred by the turns of its volumes */
+    i_macos_alive(sched, hosts);
+
+    /* Tasks that no runner can execute. Look for the historically fastest host */
+    arrst_foreach(task, sched->tasks, Task)
+        bool_t capable = FALSE;
+        uint32_t best = UINT32_MAX;
+        RState build_state;
+        report_job_state(report, task->sjob->id, i_BUILD_STEP, &build_state);
+        arrst_foreach_const(runner, sched->runners, Runner)
+            if (i_task_runnable(task, runner->host) == TRUE)
+            {
+                uint32_t seconds = estim_job_seconds(report, task->sjob->id, build_state.done, host_name(runner->host));
+                if (seconds < best)
+                {
+                    best = seconds;
+                    task->fast_host = runner->host;
+                }
+                capable = TRUE;
+            }
+        arrst_end()
+
+        if (capable == FALSE)
+            log_printf("%s Job %s[%d]%s '%s%s%s' without capable host", kASCII_SCHED_WARN, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET);
+        else if (task->seconds != UINT32_MAX)
+            log_printf("%s Job %s[%d]%s '%s%s%s' estimated %s%ds%s, fastest host '%s%s%s'", kASCII_SCHED, kASCII_VERSION, task->job_id, kASCII_RESET, kASCII_TARGET, tc(task->sjob->job->name), kASCII_RESET, kASCII_VERSION, task->seconds, kASCII_RESET, kASCII_PATH, task->fast_host != NULL ? host_name(task->fast_host) : "-", kASCII_RESET);
+    arrst_end()
+
+    /* Longest jobs first, to shrink the tail of the loop */
+    if (policy != ekSCHED_FIFO)
+        arrst_sort(sched->tasks, i_task_cmp, Task);
+
+    /* From here, the report is only updated through the queue */
+    sched->queue = rqueue_create(report, journal);
+    i_unknown_host_jobs(sched);
+
+    if (ok == TRUE)
+    {
+        if (arrst_size(sched->runners, Runner) == 0)
+        {
+            log_printf("%s No work can be started, as there is no host capable of doing so", kASCII_FAIL);
+            ok = FALSE;
+        }
+    }
+
+    if (ok == TRUE)
+        ok = i_prepare_before_runners(exec, drive, sched->tasks, tests, wpaths);
+
+    if (ok == TRUE)
+    {
+        sched->next_slot_id = arrst_size(sched->runners, Runner);
+        arrst_foreach(runner, sched->runners, Runner)
+            cassert(runner->thread == NULL);
+            cassert(runner->sched == NULL);
+            runner->thread_id = runner_i;
+            runner->sched = sched;
+            runner->thread = bthread_create(i_run_runner_thread, runner, Runner);
+        arrst_end()
+
+        /* Wait all threads for finish */
+        arrst_foreach(runner, sched->runners, Runner)
+            bthread_wait(runner->thread);
+        arrst_end()
+
+        i_log_macos_reboots(sched);
     }
 
+    /* Pending report updates */
+    rqueue_destroy(&sched->queue);
     i_destroy_scheduler(&sched);
 }
 
@@ -12,4 +12,10 @@
 
 #include "nbuild.hxx"
 
-void sched_start(const Global *global, ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const uint32_t repo_vers, Report *report);
+Preboot *sched_preboot(const ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, Report *report, const HostExec *exec);
+
+void sched_preboot_end(Preboot **preboot);
+
+void sched_start(const Global *global, ArrSt(SJob) *seljobs, const ArrSt(Host) *hosts, const Drive *drive, const ArrSt(Target) *tests, const WorkPaths *wpaths, const char_t *flowid, const uint32_t repo_vers, Preboot *preboot, Report *report, RJournal *journal, const schedpol_t policy, const HostExec *exec);
+
+uint32_t sched_num_slots(const Host *host, const uint32_t ncpus);
@@ -0,0 +1,532 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: simul.c
+ *
+ */
+
+/* Scheduler simulator over a fake host backend */
+
+#include "simul.h"
+#include "estim.h"
+#include "host.h"
+#include "hostcaps.h"
+#include "report.h"
+#include "sched.h"
+#include <nlib/nlib.h>
+#include <core/arrst.h>
+#include <core/dbind.h>
+#include <core/heap.h>
+#include <core/strings.h>
+#include <osbs/btime.h>
+#include <osbs/bmutex.h>
+#include <osbs/bthread.h>
+#include <osbs/log.h>
+#include <sewer/bmath.h>
+#include <sewer/cassert.h>
+
+typedef struct _sdur_t SDur;
+typedef struct _shost_t SHost;
+typedef struct _sresult_t SResult;
+
+/* Simulated duration of a job in a host (virtual seconds) */
+struct _sdur_t
+{
+    const Job *job;
+    const Host *host;
+    uint32_t build;
+    uint32_t test;
+};
+
+struct _shost_t
+{
+    const Host *host;
+    uint32_t running;
+    uint32_t peak;
+    uint32_t ntasks;
+    uint32_t nboots;
+    real64_t busy;
+};
+
+struct _sresult_t
+{
+    schedpol_t policy;
+    real64_t makespan;
+    real64_t util;
+    real64_t wait_mean;
+    real64_t wait_max;
+    uint32_t ntasks;
+};
+
+struct _simul_t
+{
+    HostExec exec;
+    const Report *history;
+    Mutex *mutex;
+    ArrSt(SDur) *durs;
+    ArrSt(SHost) *hosts;
+    ArrSt(SResult) *results;
+    /* Real microseconds at the beginning of the run */
+    uint64_t start;
+    /* Virtual time when the current task pool was created */
+    real64_t band;
+    real64_t wait;
+    real64_t wait_max;
+    uint32_t nwaits;
+    uint32_t nruns;
+};
+
+DeclSt(SDur);
+DeclSt(SHost);
+DeclSt(SResult);
+
+/*---------------------------------------------------------------------------*/
+
+/* Real microseconds per virtual second */
+static const uint32_t i_SCALE = 1000;
+static const uint32_t i_BOOT_SECONDS = 60;
+static const uint32_t i_DEFAULT_BUILD = 600;
+
+/*---------------------------------------------------------------------------*/
+
+static const char_t *i_policy_str(const schedpol_t policy)
+{
+    switch (policy)
+    {
+    case ekSCHED_LPT_AFFINITY:
+        return "lpt-affinity";
+    case ekSCHED_LPT:
+        return "lpt";
+    case ekSCHED_FIFO:
+        return "fifo";
+    default:
+        cassert_default(policy);
+    }
+
+    return "Unknown";
+}
+
+/*---------------------------------------------------------------------------*/
+
+static real64_t i_now(const Simul *sim)
+{
+    cassert_no_null(sim);
+    return (real64_t)(btime_now() - sim->start) / (real64_t)i_SCALE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_elapse(const uint32_t milliseconds)
+{
+    /* Virtual milliseconds to real time */
+    uint32_t real_ms = (uint32_t)(((uint64_t)milliseconds * i_SCALE) / 1000000);
+    bthread_sleep(real_ms > 0 ? real_ms : 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_seconds(const Report *history, REnv *env, const char_t *job, const char_t *step, const char_t *hostname, const ArrSt(uint32_t) *pool, const uint32_t defsecs)
+{
+    ArrSt(uint32_t) *seconds = arrst_create(uint32_t);
+    uint32_t median = UINT32_MAX;
+
+    /* Replay the job history. Median in the same host, then in any host */
+    report_times(history, job, step, hostname, seconds);
+    median = estim_median(seconds);
+    if (median == UINT32_MAX)
+    {
+        report_times(history, job, step, NULL, seconds);
+        median = estim_median(seconds);
+    }
+
+    /* Never run. Sampled from the durations of all jobs */
+    if (median == UINT32_MAX)
+    {
+        uint32_t n = arrst_size(pool, uint32_t);
+        if (n == 0)
+            median = defsecs;
+        else if (n == 1)
+            median = *arrst_first_const(pool, uint32_t);
+        else
+            median = *arrst_get_const(pool, bmath_rand_mti(env, 0, n - 1), uint32_t);
+    }
+
+    arrst_destroy(&seconds, NULL, uint32_t);
+    return median;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const SDur *i_dur(const Simul *sim, const Job *job, const Host *host)
+{
+    cassert_no_null(sim);
+    arrst_foreach_const(dur, sim->durs, SDur)
+        if (dur->job == job && dur->host == host)
+            return dur;
+    arrst_end()
+    cassert(FALSE);
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static SHost *i_host(Simul *sim, const Host *host)
+{
+    cassert_no_null(sim);
+    arrst_foreach(shost, sim->hosts, SHost)
+        if (shost->host == host)
+            return shost;
+    arrst_end()
+    cassert(FALSE);
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_busy(Simul *sim, const Host *host, const uint32_t seconds)
+{
+    SHost *shost = NULL;
+    bmutex_lock(sim->mutex);
+    shost = i_host(sim, host);
+    shost->running += 1;
+    if (shost->running > shost->peak)
+        shost->peak = shost->running;
+    sim->nruns += 1;
+    bmutex_unlock(sim->mutex);
+
+    i_elapse(seconds * 1000);
+
+    bmutex_lock(sim->mutex);
+    shost->running -= 1;
+    shost->ntasks += 1;
+    shost->busy += (real64_t)seconds;
+    bmutex_unlock(sim->mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_boot(void *data, const Host *host, const ArrSt(Host) *hosts, const uint32_t expect_seconds, runstate_t *state)
+{
+    Simul *sim = (Simul *)data;
+    unref(hosts);
+    unref(expect_seconds);
+    cassert_no_null(state);
+    bmutex_lock(sim->mutex);
+    i_host(sim, host)->nboots += 1;
+    bmutex_unlock(sim->mutex);
+    i_elapse(i_BOOT_SECONDS * 1000);
+    *state = ekRUNSTATE_NOT_INIT;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_shutdown(void *data, const Host *host, const ArrSt(Host) *hosts, const runstate_t state)
+{
+    unref(data);
+    unref(host);
+    unref(hosts);
+    unref(state);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_ready(void *data, const Host *host)
+{
+    /* Simulated hosts are shutdown after each loop */
+    unref(data);
+    unref(host);
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static HostCaps *i_caps(void *data, const Host *host)
+{
+    /* Unknown cores, one slot unless network.json sets the capacity */
+    Vers cmake_vers = {3, 15, 0};
+    unref(data);
+    unref(host);
+    return hostcaps_create(0, &cmake_vers, 0, "");
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_fetch(void *data, const Drive *drive, const WorkPaths *wpaths, const char_t *tarname)
+{
+    unref(data);
+    unref(drive);
+    unref(wpaths);
+    unref(tarname);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_sources(void *data, const Host *host, const WorkPaths *wpaths, const char_t *flowid, const char_t *kind, const char_t *tarname, const uint32_t repo_vers, const uint32_t runner_id, String **error_msg)
+{
+    unref(data);
+    unref(host);
+    unref(wpaths);
+    unref(flowid);
+    unref(kind);
+    unref(tarname);
+    unref(repo_vers);
+    unref(runner_id);
+    unref(error_msg);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_build(void *data, const Host *host, HostCaps *caps, const Drive *drive, const SJob *sjob, const Global *global, const WorkPaths *wpaths, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, bool_t *warm, String **cmake_log, String **build_log, String **install_log, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+{
+    Simul *sim = (Simul *)data;
+    const SDur *dur = NULL;
+    real64_t wait = 0;
+    unref(caps);
+    unref(drive);
+    unref(global);
+    unref(wpaths);
+    unref(repo_vers);
+    unref(flowid);
+    unref(runner_id);
+    unref(njobs);
+    unref(cmake_log);
+    unref(build_log);
+    unref(install_log);
+    unref(warns);
+    unref(errors);
+    unref(nwarns);
+    unref(nerrors);
+    unref(error_msg);
+    cassert_no_null(sjob);
+    cassert_no_null(warm);
+    dur = i_dur(sim, sjob->job, host);
+
+    /* All the tasks are in the pool since the beginning of the band */
+    bmutex_lock(sim->mutex);
+    wait = i_now(sim) - sim->band;
+    sim->wait += wait;
+    if (wait > sim->wait_max)
+        sim->wait_max = wait;
+    sim->nwaits += 1;
+    bmutex_unlock(sim->mutex);
+
+    i_busy(sim, host, dur->build);
+    *warm = FALSE;
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_test(void *data, const Host *host, const SJob *sjob, const ArrSt(Target) *tests, const uint32_t repo_vers, const char_t *flowid, const uint32_t runner_id, const uint32_t njobs, String **cmake_log, String **build_log, ArrSt(RTest) *results, String **warns, String **errors, uint32_t *nwarns, uint32_t *nerrors, String **error_msg)
+{
+    Simul *sim = (Simul *)data;
+    const SDur *dur = NULL;
+    unref(tests);
+    unref(repo_vers);
+    unref(flowid);
+    unref(runner_id);
+    unref(njobs);
+    unref(cmake_log);
+    unref(build_log);
+    unref(results);
+    unref(warns);
+    unref(errors);
+    unref(nwarns);
+    unref(nerrors);
+    unref(error_msg);
+    cassert_no_null(sjob);
+    dur = i_dur(sim, sjob->job, host);
+    i_busy(sim, host, dur->test);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_sleep(void *data, const uint32_t milliseconds)
+{
+    unref(data);
+    i_elapse(milliseconds);
+}
+
+/*---------------------------------------------------------------------------*/
+
+Simul *simul_create(const Report *history, const ArrSt(Job) *jobs, const ArrSt(Host) *hosts, const uint32_t seed)
+{
+    Simul *sim = heap_new0(Simul);
+    ArrSt(uint32_t) *build_pool = arrst_create(uint32_t);
+    ArrSt(uint32_t) *test_pool = arrst_create(uint32_t);
+    REnv *env = bmath_rand_env(seed);
+    cassert_no_null(history);
+    sim->exec.data = sim;
+    sim->exec.func_boot = i_boot;
+    sim->exec.func_shutdown = i_shutdown;
+    sim->exec.func_ready = i_ready;
+    sim->exec.func_caps = i_caps;
+    sim->exec.func_fetch = i_fetch;
+    sim->exec.func_sources = i_sources;
+    sim->exec.func_build = i_build;
+    sim->exec.func_test = i_test;
+    sim->exec.func_sleep = i_sleep;
+    sim->history = history;
+    sim->mutex = bmutex_create();
+    sim->durs = arrst_create(SDur);
+    sim->hosts = arrst_create(SHost);
+    sim->results = arrst_create(SResult);
+
+    /* Durations are fixed before the runs, so all policies compete with the same workload */
+    report_times(history, NULL, "build", NULL, build_pool);
+    report_times(history, NULL, "test", NULL, test_pool);
+    arrst_foreach_const(job, jobs, Job)
+        uint32_t i, n = arrst_size(hosts, Host);
+        for (i = 0; i < n; ++i)
+        {
+            const Host *host = arrst_get_const(hosts, i, Host);
+            SDur *dur = arrst_new(sim->durs, SDur);
+            dur->job = job;
+            dur->host = host;
+            dur->build = i_seconds(history, env, tc(job->name), "build", host_name(host), build_pool, i_DEFAULT_BUILD);
+            dur->test = i_seconds(history, env, tc(job->name), "test", host_name(host), test_pool, 0);
+        }
+    arrst_end()
+
+    {
+        uint32_t i, n = arrst_size(hosts, Host);
+        for (i = 0; i < n; ++i)
+        {
+            SHost *shost = arrst_new0(sim->hosts, SHost);
+            shost->host = arrst_get_const(hosts, i, Host);
+        }
+    }
+
+    arrst_destroy(&build_pool, NULL, uint32_t);
+    arrst_destroy(&test_pool, NULL, uint32_t);
+    bmath_rand_destroy(&env);
+    return sim;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void simul_destroy(Simul **sim)
+{
+    cassert_no_null(sim);
+    cassert_no_null(*sim);
+    arrst_destroy(&(*sim)->durs, NULL, SDur);
+    arrst_destroy(&(*sim)->hosts, NULL, SHost);
+    arrst_destroy(&(*sim)->results, NULL, SResult);
+    bmutex_close(&(*sim)->mutex);
+    heap_delete(sim, Simul);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_with_tests(const ArrSt(Target) *tests)
+{
+    arrst_foreach_const(test, tests, Target)
+        if (str_empty(test->exec) == FALSE)
+            return TRUE;
+    arrst_end()
+    return FALSE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void simul_run(Simul *sim, const Global *global, const ArrSt(Job) *jobs, const ArrSt(Target) *tests, const Network *network, const schedpol_t policy)
+{
+    Report *report = dbind_create(Report);
+    ArrSt(SJob) *seljobs = arrst_create(SJob);
+    bool_t with_tests = i_with_tests(tests);
+    bool_t more = TRUE;
+    SResult *result = NULL;
+    real64_t busy = 0, capacity = 0;
+    cassert_no_null(sim);
+    cassert_no_null(global);
+    cassert_no_null(network);
+
+    /* A fresh report with the job durations history */
+    report_init(report, "simulation", 0);
+    report_times_import(report, sim->history);
+    report_loop_init(report);
+
+    arrst_foreach(shost, sim->hosts, SHost)
+        shost->running = 0;
+        shost->peak = 0;
+        shost->ntasks = 0;
+        shost->nboots = 0;
+        shost->busy = 0;
+    arrst_end()
+
+    sim->wait = 0;
+    sim->wait_max = 0;
+    sim->nwaits = 0;
+    sim->start = btime_now();
+    log_printf("%s Simulating '%s%s%s' policy", kASCII_SCHED, kASCII_TARGET, i_policy_str(policy), kASCII_RESET);
+
+    /* Priority bands, one after the other as consecutive CI loops would do */
+    while (more == TRUE)
+    {
+        report_select_jobs(report, jobs, seljobs, with_tests, NULL);
+        if (arrst_size(seljobs, SJob) > 0)
+        {
+            Preboot *preboot = NULL;
+            sim->band = i_now(sim);
+            sim->nruns = 0;
+            preboot = sched_preboot(seljobs, network->hosts, report, &sim->exec);
+            sched_start(global, seljobs, network->hosts, &network->drive, tests, NULL, tc(global->flowid), 0, preboot, report, NULL, policy, &sim->exec);
+            sched_preboot_end(&preboot);
+
+            /* Jobs without capable host will be pending forever */
+            if (sim->nruns == 0)
+                more = FALSE;
+        }
+        else
+        {
+            more = FALSE;
+        }
+    }
+
+    result = arrst_new0(sim->results, SResult);
+    result->policy = policy;
+    result->makespan = i_now(sim);
+    result->wait_max = sim->wait_max;
+    result->ntasks = sim->nwaits;
+    if (sim->nwaits > 0)
+        result->wait_mean = sim->wait / (real64_t)sim->nwaits;
+
+    /* Utilization over the host capacity, the same slots the runners create (no cores in 'i_caps') */
+    arrst_foreach_const(shost, sim->hosts, SHost)
+        if (shost->ntasks > 0)
+        {
+            uint32_t nslots = sched_num_slots(shost->host, 0);
+            real64_t util = 0;
+            if (result->makespan > 0)
+                util = shost->busy / (result->makespan * (real64_t)nslots);
+            busy += shost->busy;
+            capacity += result->makespan * (real64_t)nslots;
+            log_printf("%s Host '%s%s%s' %d tasks, %d boots, busy %.0fs, peak %d/%d slots, utilization %.0f%%", kASCII_SCHED, kASCII_PATH, host_name(shost->host), kASCII_RESET, shost->ntasks, shost->nboots, shost->busy, shost->peak, nslots, util * 100);
+        }
+    arrst_end()
+
+    if (capacity > 0)
+        result->util = busy / capacity;
+
+    arrst_destroy(&seljobs, NULL, SJob);
+    dbind_destroy(&report, Report);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void simul_log(const Simul *sim)
+{
+    cassert_no_null(sim);
+    log_printf("%s %-14s %10s %12s %16s %16s", kASCII_SCHED, "Policy", "Makespan", "Utilization", "Queue wait mean", "Queue wait max");
+    arrst_foreach_const(result, sim->results, SResult)
+        log_printf("%s %-14s %9.0fs %11.0f%% %15.0fs %15.0fs", kASCII_SCHED, i_policy_str(result->policy), result->makespan, result->util * 100, result->wait_mean, result->wait_max);
+    arrst_end()
+}
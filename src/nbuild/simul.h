@@ -0,0 +1,21 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: simul.h
+ *
+ */
+
+/* Scheduler simulator over a fake host backend */
+
+#include "nbuild.hxx"
+
+Simul *simul_create(const Report *history, const ArrSt(Job) *jobs, const ArrSt(Host) *hosts, const uint32_t seed);
+
+void simul_destroy(Simul **sim);
+
+void simul_run(Simul *sim, const Global *global, const ArrSt(Job) *jobs, const ArrSt(Target) *tests, const Network *network, const schedpol_t policy);
+
+void simul_log(const Simul *sim);
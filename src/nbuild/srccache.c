@@ -0,0 +1,205 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: srccache.c
+ *
+ */
+
+/* Content-addressed cache of processed source files */
+
+#include "srccache.h"
+#include "cachedir.h"
+#include "nbuild.h"
+#include <nlib/nlib.h>
+#include <nlib/ssh.h>
+#include <core/bhash.h>
+#include <core/heap.h>
+#include <core/hfile.h>
+#include <core/stream.h>
+#include <core/strings.h>
+#include <osbs/bfile.h>
+#include <osbs/bproc.h>
+#include <osbs/bthread.h>
+#include <osbs/log.h>
+#include <osbs/osbs.h>
+#include <sewer/blib.h>
+#include <sewer/cassert.h>
+
+struct _srccache_t
+{
+    String *path;
+    /* Hash of '.clang-format' contents and clang-format version */
+    uint32_t seed;
+    uint32_t nthreads;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_fnv_stm(const uint32_t hash, const Stream *stm)
+{
+    if (stm != NULL)
+        return cachedir_fnv(hash, stm_buffer(stm), stm_buffer_size(stm));
+    return hash;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_master_ncpus(void)
+{
+    /* Cores of the local machine, no ssh session involved */
+    platform_t platform = osbs_platform();
+    uint32_t ncpus = 0;
+    bool_t err = TRUE;
+
+    if (platform == ekWINDOWS)
+    {
+        const char_t *env = blib_getenv("NUMBER_OF_PROCESSORS");
+        if (env != NULL)
+            ncpus = str_to_u32(env, 10, &err);
+    }
+    else
+    {
+        const char_t *cmd = platform == ekMACOS ? "sysctl -n hw.ncpu" : "nproc";
+        Proc *proc = bproc_exec(cmd, NULL);
+        if (proc != NULL)
+        {
+            Stream *stm = stm_memory(64);
+            byte_t buffer[64];
+            uint32_t rsize;
+            while (bproc_read(proc, buffer, sizeof(buffer), &rsize, NULL) == TRUE)
+                stm_write(stm, buffer, rsize);
+
+            if (bproc_wait(proc) == 0)
+            {
+                String *out = stm_str(stm);
+                String *trim = str_trim(tc(out));
+                ncpus = str_to_u32(tc(trim), 10, &err);
+                str_destroy(&trim);
+                str_destroy(&out);
+            }
+
+            stm_close(&stm);
+            bproc_close(&proc);
+        }
+    }
+
+    return (err == FALSE && ncpus > 0) ? ncpus : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+SrcCache *srccache_create(const char_t *path, const char_t *format_file)
+{
+    SrcCache *cache = heap_new0(SrcCache);
+    uint32_t seed = CACHEDIR_FNV_SEED;
+
+    if (str_empty_c(format_file) == FALSE)
+    {
+        Stream *config = hfile_stream(format_file, NULL);
+        Stream *vers = NULL;
+        seed = i_fnv_stm(seed, config);
+        ssh_command("clang-format --version", &vers, NULL);
+        seed = i_fnv_stm(seed, vers);
+        if (config != NULL)
+            stm_close(&config);
+        if (vers != NULL)
+            stm_close(&vers);
+    }
+
+    if (hfile_dir(path) == FALSE)
+    {
+        hfile_dir_create(path, NULL);
+    }
+    else
+    {
+        /* Entries of old revisions are never hit again */
+        uint32_t n = cachedir_prune(path);
+        if (n > 0)
+            log_printf("%s Source cache: %d expired entries removed", kASCII_OK, n);
+    }
+
+    cache->path = str_c(path);
+    cache->seed = seed;
+    cache->nthreads = i_master_ncpus();
+    return cache;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void srccache_destroy(SrcCache **cache)
+{
+    cassert_no_null(cache);
+    cassert_no_null(*cache);
+    str_destroy(&(*cache)->path);
+    heap_delete(cache, SrcCache);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t srccache_nthreads(const SrcCache *cache)
+{
+    cassert_no_null(cache);
+    return cache->nthreads;
+}
+
+/*---------------------------------------------------------------------------*/
+
+String *srccache_key(const SrcCache *cache, const char_t *filename, const bool_t with_format, const Stream *header, const Stream *data)
+{
+    uint32_t h1 = 0, h2 = 0, size = 0;
+    cassert_no_null(cache);
+    cassert_no_null(data);
+    size = stm_buffer_size(data);
+    /* clang-format output depends on the filename extension */
+    h1 = bhash_from_block(cast_const(filename, byte_t), str_len_c(filename));
+    h1 = bhash_append_uint32(h1, bhash_from_block(stm_buffer(data), size));
+    h2 = cachedir_fnv(with_format == TRUE ? cache->seed : CACHEDIR_FNV_SEED, cast_const(filename, byte_t), str_len_c(filename));
+    h2 = i_fnv_stm(h2, data);
+
+    if (header != NULL)
+    {
+        h1 = bhash_append_uint32(h1, bhash_from_block(stm_buffer(header), stm_buffer_size(header)));
+        h2 = i_fnv_stm(h2, header);
+    }
+
+    h1 = bhash_append_uint32(h1, (uint32_t)with_format);
+    return str_printf("%08x%08x%08x", h1, h2, size);
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t srccache_get(const SrcCache *cache, const char_t *key, const char_t *dest)
+{
+    String *pathname = NULL;
+    bool_t ok = FALSE;
+    cassert_no_null(cache);
+    pathname = str_cpath("%s/%s", tc(cache->path), key);
+    if (hfile_exists(tc(pathname), NULL) == TRUE)
+        ok = hfile_copy(tc(pathname), dest, NULL);
+    if (ok == TRUE)
+        cachedir_refresh(tc(pathname));
+    str_destroy(&pathname);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void srccache_put(const SrcCache *cache, const char_t *key, const byte_t *data, const uint32_t size)
+{
+    String *pathname = NULL;
+    String *tmpname = NULL;
+    cassert_no_null(cache);
+    pathname = str_cpath("%s/%s", tc(cache->path), key);
+    /* Other thread could be writing the same entry */
+    tmpname = str_cpath("%s/%s.%d", tc(cache->path), key, bthread_current_id());
+    if (hfile_from_data(tc(tmpname), data, size, NULL) == TRUE)
+    {
+        if (bfile_rename(tc(tmpname), tc(pathname), NULL) == FALSE)
+            bfile_delete(tc(tmpname), NULL);
+    }
+    str_destroy(&pathname);
+    str_destroy(&tmpname);
+}
@@ -0,0 +1,25 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: srccache.h
+ *
+ */
+
+/* Content-addressed cache of processed source files */
+
+#include "nbuild.hxx"
+
+SrcCache *srccache_create(const char_t *path, const char_t *format_file);
+
+void srccache_destroy(SrcCache **cache);
+
+uint32_t srccache_nthreads(const SrcCache *cache);
+
+String *srccache_key(const SrcCache *cache, const char_t *filename, const bool_t with_format, const Stream *header, const Stream *data);
+
+bool_t srccache_get(const SrcCache *cache, const char_t *key, const char_t *dest);
+
+void srccache_put(const SrcCache *cache, const char_t *key, const byte_t *data, const uint32_t size);
@@ -13,20 +13,55 @@
 #include "target.h"
 #include "report.h"
 #include "nbuild.h"
+#include "prdoc.h"
+#include "srccache.h"
 #include <nlib/nlib.h>
 #include <nlib/ssh.h>
 #include <inet/httpreq.h>
 #include <core/arrpt.h>
 #include <core/arrst.h>
 #include <core/date.h>
+#include <core/heap.h>
 #include <core/hfile.h>
 #include <core/regex.h>
 #include <core/stream.h>
 #include <core/strings.h>
+#include <osbs/bmutex.h>
 #include <osbs/bproc.h>
+#include <osbs/bthread.h>
 #include <osbs/log.h>
 #include <sewer/cassert.h>
 
+typedef struct _srcfile_t SrcFile;
+typedef struct _srcpool_t SrcPool;
+
+struct _srcfile_t
+{
+    String *src;
+    String *wc;
+    String *dest;
+};
+
+struct _srcpool_t
+{
+    const Global *global;
+    const ArrPt(String) *doc_pages;
+    SrcCache *cache;
+    const char_t *file_doc_url;
+    bool_t with_legal;
+    const char_t *clang_format;
+    const ArrSt(SrcFile) *files;
+    /* Protected by mutex */
+    uint32_t next;
+    bool_t ok;
+    bool_t formatted;
+    bool_t legalized;
+    String *error_msg;
+    Mutex *mutex;
+};
+
+DeclSt(SrcFile);
+
 /*---------------------------------------------------------------------------*/
 
 String *target_clang_format_file(const ArrSt(Target) *targets, const char_t *repo_url, const char_t *repo_user, const char_t *repo_pass, const uint32_t repo_vers, const char_t *cwd)
@@ -136,154 +171,258 @@ static bool_t i_ignore_file(const ArrPt(RegEx) *ignore_regex, const char_t *src)
 }
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_copy_repo_file(const Global *global, const ArrPt(RegEx) *ignore_regex, const char_t *repo_url, const char_t *src, const char_t *dest, const char_t *file_doc_url, const uint32_t repo_vers, const char_t *repo_user, const char_t *repo_pass, const bool_t with_legal, const char_t *clang_format, bool_t *formatted, bool_t *legalized, String **error_msg)
+static String *i_doc_url(const Global *global, const char_t *src, const char_t *ext, const char_t *file_doc_url, String **page)
 {
-    if (i_ignore_file(ignore_regex, src) == FALSE)
+    /* Doc page candidate of header files. NULL if the file can't have it */
+    String *url = NULL;
+    cassert_no_null(global);
+    cassert_no_null(page);
+    if (str_empty(global->doc_url) == FALSE && str_empty_c(file_doc_url) == FALSE)
     {
-        bool_t ok = TRUE;
-        String *fileurl = NULL;
-        Stream *filestm = NULL;
-        String *path = NULL, *filename = NULL, *ext = NULL;
+        if (str_equ_c(ext, "h") == TRUE || str_equ_c(ext, "hxx") == TRUE || str_equ_c(ext, "hpp") == TRUE)
+        {
+            String *file = NULL;
+            str_split_pathext(src, NULL, &file, NULL);
+            *page = str_printf("%s/%s.html", file_doc_url, tc(file));
+            url = str_printf("%s/%s", tc(global->doc_url), tc(*page));
+            str_destroy(&file);
+        }
+    }
 
-        cassert_no_null(global);
-        cassert_no_null(error_msg);
-        cassert(*error_msg == NULL);
-        cassert_no_null(formatted);
-        cassert_no_null(legalized);
+    return url;
+}
 
-        /* Download file from repo */
-        fileurl = str_printf("%s/%s", repo_url, src);
-        filestm = ssh_repo_cat(tc(fileurl), repo_vers, repo_user, repo_pass);
-        if (filestm == NULL)
+/*---------------------------------------------------------------------------*/
+
+static Stream *i_legal_header(const Global *global, const char_t *filename, const char_t *doc_url)
+{
+    Stream *stm = stm_memory(512);
+    uint16_t year = (uint16_t)date_year();
+    cassert_no_null(global);
+    stm_writef(stm, "/*\n");
+    stm_printf(stm, " * %s %s\n", tc(global->project), tc(global->description));
+
+    if (year == global->start_year)
+        stm_printf(stm, " * %d %s\n", global->start_year, tc(global->author));
+    else
+        stm_printf(stm, " * %d-%d %s\n", global->start_year, year, tc(global->author));
+
+    if (arrpt_size(global->license, String) > 0)
+    {
+        arrpt_foreach(line, global->license, String)
+            stm_writef(stm, " * ");
+            str_writef(stm, line);
+            stm_writef(stm, "\n");
+        arrpt_end()
+    }
+
+    stm_writef(stm, " *\n");
+    stm_printf(stm, " * File: %s\n", filename);
+
+    if (str_empty_c(doc_url) == FALSE)
+        stm_printf(stm, " * %s\n", doc_url);
+
+    stm_writef(stm, " *\n");
+    stm_writef(stm, " */\n\n");
+    return stm;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static Stream *i_clang_format(const char_t *filename, const Stream *filestm)
+{
+    String *cmd = str_printf("clang-format -style=file -assume-filename='%s'", filename);
+    const byte_t *fdata = stm_buffer(filestm);
+    uint32_t fsize = stm_buffer_size(filestm);
+    Proc *proc = bproc_exec(tc(cmd), NULL);
+    Stream *stm = NULL;
+
+    if (proc != NULL)
+    {
+        /* Write the file in clang-format stdin */
+        bool_t okc = bproc_write(proc, fdata, fsize, NULL, NULL);
+        if (okc == TRUE)
+            okc = bproc_write_close(proc);
+
+        if (okc == TRUE)
         {
-            ok = FALSE;
-            *error_msg = str_printf("Error download '%s'", src);
+            /* Read from the clang-format stdout */
+            byte_t buffer[4096];
+            uint32_t rsize;
+            stm = stm_memory(fsize + 512);
+            while (bproc_read(proc, buffer, sizeof(buffer), &rsize, NULL) == TRUE)
+                stm_write(stm, buffer, rsize);
         }
 
-        /* Create the destiny directory */
-        if (ok == TRUE)
+        bproc_eread_close(proc);
+
+        /* Crashed, killed or rejected config. Empty or partial output is not valid */
+        if (bproc_wait(proc) != 0 || (stm != NULL && stm_buffer_size(stm) == 0 && fsize > 0))
         {
-            const char_t *e = NULL;
-            str_split_pathname(dest, &path, &filename);
-            e = str_filext(tc(filename));
-            ext = str_c(e != NULL ? e : "");
-            ok = i_local_dir(tc(path));
-            if (ok == FALSE)
-                *error_msg = str_printf("Error creating '%s'", tc(path));
+            if (stm != NULL)
+                stm_close(&stm);
         }
 
-        /* Add legal header */
-        if (ok == TRUE && with_legal == TRUE && i_is_source_file(tc(ext)) == TRUE)
-        {
-            const byte_t *fdata = stm_buffer(filestm);
-            uint32_t fsize = stm_buffer_size(filestm);
-            Stream *stm = stm_memory(fsize + 512);
-            uint16_t year = (uint16_t)date_year();
-            stm_writef(stm, "/*\n");
-            stm_printf(stm, " * %s %s\n", tc(global->project), tc(global->description));
-
-            if (year == global->start_year)
-                stm_printf(stm, " * %d %s\n", global->start_year, tc(global->author));
-            else
-                stm_printf(stm, " * %d-%d %s\n", global->start_year, year, tc(global->author));
+        bproc_close(&proc);
+    }
 
-            if (arrpt_size(global->license, String) > 0)
-            {
-                arrpt_foreach(line, global->license, String)
-                    stm_writef(stm, " * ");
-                    str_writef(stm, line);
-                    stm_writef(stm, "\n");
-                arrpt_end()
-            }
+    str_destroy(&cmd);
+    return stm;
+}
 
-            stm_writef(stm, " *\n");
-            stm_printf(stm, " * File: %s\n", tc(filename));
+/*---------------------------------------------------------------------------*/
 
-            if (str_empty(global->doc_url) == FALSE && str_empty_c(file_doc_url) == FALSE)
-            {
-                if (str_equ(ext, "h") == TRUE || str_equ(ext, "hxx") == TRUE || str_equ(ext, "hpp") == TRUE)
-                {
-                    String *file = NULL;
-                    String *url = NULL;
-                    str_split_pathext(src, NULL, &file, NULL);
-                    url = str_printf("%s/%s/%s.html", tc(global->doc_url), file_doc_url, tc(file));
-                    if (http_exists(tc(url)) == TRUE)
-                        stm_printf(stm, " * %s\n", tc(url));
-                    str_destroy(&file);
-                    str_destroy(&url);
-                }
-            }
+static bool_t i_process_file(const Global *global, const ArrPt(String) *doc_pages, SrcCache *cache, const char_t *src, const char_t *dest, const char_t *file_doc_url, const bool_t with_legal, const char_t *clang_format, Stream **filestm, bool_t *formatted, bool_t *legalized, String **error_msg)
+{
+    bool_t ok = TRUE;
+    bool_t apply_legal = FALSE;
+    bool_t apply_format = FALSE;
+    bool_t in_cache = FALSE;
+    String *path = NULL, *filename = NULL, *ext = NULL;
+    String *key = NULL;
+    String *doc_url = NULL;
+    String *doc_page = NULL;
+    Stream *header = NULL;
+    cassert_no_null(global);
+    cassert_no_null(filestm);
+    cassert_no_null(*filestm);
+    cassert_no_null(error_msg);
+    cassert(*error_msg == NULL);
+    cassert_no_null(formatted);
+    cassert_no_null(legalized);
 
-            stm_writef(stm, " *\n");
-            stm_writef(stm, " */\n\n");
-            stm_write(stm, fdata, fsize);
+    /* Create the destiny directory */
+    {
+        const char_t *e = NULL;
+        str_split_pathname(dest, &path, &filename);
+        e = str_filext(tc(filename));
+        ext = str_c(e != NULL ? e : "");
+        ok = i_local_dir(tc(path));
+        if (ok == FALSE)
+            *error_msg = str_printf("Error creating '%s'", tc(path));
+    }
 
-            /* Change the stream */
-            stm_close(&filestm);
-            filestm = stm;
-            *legalized = TRUE;
-        }
+    if (i_is_source_file(tc(ext)) == TRUE)
+    {
+        apply_legal = with_legal;
+        apply_format = (bool_t)(str_empty_c(clang_format) == FALSE);
+    }
 
-        /* Clang-format the file */
-        if (ok == TRUE && str_empty_c(clang_format) == FALSE && i_is_source_file(tc(ext)) == TRUE)
-        {
-            String *cmd = str_printf("clang-format -style=file -assume-filename='%s'", tc(filename));
-            const byte_t *fdata = stm_buffer(filestm);
-            uint32_t fsize = stm_buffer_size(filestm);
-            Proc *proc = bproc_exec(tc(cmd), NULL);
-            Stream *stm = NULL;
+    /*
+     * The header text is the cache key of the legal part. The local manifest
+     * of doc pages is cheap. Without manifest, the doc server is only asked
+     * if the file is not in cache (the link is expected, the cache keeps the answer).
+     */
+    if (ok == TRUE && apply_legal == TRUE)
+    {
+        doc_url = i_doc_url(global, src, tc(ext), file_doc_url, &doc_page);
+        if (doc_url != NULL && doc_pages != NULL && prdoc_page_exists(doc_pages, tc(doc_page)) == FALSE)
+            str_destroy(&doc_url);
+        header = i_legal_header(global, tc(filename), tc(doc_url));
+    }
 
-            if (proc != NULL)
-            {
-                /* Write the file in clang-format stdin */
-                bool_t okc = bproc_write(proc, fdata, fsize, NULL, NULL);
-                if (okc == TRUE)
-                    okc = bproc_write_close(proc);
+    /* Unchanged files are taken from cache, without any process */
+    if (ok == TRUE && cache != NULL && (apply_legal == TRUE || apply_format == TRUE))
+    {
+        key = srccache_key(cache, tc(filename), apply_format, header, *filestm);
+        in_cache = srccache_get(cache, tc(key), dest);
+    }
 
-                if (okc == TRUE)
-                {
-                    /* Read from the clang-format stdout */
-                    byte_t buffer[512];
-                    uint32_t rsize;
-                    stm = stm_memory(2048);
-                    bproc_write_close(proc);
-                    while (bproc_read(proc, buffer, 512, &rsize, NULL) == TRUE)
-                        stm_write(stm, buffer, rsize);
-                }
+    /* Add legal header */
+    if (ok == TRUE && in_cache == FALSE && apply_legal == TRUE)
+    {
+        const byte_t *fdata = stm_buffer(*filestm);
+        uint32_t fsize = stm_buffer_size(*filestm);
+        if (doc_url != NULL && doc_pages == NULL && http_exists(tc(doc_url)) == FALSE)
+        {
+            stm_close(&header);
+            header = i_legal_header(global, tc(filename), NULL);
+        }
 
-                bproc_eread_close(proc);
-                bproc_wait(proc);
-                bproc_close(&proc);
-            }
+        stm_write(header, fdata, fsize);
 
-            /* Change the file to newly formatted file */
-            if (stm != NULL)
-            {
-                stm_close(&filestm);
-                filestm = stm;
-            }
+        /* Change the stream */
+        stm_close(filestm);
+        *filestm = header;
+        header = NULL;
+    }
 
-            str_destroy(&cmd);
-            *formatted = TRUE;
-        }
+    /* Clang-format the file */
+    if (ok == TRUE && in_cache == FALSE && apply_format == TRUE)
+    {
+        Stream *stm = i_clang_format(tc(filename), *filestm);
 
-        if (ok == TRUE)
+        /* Change the file to newly formatted file */
+        if (stm != NULL)
         {
-            const byte_t *data = stm_buffer(filestm);
-            uint32_t size = stm_buffer_size(filestm);
-            ok = hfile_from_data(dest, data, size, NULL);
-            if (ok == FALSE)
-                *error_msg = str_printf("Error copying '%s'", dest);
+            stm_close(filestm);
+            *filestm = stm;
+        }
+        else
+        {
+            /* Never written or cached */
+            *error_msg = str_printf("Error running clang-format in '%s'", src);
+            ok = FALSE;
         }
+    }
+
+    if (ok == TRUE && in_cache == FALSE)
+    {
+        const byte_t *data = stm_buffer(*filestm);
+        uint32_t size = stm_buffer_size(*filestm);
+        ok = hfile_from_data(dest, data, size, NULL);
+        if (ok == FALSE)
+            *error_msg = str_printf("Error copying '%s'", dest);
+        else if (key != NULL)
+            srccache_put(cache, tc(key), data, size);
+    }
+
+    if (ok == TRUE)
+    {
+        if (apply_legal == TRUE)
+            *legalized = TRUE;
+        if (apply_format == TRUE)
+            *formatted = TRUE;
+    }
+
+    str_destopt(&path);
+    str_destopt(&filename);
+    str_destopt(&ext);
+    str_destopt(&key);
+    str_destopt(&doc_url);
+    str_destopt(&doc_page);
+    if (header != NULL)
+        stm_close(&header);
+    stm_close(filestm);
+    return ok;
+}
 
-        str_destopt(&fileurl);
-        str_destopt(&path);
-        str_destopt(&filename);
-        str_destopt(&ext);
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_copy_repo_file(const Global *global, const ArrPt(String) *doc_pages, SrcCache *cache, const ArrPt(RegEx) *ignore_regex, const char_t *repo_url, const char_t *src, const char_t *dest, const char_t *file_doc_url, const uint32_t repo_vers, const char_t *repo_user, const char_t *repo_pass, const bool_t with_legal, const char_t *clang_format, bool_t *formatted, bool_t *legalized, String **error_msg)
+{
+    if (i_ignore_file(ignore_regex, src) == FALSE)
+    {
+        bool_t ok = TRUE;
+        String *fileurl = NULL;
+        Stream *filestm = NULL;
+        cassert_no_null(error_msg);
+        cassert(*error_msg == NULL);
 
+        /* Download file from repo */
+        fileurl = str_printf("%s/%s", repo_url, src);
+        filestm = ssh_repo_cat(tc(fileurl), repo_vers, repo_user, repo_pass);
         if (filestm != NULL)
-            stm_close(&filestm);
+        {
+            ok = i_process_file(global, doc_pages, cache, src, dest, file_doc_url, with_legal, clang_format, &filestm, formatted, legalized, error_msg);
+        }
+        else
+        {
+            ok = FALSE;
+            *error_msg = str_printf("Error download '%s'", src);
+        }
 
+        str_destroy(&fileurl);
         return ok;
     }
     /* The file matchs an ignore pattern */
@@ -295,7 +434,7 @@ static bool_t i_copy_repo_file(const Global *global, const ArrPt(RegEx) *ignore_
 
 /*---------------------------------------------------------------------------*/
 
-static bool_t i_copy_repo_dir(const Global *global, const ArrPt(RegEx) *ignore_regex, const char_t *repo_url, const char_t *src, const char_t *dest, const char_t *file_doc_url, const uint32_t repo_vers, const char_t *repo_user, const char_t *repo_pass, const bool_t with_legal, const char_t *clang_format, bool_t *formatted, bool_t *legalized, String **error_msg)
+static bool_t i_copy_repo_dir(const Global *global, const ArrPt(String) *doc_pages, SrcCache *cache, const ArrPt(RegEx) *ignore_regex, const char_t *repo_url, const char_t *src, const char_t *dest, const char_t *file_doc_url, const uint32_t repo_vers, const char_t *repo_user, const char_t *repo_pass, const bool_t with_legal, const char_t *clang_format, bool_t *formatted, bool_t *legalized, String **error_msg)
 {
     bool_t ok = TRUE;
     String *repo_dir = NULL;
@@ -323,13 +462,13 @@ static bool_t i_copy_repo_dir(const Global *global, const ArrPt(RegEx) *ignore_r
             {
                 String *nsrc = str_cn(tc(dir_src), str_len(dir_src) - 1);
                 String *ndest = str_cn(tc(dir_dest), str_len(dir_dest) - 1);
-                ok = i_copy_repo_dir(global, ignore_regex, repo_url, tc(nsrc), tc(ndest), file_doc_url, repo_vers, repo_user, repo_pass, with_legal, clang_format, formatted, legalized, error_msg);
+                ok = i_copy_repo_dir(global, doc_pages, cache, ignore_regex, repo_url, tc(nsrc), tc(ndest), file_doc_url, repo_vers, repo_user, repo_pass, with_legal, clang_format, formatted, legalized, error_msg);
                 str_destroy(&nsrc);
                 str_destroy(&ndest);
             }
             else
             {
-                ok = i_copy_repo_file(global, ignore_regex, repo_url, tc(dir_src), tc(dir_dest), file_doc_url, repo_vers, repo_user, repo_pass, with_legal, clang_format, formatted, legalized, error_msg);
+                ok = i_copy_repo_file(global, doc_pages, cache, ignore_regex, repo_url, tc(dir_src), tc(dir_dest), file_doc_url, repo_vers, repo_user, repo_pass, with_legal, clang_format, formatted, legalized, error_msg);
             }
 
             str_destroy(&dir_src);
@@ -350,7 +489,232 @@ static bool_t i_copy_repo_dir(const Global *global, const ArrPt(RegEx) *ignore_r
 
 /*---------------------------------------------------------------------------*/
 
-bool_t target_target(const Target *target, const Global *global, const ArrPt(RegEx) *ignore_regex, const uint32_t repo_vers, const char_t *format_file, const char_t *dest_path, const char_t *groupid, REvent *event, Report *report, bool_t *formatted, bool_t *legalized)
+static void i_remove_srcfile(SrcFile *file)
+{
+    cassert_no_null(file);
+    str_destroy(&file->src);
+    str_destroy(&file->wc);
+    str_destroy(&file->dest);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_local_files(const ArrPt(RegEx) *ignore_regex, const char_t *wc_path, const char_t *src, const char_t *dest, ArrSt(SrcFile) *files, String **error_msg)
+{
+    bool_t ok = TRUE;
+    ArrSt(DirEntry) *entries = hfile_dir_list(wc_path, TRUE, NULL);
+    cassert_no_null(error_msg);
+
+    /* Directories are created here, before the parallel processing */
+    ok = i_local_dir(dest);
+    if (ok == FALSE)
+        *error_msg = str_printf("Error creating '%s'", dest);
+
+    /* Walk the working copy without any repository access */
+    if (ok == TRUE)
+    {
+        arrst_foreach(entry, entries, DirEntry)
+            if (str_equ(entry->name, ".svn") == FALSE)
+            {
+                String *file_src = str_printf("%s/%s", src, tc(entry->name));
+                String *file_wc = str_cpath("%s/%s", wc_path, tc(entry->name));
+                String *file_dest = str_cpath("%s/%s", dest, tc(entry->name));
+
+                if (entry->type == ekDIRECTORY)
+                {
+                    ok = i_local_files(ignore_regex, tc(file_wc), tc(file_src), tc(file_dest), files, error_msg);
+                    str_destroy(&file_src);
+                    str_destroy(&file_wc);
+                    str_destroy(&file_dest);
+                }
+                else if (i_ignore_file(ignore_regex, tc(file_src)) == FALSE)
+                {
+                    SrcFile *file = arrst_new(files, SrcFile);
+                    file->src = file_src;
+                    file->wc = file_wc;
+                    file->dest = file_dest;
+                }
+                else
+                {
+                    str_destroy(&file_src);
+                    str_destroy(&file_wc);
+                    str_destroy(&file_dest);
+                }
+            }
+
+            if (ok == FALSE)
+                break;
+        arrst_end()
+    }
+
+    arrst_destroy(&entries, hfile_dir_entry_remove, DirEntry);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_srcpool_thread(SrcPool *pool)
+{
+    bool_t end = FALSE;
+    cassert_no_null(pool);
+    while (end == FALSE)
+    {
+        const SrcFile *file = NULL;
+        bmutex_lock(pool->mutex);
+        if (pool->ok == TRUE && pool->next < arrst_size(pool->files, SrcFile))
+        {
+            file = arrst_get_const(pool->files, pool->next, SrcFile);
+            pool->next += 1;
+        }
+        bmutex_unlock(pool->mutex);
+
+        if (file != NULL)
+        {
+            bool_t ok = TRUE;
+            bool_t formatted = FALSE;
+            bool_t legalized = FALSE;
+            String *error_msg = NULL;
+            Stream *filestm = hfile_stream(tc(file->wc), NULL);
+            if (filestm != NULL)
+            {
+                ok = i_process_file(pool->global, pool->doc_pages, pool->cache, tc(file->src), tc(file->dest), pool->file_doc_url, pool->with_legal, pool->clang_format, &filestm, &formatted, &legalized, &error_msg);
+            }
+            else
+            {
+                ok = FALSE;
+                error_msg = str_printf("Error reading '%s'", tc(file->wc));
+            }
+
+            bmutex_lock(pool->mutex);
+            if (formatted == TRUE)
+                pool->formatted = TRUE;
+            if (legalized == TRUE)
+                pool->legalized = TRUE;
+            if (ok == FALSE && pool->ok == TRUE)
+            {
+                pool->ok = FALSE;
+                pool->error_msg = error_msg;
+                error_msg = NULL;
+            }
+            bmutex_unlock(pool->mutex);
+            str_destopt(&error_msg);
+        }
+        else
+        {
+            end = TRUE;
+        }
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_copy_local_dir(const Global *global, const ArrPt(String) *doc_pages, SrcCache *cache, const ArrPt(RegEx) *ignore_regex, const char_t *wc_path, const char_t *src, const char_t *dest, const char_t *file_doc_url, const bool_t with_legal, const char_t *clang_format, bool_t *formatted, bool_t *legalized, String **error_msg)
+{
+    ArrSt(SrcFile) *files = arrst_create(SrcFile);
+    bool_t ok = TRUE;
+    cassert_no_null(formatted);
+    cassert_no_null(legalized);
+    cassert_no_null(error_msg);
+    cassert(*error_msg == NULL);
+    ok = i_local_files(ignore_regex, wc_path, src, dest, files, error_msg);
+
+    /* Legal header and clang-format in a pool of workers */
+    if (ok == TRUE)
+    {
+        SrcPool pool;
+        uint32_t i, nthreads = srccache_nthreads(cache);
+        Thread **threads = NULL;
+        if (nthreads > arrst_size(files, SrcFile))
+            nthreads = arrst_size(files, SrcFile);
+
+        pool.global = global;
+        pool.doc_pages = doc_pages;
+        pool.cache = cache;
+        pool.file_doc_url = file_doc_url;
+        pool.with_legal = with_legal;
+        pool.clang_format = clang_format;
+        pool.files = files;
+        pool.next = 0;
+        pool.ok = TRUE;
+        pool.formatted = FALSE;
+        pool.legalized = FALSE;
+        pool.error_msg = NULL;
+        pool.mutex = bmutex_create();
+
+        if (nthreads > 1)
+        {
+            threads = heap_new_n(nthreads, Thread *);
+            for (i = 1; i < nthreads; ++i)
+                threads[i] = bthread_create(i_srcpool_thread, &pool, SrcPool);
+        }
+
+        /* The current thread is also a worker */
+        i_srcpool_thread(&pool);
+
+        if (threads != NULL)
+        {
+            for (i = 1; i < nthreads; ++i)
+            {
+                bthread_wait(threads[i]);
+                bthread_close(&threads[i]);
+            }
+
+            heap_delete_n(&threads, nthreads, Thread *);
+        }
+
+        bmutex_close(&pool.mutex);
+        ok = pool.ok;
+        *error_msg = pool.error_msg;
+        if (pool.formatted == TRUE)
+            *formatted = TRUE;
+        if (pool.legalized == TRUE)
+            *legalized = TRUE;
+    }
+
+    arrst_destroy(&files, i_remove_srcfile, SrcFile);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static String *i_working_copy(const char_t *wc_root, const char_t *repo_branch, const char_t *target_name, const char_t *repo_url, const uint32_t repo_vers, const char_t *repo_user, const char_t *repo_pass)
+{
+    /* One cached working copy per branch and target root */
+    String *name = str_printf("%s/%s", repo_branch, target_name);
+    String *wc_path = NULL;
+    bool_t ok = FALSE;
+    str_subs(name, '/', '_');
+    wc_path = str_cpath("%s/%s", wc_root, tc(name));
+
+    /* Incremental update of a previous working copy */
+    if (hfile_dir(tc(wc_path)) == TRUE)
+    {
+        ok = ssh_repo_update(NULL, repo_user, repo_pass, repo_vers, tc(wc_path));
+        if (ok == TRUE)
+            log_printf("%s Updated working copy '%s%s%s' to r%d", kASCII_OK, kASCII_PATH, tc(wc_path), kASCII_RESET, repo_vers);
+        else
+            hfile_dir_destroy(tc(wc_path), NULL);
+    }
+
+    if (ok == FALSE && i_local_dir(wc_root) == TRUE)
+    {
+        ok = ssh_repo_checkout(NULL, repo_url, repo_user, repo_pass, repo_vers, tc(wc_path));
+        if (ok == TRUE)
+            log_printf("%s Checkout working copy '%s%s%s' at r%d", kASCII_OK, kASCII_PATH, tc(wc_path), kASCII_RESET, repo_vers);
+    }
+
+    str_destroy(&name);
+    if (ok == FALSE)
+        str_destroy(&wc_path);
+
+    return wc_path;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t target_target(const Target *target, const Global *global, const ArrPt(RegEx) *ignore_regex, const uint32_t repo_vers, const char_t *format_file, const ArrPt(String) *doc_pages, SrcCache *cache, const char_t *wc_root, const char_t *dest_path, const char_t *groupid, REvent *event, Report *report, bool_t *formatted, bool_t *legalized)
 {
     bool_t ok = TRUE;
     RState state;
@@ -379,9 +743,17 @@ bool_t target_target(const Target *target, const Global *global, const ArrPt(Reg
         report_event_init(report, event);
 
         if (ssh_repo_is_dir(tc(src), repo_vers, tc(global->repo_user), tc(global->repo_pass)) == TRUE)
-            ok = i_copy_repo_dir(global, ignore_regex, tc(repo_base), tc(target->name), tc(dest), tc(target->url), repo_vers, tc(global->repo_user), tc(global->repo_pass), target->legal, format, formatted, legalized, &error_msg);
+        {
+            /* Directories from a cached working copy. Per-file repo access as fallback */
+            String *wc_path = i_working_copy(wc_root, tc(global->repo_branch), tc(target->name), tc(src), repo_vers, tc(global->repo_user), tc(global->repo_pass));
+            if (wc_path != NULL)
+                ok = i_copy_local_dir(global, doc_pages, cache, ignore_regex, tc(wc_path), tc(target->name), tc(dest), tc(target->url), target->legal, format, formatted, legalized, &error_msg);
+            else
+                ok = i_copy_repo_dir(global, doc_pages, cache, ignore_regex, tc(repo_base), tc(target->name), tc(dest), tc(target->url), repo_vers, tc(global->repo_user), tc(global->repo_pass), target->legal, format, formatted, legalized, &error_msg);
+            str_destopt(&wc_path);
+        }
         else
-            ok = i_copy_repo_file(global, ignore_regex, tc(repo_base), tc(target->name), tc(dest), tc(target->url), repo_vers, tc(global->repo_user), tc(global->repo_pass), target->legal, format, formatted, legalized, &error_msg);
+            ok = i_copy_repo_file(global, doc_pages, cache, ignore_regex, tc(repo_base), tc(target->name), tc(dest), tc(target->url), repo_vers, tc(global->repo_user), tc(global->repo_pass), target->legal, format, formatted, legalized, &error_msg);
 
         report_event_end(report, event, ok, &error_msg);
         report_event_state(report, event, &state);
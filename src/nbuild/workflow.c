@@ -17,6 +17,10 @@
 #include "prdoc.h"
 #include "report.h"
 #include "sched.h"
+#include "srccache.h"
+#include "logstore.h"
+#include "hostexec.h"
+#include "simul.h"
 #include <nlib/ssh.h>
 #include <nlib/nlib.h>
 #include <encode/json.h>
@@ -29,8 +33,11 @@
 #include <core/strings.h>
 #include <core/stream.h>
 #include <osbs/bfile.h>
+#include <osbs/bmutex.h>
+#include <osbs/bthread.h>
 #include <osbs/log.h>
 #include <sewer/cassert.h>
+#include <sewer/ptr.h>
 
 struct _workflow_t
 {
@@ -51,6 +58,61 @@ struct _workflows_t
 DeclSt(Workflow);
 DeclSt(Workflows);
 
+typedef enum _stageid_t
+{
+    ekSTAGE_BOOT,
+    ekSTAGE_SOURCES,
+    ekSTAGE_DOCS,
+    ekSTAGE_JOBS,
+    ekSTAGE_NUM
+} stageid_t;
+
+typedef enum _stagest_t
+{
+    ekSTAGE_PENDING,
+    ekSTAGE_RUNNING,
+    ekSTAGE_DONE
+} stagest_t;
+
+typedef struct _stage_t Stage;
+typedef struct _pipeline_t Pipeline;
+typedef bool_t (*FPtr_stage)(Pipeline *pipe);
+
+struct _stage_t
+{
+    const char_t *name;
+    FPtr_stage func;
+    /* Bit mask of stages that must be successfully done before */
+    uint32_t deps;
+    stagest_t state;
+    bool_t ok;
+    REvent *event;
+    Thread *thread;
+    Pipeline *pipe;
+};
+
+struct _pipeline_t
+{
+    const Workflow *workflow;
+    const Network *network;
+    const Global *global;
+    const Drive *drive;
+    const char_t *forced_jobs;
+    const char_t *repo_url;
+    const char_t *project_vers;
+    uint32_t repo_vers;
+    uint32_t doc_repo_vers;
+    const ArrPt(RegEx) *ignore_regex;
+    const WorkPaths *wpaths;
+    Report *report;
+    RJournal *journal;
+    const HostExec *exec;
+    Preboot *preboot;
+    /* Protects the stages state */
+    Mutex *mutex;
+    Stage stages[ekSTAGE_NUM];
+};
+
 /*---------------------------------------------------------------------------*/
 
 void workflow_dbind(void)
@@ -78,10 +140,13 @@ void workflow_dbind(void)
     dbind(Global, bool_t, hosting_cert);
     dbind(Global, String *, hosting_docpath);
     dbind(Global, String *, hosting_buildpath);
+    dbind(Global, bool_t, incremental);
+    dbind(Global, uint32_t, clean_loops);
     dbind(Target, String *, name);
     dbind(Target, String *, dest);
     dbind(Target, String *, url);
     dbind(Target, String *, exec);
+    dbind(Target, uint32_t, timeout);
     dbind(Target, bool_t, legal);
     dbind(Target, bool_t, format);
     dbind(Target, bool_t, analyzer);
@@ -93,6 +158,7 @@ void workflow_dbind(void)
     dbind(Job, String *, config);
     dbind(Job, String *, generator);
     dbind(Job, String *, opts);
+    dbind(Job, String *, host);
     dbind(Job, ArrPt(String) *, tags);
     dbind(Workflow, Global, global);
     dbind(Workflow, String *, version);
@@ -283,11 +349,16 @@ static void i_destroy_workpaths(WorkPaths **paths)
         str_destopt(&(*paths)->tmp_test);
         str_destopt(&(*paths)->tmp_ndoc);
         str_destopt(&(*paths)->tmp_nrep);
+        str_destopt(&(*paths)->tmp_wc);
+        str_destopt(&(*paths)->tmp_fmt);
+        str_destopt(&(*paths)->tmp_log);
+        str_destopt(&(*paths)->drive_flow);
         str_destopt(&(*paths)->drive_path);
         str_destopt(&(*paths)->drive_inf);
         str_destopt(&(*paths)->drive_doc);
         str_destopt(&(*paths)->drive_rep);
         str_destopt(&(*paths)->drive_rep_web);
+        str_destopt(&(*paths)->drive_log);
         heap_delete(paths, WorkPaths);
     }
 }
@@ -302,7 +373,11 @@ static WorkPaths *i_workpaths(const Drive *drive, const char_t *tmppath, const c
     path->tmp_test = str_cpath("%s/%s", tc(path->tmp_path), "test");
     path->tmp_ndoc = str_cpath("%s/%s", tc(path->tmp_path), "ndoc_out");
     path->tmp_nrep = str_cpath("%s/%s", tc(path->tmp_path), "ndoc_rep");
-    path->drive_path = str_path(drive->login.platform, "%s/%s/r%d", tc(drive->path), flowid, repo_vers);
+    path->tmp_wc = str_cpath("%s/%s-WC", tmppath, flowid);
+    path->tmp_fmt = str_cpath("%s/%s-FMT", tmppath, flowid);
+    path->tmp_log = str_cpath("%s/%s-LOG", tmppath, flowid);
+    path->drive_flow = str_path(drive->login.platform, "%s/%s", tc(drive->path), flowid);
+    path->drive_path = str_path(drive->login.platform, "%s/r%d", tc(path->drive_flow), repo_vers);
     path->drive_inf = str_path(drive->login.platform, "%s/%s", tc(path->drive_path), "inf");
 
     if (doc_repo_vers != UINT32_MAX)
@@ -312,6 +387,7 @@ static WorkPaths *i_workpaths(const Drive *drive, const char_t *tmppath, const c
 
     path->drive_rep = str_path(drive->login.platform, "%s/%s-REP", tc(drive->path), flowid);
     path->drive_rep_web = str_path(drive->login.platform, "%s/%s-REPWEB/r%d", tc(drive->path), flowid, repo_vers);
+    path->drive_log = str_path(drive->login.platform, "%s/%s-LOG", tc(drive->path), flowid);
     return path;
 }
 
@@ -416,8 +492,37 @@ static bool_t i_create_remote_paths(const WorkPaths *paths, const Login *drive)
 
 /*---------------------------------------------------------------------------*/
 
-static void i_save_report(const Report *report, const Login *login, const char_t *infdir)
+static Report *i_load_report(const Login *login, const char_t *infdir, uint32_t *nrecords)
+{
+    Report *report = NULL;
+    Stream *stm = ssh_file_cat(login, infdir, NBUILD_REPORT_JSON);
+    ptr_assign(nrecords, 0);
+    if (stm != NULL)
+    {
+        report = json_read(stm, NULL, Report);
+        stm_close(&stm);
+    }
+
+    /* Changes after the last snapshot */
+    if (report != NULL && ssh_file_exists(login, infdir, NBUILD_REPORT_JOURNAL) == TRUE)
+    {
+        Stream *journal = ssh_file_cat(login, infdir, NBUILD_REPORT_JOURNAL);
+        if (journal != NULL)
+        {
+            uint32_t n = report_journal_replay(report, journal);
+            ptr_assign(nrecords, n);
+            stm_close(&journal);
+        }
+    }
+
+    return report;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_save_snapshot(const Report *report, const Login *login, const char_t *infdir)
 {
+    bool_t ok = TRUE;
     Stream *stm_json = stm_memory(2048);
     json_write(stm_json, report, NULL, Report);
 
@@ -433,9 +538,101 @@ static void i_save_report(const Report *report, const Login *login, const char_t
     */
 
     if (ssh_to_file(login, infdir, NBUILD_REPORT_JSON, stm_json) == FALSE)
+    {
         log_printf("%s Writing '%s'.", kASCII_FAIL, NBUILD_REPORT_JSON);
+        ok = FALSE;
+    }
 
     stm_close(&stm_json);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Job events are already in the journal, appended by the report writer as they happen.
+ * At the end of the loop, the journal is compacted into a new 'report.json' snapshot,
+ * that also has the loop state without journal records (stages, targets, docs, logs).
+ */
+static void i_save_report(Report *report, RJournal *journal, const Login *login, const char_t *infdir)
+{
+    /*
+     * The new snapshot has a new generation. If the old journal survives
+     * (crash or failed delete), its records are ignored when loading.
+     */
+    uint32_t gen = report_journal_gen(report);
+    uint32_t nrecords = report_journal_nrecords(journal);
+    report_journal_set_gen(report, gen + 1);
+    if (i_save_snapshot(report, login, infdir) == TRUE)
+    {
+        if (ssh_file_exists(login, infdir, NBUILD_REPORT_JOURNAL) == TRUE)
+        {
+            String *path = str_path(login->platform, "%s/%s", infdir, NBUILD_REPORT_JOURNAL);
+            if (ssh_delete_file(login, tc(path)) == FALSE)
+                log_printf("%s Deleting '%s'. Stale records will be ignored", kASCII_WARN, NBUILD_REPORT_JOURNAL);
+            str_destroy(&path);
+        }
+
+        report_journal_compacted(journal, report);
+        log_printf("%s Compacted '%s%s%s' (%d journal records)", kASCII_OK, kASCII_TARGET, NBUILD_REPORT_JSON, kASCII_RESET, nrecords);
+    }
+    else
+    {
+        /* The previous snapshot is still valid, with the job events in its journal */
+        report_journal_set_gen(report, gen);
+        if (report_journal_flush(journal) == FALSE)
+            log_printf("%s Appending '%s'", kASCII_FAIL, NBUILD_REPORT_JOURNAL);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_save_last_vers(const Login *login, const WorkPaths *wpaths, const uint32_t repo_vers)
+{
+    String *vers = str_printf("%d", repo_vers);
+    cassert_no_null(wpaths);
+    if (ssh_create_file(login, tc(wpaths->drive_flow), NBUILD_LAST_VERS, tc(vers)) == FALSE)
+        log_printf("%s Writing '%s'.", kASCII_FAIL, NBUILD_LAST_VERS);
+    str_destroy(&vers);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_import_times(Report *report, const Login *login, const WorkPaths *wpaths, const uint32_t repo_vers)
+{
+    uint32_t last_vers = UINT32_MAX;
+    cassert_no_null(wpaths);
+
+    /* The job duration history lives in the report of the last built repo version */
+    if (ssh_file_exists(login, tc(wpaths->drive_flow), NBUILD_LAST_VERS) == TRUE)
+    {
+        Stream *stm = ssh_file_cat(login, tc(wpaths->drive_flow), NBUILD_LAST_VERS);
+        if (stm != NULL)
+        {
+            const char_t *line = stm_read_trim(stm);
+            bool_t err = FALSE;
+            last_vers = str_to_u32(line, 10, &err);
+            if (err == TRUE)
+                last_vers = UINT32_MAX;
+            stm_close(&stm);
+        }
+    }
+
+    if (last_vers != UINT32_MAX && last_vers != repo_vers)
+    {
+        String *infpath = str_path(login->platform, "%s/r%d/inf", tc(wpaths->drive_flow), last_vers);
+        if (ssh_file_exists(login, tc(infpath), NBUILD_REPORT_JSON) == TRUE)
+        {
+            Report *last = i_load_report(login, tc(infpath), NULL);
+            if (last != NULL)
+            {
+                report_times_import(report, last);
+                log_printf("%s Job durations from '%sr%d%s'", kASCII_OK, kASCII_VERSION, last_vers, kASCII_RESET);
+                dbind_destroy(&last, Report);
+            }
+        }
+        str_destroy(&infpath);
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -463,6 +660,290 @@ static bool_t i_with_tests(const ArrSt(Target) *tests)
 
 /*---------------------------------------------------------------------------*/
 
+static bool_t i_stage_sources(Pipeline *pipe)
+{
+    bool_t ok = TRUE;
+    ArrPt(String) *doc_pages = NULL;
+    cassert_no_null(pipe);
+    doc_pages = prdoc_pages(&pipe->drive->login, pipe->wpaths);
+
+    /* Target source files */
+    if (ok == TRUE)
+    {
+        String *format_file = target_clang_format_file(pipe->workflow->sources, pipe->repo_url, tc(pipe->global->repo_user), tc(pipe->global->repo_pass), pipe->repo_vers, tc(pipe->wpaths->tmp_path));
+        SrcCache *cache = srccache_create(tc(pipe->wpaths->tmp_fmt), tc(format_file));
+        arrst_foreach_const(target, pipe->workflow->sources, Target)
+            const String *name = str_empty(target->dest) ? target->name : target->dest;
+            REvent *event = report_target_event(pipe->report, tc(name));
+            RState state;
+            report_event_state(pipe->report, event, &state);
+            if (state.done == FALSE)
+            {
+                bool_t formated = FALSE;
+                bool_t legalized = FALSE;
+                ok = target_target(target, pipe->global, pipe->ignore_regex, pipe->repo_vers, tc(format_file), doc_pages, cache, tc(pipe->wpaths->tmp_wc), tc(pipe->wpaths->tmp_src), "Source", event, pipe->report, &formated, &legalized);
+                report_target_set(pipe->report, tc(name), legalized, formated, target->analyzer);
+            }
+            if (ok == FALSE)
+                break;
+        arrst_end()
+        srccache_destroy(&cache);
+        str_destopt(&format_file);
+    }
+
+    /* Copy the tests */
+    if (ok == TRUE)
+    {
+        String *format_file = target_clang_format_file(pipe->workflow->tests, pipe->repo_url, tc(pipe->global->repo_user), tc(pipe->global->repo_pass), pipe->repo_vers, tc(pipe->wpaths->tmp_path));
+        SrcCache *cache = srccache_create(tc(pipe->wpaths->tmp_fmt), NULL);
+        arrst_foreach_const(test, pipe->workflow->tests, Target)
+            const String *name = str_empty(test->dest) ? test->name : test->dest;
+            REvent *event = report_test_event(pipe->report, tc(name));
+            RState state;
+            report_event_state(pipe->report, event, &state);
+            if (state.done == FALSE)
+            {
+                bool_t formated = FALSE;
+                bool_t legalized = FALSE;
+                ok = target_target(test, pipe->global, pipe->ignore_regex, pipe->repo_vers, NULL, doc_pages, cache, tc(pipe->wpaths->tmp_wc), tc(pipe->wpaths->tmp_test), "Test", event, pipe->report, &formated, &legalized);
+                report_test_set(pipe->report, tc(name), legalized, formated, test->analyzer);
+            }
+            if (ok == FALSE)
+                break;
+        arrst_end()
+        srccache_destroy(&cache);
+        str_destopt(&format_file);
+    }
+
+    /* Copy 'build.txt' */
+    if (ok == TRUE)
+        ok = target_build_file(tc(pipe->workflow->build), pipe->repo_vers, pipe->wpaths, pipe->report);
+
+    /* Compress source package */
+    if (ok == TRUE)
+    {
+        REvent *event = report_src_tar_event(pipe->report);
+        ok = target_tar(&pipe->drive->login, pipe->wpaths, tc(pipe->wpaths->tmp_src), NBUILD_SRC_TAR, event, pipe->report);
+    }
+
+    /* Compress test package */
+    if (ok == TRUE)
+    {
+        if (arrst_size(pipe->workflow->tests, Target) > 0)
+        {
+            REvent *event = report_test_tar_event(pipe->report);
+            ok = target_tar(&pipe->drive->login, pipe->wpaths, tc(pipe->wpaths->tmp_test), NBUILD_TEST_TAR, event, pipe->report);
+        }
+    }
+
+    arrpt_destopt(&doc_pages, str_destroy, String);
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_stage_docs(Pipeline *pipe)
+{
+    cassert_no_null(pipe);
+    /* 'ndoc' project documentation */
+    if (pipe->doc_repo_vers != UINT32_MAX)
+        return prdoc_generate(pipe->global, &pipe->drive->login, pipe->project_vers, pipe->repo_vers, pipe->doc_repo_vers, pipe->wpaths, pipe->report);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_select_jobs(Pipeline *pipe, ArrSt(SJob) *seljobs, const bool_t with_log)
+{
+    bool_t with_tests = FALSE;
+    cassert_no_null(pipe);
+    with_tests = i_with_tests(pipe->workflow->tests);
+    if (str_empty_c(pipe->forced_jobs) == TRUE)
+    {
+        report_select_jobs(pipe->report, pipe->workflow->jobs, seljobs, with_tests, pipe->journal);
+    }
+    else
+    {
+        if (with_log == TRUE)
+            log_printf("%s Forced jobs with pattern '%s%s%s'", kASCII_OK, kASCII_TARGET, pipe->forced_jobs, kASCII_RESET);
+        report_force_jobs(pipe->report, pipe->forced_jobs, pipe->workflow->jobs, seljobs, with_tests, pipe->journal);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_stage_boot(Pipeline *pipe)
+{
+    /* Speculative boot of the hosts that the selected jobs will need */
+    ArrSt(SJob) *seljobs = arrst_create(SJob);
+    cassert_no_null(pipe);
+    cassert(pipe->preboot == NULL);
+    i_select_jobs(pipe, seljobs, FALSE);
+    pipe->preboot = sched_preboot(seljobs, pipe->network->hosts, pipe->report, pipe->exec);
+    arrst_destroy(&seljobs, NULL, SJob);
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_stage_jobs(Pipeline *pipe)
+{
+    cassert_no_null(pipe);
+    if (report_can_start_jobs(pipe->report) == TRUE)
+    {
+        ArrSt(SJob) *seljobs = arrst_create(SJob);
+        i_select_jobs(pipe, seljobs, TRUE);
+
+        if (arrst_size(seljobs, SJob) > 0)
+        {
+            sched_start(pipe->global, seljobs, pipe->network->hosts, pipe->drive, pipe->workflow->tests, pipe->wpaths, tc(pipe->global->flowid), pipe->repo_vers, pipe->preboot, pipe->report, pipe->journal, ekSCHED_LPT_AFFINITY, pipe->exec);
+        }
+        else
+        {
+            log_printf("%s No jobs pending, nothing to do", kASCII_WARN);
+        }
+
+        arrst_destroy(&seljobs, NULL, SJob);
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_stage(Pipeline *pipe, const stageid_t id, const char_t *name, FPtr_stage func, const uint32_t deps)
+{
+    Stage *stage = NULL;
+    cassert_no_null(pipe);
+    cassert(id < ekSTAGE_NUM);
+    stage = &pipe->stages[id];
+    stage->name = name;
+    stage->func = func;
+    stage->deps = deps;
+    stage->state = ekSTAGE_PENDING;
+    stage->ok = FALSE;
+    stage->event = report_stage_event(pipe->report, name);
+    stage->thread = NULL;
+    stage->pipe = pipe;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_stage_thread(Stage *stage)
+{
+    bool_t ok = TRUE;
+    String *error_msg = NULL;
+    cassert_no_null(stage);
+    report_event_init(stage->pipe->report, stage->event);
+    ok = stage->func(stage->pipe);
+    if (ok == FALSE)
+        error_msg = str_printf("Stage '%s' failed", stage->name);
+    report_event_end(stage->pipe->report, stage->event, ok, &error_msg);
+    bmutex_lock(stage->pipe->mutex);
+    stage->ok = ok;
+    stage->state = ekSTAGE_DONE;
+    bmutex_unlock(stage->pipe->mutex);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_deps_done(const Pipeline *pipe, const Stage *stage, const bool_t failed)
+{
+    uint32_t i;
+    cassert_no_null(pipe);
+    cassert_no_null(stage);
+    for (i = 0; i < ekSTAGE_NUM; ++i)
+    {
+        if (stage->deps & (1u << i))
+        {
+            const Stage *dep = &pipe->stages[i];
+            if (failed == TRUE)
+            {
+                /* Some dependency has failed */
+                if (dep->state == ekSTAGE_DONE && dep->ok == FALSE)
+                    return TRUE;
+            }
+            else
+            {
+                /* All dependencies are done */
+                if (dep->state != ekSTAGE_DONE)
+                    return FALSE;
+            }
+        }
+    }
+
+    return (bool_t)!failed;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_pipeline_run(Pipeline *pipe)
+{
+    bool_t ok = TRUE;
+    uint32_t i;
+    cassert_no_null(pipe);
+
+    /* Each stage is launched in its own thread as soon as its dependencies are done */
+    for (;;)
+    {
+        uint32_t ndone = 0;
+        bmutex_lock(pipe->mutex);
+        for (i = 0; i < ekSTAGE_NUM; ++i)
+        {
+            Stage *stage = &pipe->stages[i];
+            if (stage->state == ekSTAGE_PENDING)
+            {
+                if (i_deps_done(pipe, stage, TRUE) == TRUE)
+                {
+                    log_printf("%s Stage '%s%s%s' cancelled by a failed dependency", kASCII_FAIL, kASCII_TARGET, stage->name, kASCII_RESET);
+                    stage->state = ekSTAGE_DONE;
+                    stage->ok = FALSE;
+                }
+                else if (i_deps_done(pipe, stage, FALSE) == TRUE)
+                {
+                    log_printf("%s Stage '%s%s%s' starting", kASCII_OK, kASCII_TARGET, stage->name, kASCII_RESET);
+                    stage->state = ekSTAGE_RUNNING;
+                    stage->thread = bthread_create(i_stage_thread, stage, Stage);
+                }
+            }
+
+            if (stage->state == ekSTAGE_DONE)
+                ndone += 1;
+        }
+        bmutex_unlock(pipe->mutex);
+
+        if (ndone == ekSTAGE_NUM)
+            break;
+
+        bthread_sleep(200);
+    }
+
+    /* Stage timings, to measure the overlap */
+    for (i = 0; i < ekSTAGE_NUM; ++i)
+    {
+        Stage *stage = &pipe->stages[i];
+        if (stage->thread != NULL)
+        {
+            RState state;
+            String *msg = str_printf("Stage '%s%s%s'", kASCII_TARGET, stage->name, kASCII_RESET);
+            bthread_wait(stage->thread);
+            bthread_close(&stage->thread);
+            report_event_state(pipe->report, stage->event, &state);
+            report_state_log(&state, tc(msg));
+            str_destroy(&msg);
+        }
+
+        if (stage->ok == FALSE)
+            ok = FALSE;
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static String *i_run(const Workflow *workflow, const Network *network, const char_t *forced_jobs, const char_t *logfile, const char_t *tmppath)
 {
     bool_t ok = TRUE;
@@ -477,7 +958,11 @@ static String *i_run(const Workflow *workflow, const Network *network, const cha
     String *project_vers = NULL;
     ArrPt(RegEx) *ignore_regex = NULL;
     WorkPaths *wpaths = NULL;
+    LogStore *logstore = NULL;
+    HostExec *exec = NULL;
     Report *report = NULL;
+    RJournal *journal = NULL;
+    bool_t jobs_done = FALSE;
     cassert_no_null(workflow);
     global = &workflow->global;
     drive = &network->drive;
@@ -566,18 +1051,30 @@ static String *i_run(const Workflow *workflow, const Network *network, const cha
     if (ok == TRUE)
         ok = i_create_remote_paths(wpaths, &drive->login);
 
+    /* Keepalive leases survive between runs, outside the flow temporal path */
+    if (ok == TRUE)
+    {
+        String *lease_path = str_cpath("%s/leases", tmppath);
+        exec = hostexec_create(tc(lease_path));
+        hostexec_reap(exec, network->hosts);
+        str_destroy(&lease_path);
+    }
+
+    /* Logs are kept out of report.json */
+    if (ok == TRUE)
+        logstore = logstore_create(&drive->login, tc(wpaths->drive_log), tc(wpaths->tmp_log));
+
     /* Loading report */
     if (ok == TRUE)
     {
         if (ssh_file_exists(&drive->login, tc(wpaths->drive_inf), NBUILD_REPORT_JSON) == TRUE)
         {
-            Stream *stm = ssh_file_cat(&drive->login, tc(wpaths->drive_inf), NBUILD_REPORT_JSON);
-            if (stm != NULL)
+            uint32_t nrecords = 0;
+            report = i_load_report(&drive->login, tc(wpaths->drive_inf), &nrecords);
+            if (report != NULL)
             {
-                report = json_read(stm, NULL, Report);
-                cassert_no_null(report);
-                log_printf("%s Readed '%sreport.json%s'", kASCII_OK, kASCII_TARGET, kASCII_RESET);
-                stm_close(&stm);
+                log_printf("%s Readed '%sreport.json%s' (%d journal records)", kASCII_OK, kASCII_TARGET, kASCII_RESET, nrecords);
+                journal = report_journal_create(&drive->login, tc(wpaths->drive_inf), report, nrecords);
                 report_loop_incr(report);
             }
             else
@@ -591,6 +1088,10 @@ static String *i_run(const Workflow *workflow, const Network *network, const cha
             report = dbind_create(Report);
             report_init(report, tc(repo_url), repo_vers);
             log_printf("%s Created '%sreport.json%s'", kASCII_OK, kASCII_TARGET, kASCII_RESET);
+            i_import_times(report, &drive->login, wpaths, repo_vers);
+            /* The journal records are replayed over a snapshot */
+            ok = i_save_snapshot(report, &drive->login, tc(wpaths->drive_inf));
+            journal = report_journal_create(&drive->login, tc(wpaths->drive_inf), report, 0);
         }
     }
 
@@ -602,115 +1103,59 @@ static String *i_run(const Workflow *workflow, const Network *network, const cha
         report_loop_init(report);
     }
 
-    /* Target source files */
-    if (ok == TRUE)
-    {
-        String *format_file = target_clang_format_file(workflow->sources, tc(repo_url), tc(global->repo_user), tc(global->repo_pass), repo_vers, tc(wpaths->tmp_path));
-        arrst_foreach_const(target, workflow->sources, Target)
-            const String *name = str_empty(target->dest) ? target->name : target->dest;
-            REvent *event = report_target_event(report, tc(name));
-            RState state;
-            report_event_state(report, event, &state);
-            if (state.done == FALSE)
-            {
-                bool_t formated = FALSE;
-                bool_t legalized = FALSE;
-                ok = target_target(target, global, ignore_regex, repo_vers, tc(format_file), tc(wpaths->tmp_src), "Source", event, report, &formated, &legalized);
-                report_target_set(report, tc(name), legalized, formated, target->analyzer);
-            }
-            if (ok == FALSE)
-                break;
-        arrst_end()
-        str_destopt(&format_file);
-    }
-
-    /* Copy the tests */
-    if (ok == TRUE)
-    {
-        String *format_file = target_clang_format_file(workflow->tests, tc(repo_url), tc(global->repo_user), tc(global->repo_pass), repo_vers, tc(wpaths->tmp_path));
-        arrst_foreach_const(test, workflow->tests, Target)
-            const String *name = str_empty(test->dest) ? test->name : test->dest;
-            REvent *event = report_test_event(report, tc(name));
-            RState state;
-            report_event_state(report, event, &state);
-            if (state.done == FALSE)
-            {
-                bool_t formated = FALSE;
-                bool_t legalized = FALSE;
-                ok = target_target(test, global, ignore_regex, repo_vers, NULL, tc(wpaths->tmp_test), "Test", event, report, &formated, &legalized);
-                report_test_set(report, tc(name), legalized, formated, test->analyzer);
-            }
-            if (ok == FALSE)
-                break;
-        arrst_end()
-        str_destopt(&format_file);
-    }
-
-    /* Copy 'build.txt' */
-    if (ok == TRUE)
-        ok = target_build_file(tc(workflow->build), repo_vers, wpaths, report);
-
-    /* Compress source package */
-    if (ok == TRUE)
-    {
-        REvent *event = report_src_tar_event(report);
-        ok = target_tar(&drive->login, wpaths, tc(wpaths->tmp_src), NBUILD_SRC_TAR, event, report);
-    }
-
-    /* Compress test package */
+    /*
+     * Workflow stages with explicit dependencies.
+     * Hosts are booted from the beginning.
+     * Jobs start as soon as the source packages exist.
+     * Documentation is generated concurrently.
+     */
     if (ok == TRUE)
     {
-        if (arrst_size(workflow->tests, Target) > 0)
-        {
-            REvent *event = report_test_tar_event(report);
-            ok = target_tar(&drive->login, wpaths, tc(wpaths->tmp_test), NBUILD_TEST_TAR, event, report);
-        }
+        Pipeline pipe;
+        pipe.workflow = workflow;
+        pipe.network = network;
+        pipe.global = global;
+        pipe.drive = drive;
+        pipe.forced_jobs = forced_jobs;
+        pipe.repo_url = tc(repo_url);
+        pipe.project_vers = tc(project_vers);
+        pipe.repo_vers = repo_vers;
+        pipe.doc_repo_vers = doc_repo_vers;
+        pipe.ignore_regex = ignore_regex;
+        pipe.wpaths = wpaths;
+        pipe.report = report;
+        pipe.journal = journal;
+        pipe.exec = exec;
+        pipe.preboot = NULL;
+        pipe.mutex = bmutex_create();
+        i_stage(&pipe, ekSTAGE_BOOT, "boot", i_stage_boot, 0);
+        i_stage(&pipe, ekSTAGE_SOURCES, "sources", i_stage_sources, 0);
+        i_stage(&pipe, ekSTAGE_DOCS, "docs", i_stage_docs, 0);
+        i_stage(&pipe, ekSTAGE_JOBS, "jobs", i_stage_jobs, (1u << ekSTAGE_BOOT) | (1u << ekSTAGE_SOURCES));
+        ok = i_pipeline_run(&pipe);
+        /* The jobs stage only is cancelled by boot or sources failures */
+        jobs_done = pipe.stages[ekSTAGE_JOBS].ok;
+        sched_preboot_end(&pipe.preboot);
+        bmutex_close(&pipe.mutex);
     }
 
-    /* 'ndoc' project documentation */
-    if (ok == TRUE && doc_repo_vers != UINT32_MAX)
-        ok = prdoc_generate(global, &drive->login, tc(project_vers), repo_vers, doc_repo_vers, wpaths, report);
-
-    /* Jobs */
-    if (ok == TRUE && report_can_start_jobs(report, doc_repo_vers) == TRUE)
-    {
-        ArrSt(SJob) *seljobs = arrst_create(SJob);
-        bool_t with_tests = i_with_tests(workflow->tests);
-
-        if (str_empty_c(forced_jobs) == TRUE)
-        {
-            report_select_jobs(report, workflow->jobs, seljobs, with_tests);
-        }
-        else
-        {
-            log_printf("%s Forced jobs with pattern '%s%s%s'", kASCII_OK, kASCII_TARGET, forced_jobs, kASCII_RESET);
-            report_force_jobs(report, forced_jobs, workflow->jobs, seljobs, with_tests);
-        }
-
-        if (arrst_size(seljobs, SJob) > 0)
-        {
-            sched_start(global, seljobs, network->hosts, drive, workflow->tests, wpaths, tc(global->flowid), repo_vers, report);
-        }
-        else
-        {
-            log_printf("%s No jobs pending, nothing to do", kASCII_WARN);
-        }
-
-        arrst_destroy(&seljobs, NULL, SJob);
-    }
-
-    /* Update report */
-    if (ok == TRUE)
+    /*
+     * Update report. Jobs run concurrently with the docs stage, so their results
+     * are saved even if docs have failed. The loop fails afterwards.
+     */
+    if (jobs_done == TRUE)
     {
         report_loop_end(report, logfile);
-        i_save_report(report, &drive->login, tc(wpaths->drive_inf));
+        report_store_logs(report, logstore);
+        i_save_report(report, journal, &drive->login, tc(wpaths->drive_inf));
+        i_save_last_vers(&drive->login, wpaths, repo_vers);
     }
 
     /* Generate build report web page */
     if (ok == TRUE)
     {
         if (str_empty(global->web_report_repo_url) == FALSE)
-            ok = prdoc_buildrep_generate(global, workflow->jobs, &drive->login, tc(project_vers), repo_vers, wpaths, report);
+            ok = prdoc_buildrep_generate(global, workflow->jobs, &drive->login, tc(project_vers), repo_vers, wpaths, report, logstore);
         else
             log_printf("%s No web report will be generated ('web_report_repo_url')", kASCII_WARN);
     }
@@ -735,6 +1180,15 @@ static String *i_run(const Workflow *workflow, const Network *network, const cha
     str_destopt(&repo_url);
     dbind_destopt(&report, Report);
 
+    if (journal != NULL)
+        report_journal_destroy(&journal);
+
+    if (logstore != NULL)
+        logstore_destroy(&logstore);
+
+    if (exec != NULL)
+        hostexec_destroy(&exec);
+
     if (wpaths != NULL)
     {
         String *drive_inf = str_copy(wpaths->drive_inf);
@@ -791,3 +1245,84 @@ String *workflow_run(Workflows *workflows, const Network *network, const char_t
 
     return infdir;
 }
+
+/*---------------------------------------------------------------------------*/
+
+static Report *i_load_history(const char_t *report_file)
+{
+    Report *report = NULL;
+    Stream *stm = stm_from_file(report_file, NULL);
+    if (stm != NULL)
+    {
+        report = json_read(stm, NULL, Report);
+        stm_close(&stm);
+    }
+
+    /* Changes after the last snapshot, in the same directory */
+    if (report != NULL)
+    {
+        String *path = NULL;
+        String *jrnpath = NULL;
+        str_split_pathname(report_file, &path, NULL);
+        jrnpath = str_cpath("%s/%s", tc(path), NBUILD_REPORT_JOURNAL);
+        stm = stm_from_file(tc(jrnpath), NULL);
+        if (stm != NULL)
+        {
+            report_journal_replay(report, stm);
+            stm_close(&stm);
+        }
+        str_destroy(&path);
+        str_destroy(&jrnpath);
+    }
+
+    return report;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t workflow_simulate(Workflows *workflows, const Network *network, const char_t *report_file)
+{
+    bool_t ok = FALSE;
+    Report *history = NULL;
+    cassert_no_null(workflows);
+    cassert(arrpt_size(workflows->workflows, String) == 1);
+    history = i_load_history(report_file);
+    if (history == NULL)
+        log_printf("%s Reading '%s' job durations", kASCII_FAIL, report_file);
+
+    arrpt_foreach(pfile, workflows->workflows, String)
+        Stream *stm = NULL;
+        if (history != NULL)
+            stm = stm_from_file(tc(pfile), NULL);
+
+        if (stm != NULL)
+        {
+            Workflow *workflow = json_read(stm, NULL, Workflow);
+            if (workflow != NULL)
+            {
+                Simul *sim = simul_create(history, workflow->jobs, network->hosts, 1);
+                log_printf("%s Simulating workflow '%s%s%s' with '%s%s%s' durations", kASCII_OK, kASCII_PATH, tc(pfile), kASCII_RESET, kASCII_PATH, report_file, kASCII_RESET);
+                simul_run(sim, &workflow->global, workflow->jobs, workflow->tests, network, ekSCHED_LPT_AFFINITY);
+                simul_run(sim, &workflow->global, workflow->jobs, workflow->tests, network, ekSCHED_LPT);
+                simul_run(sim, &workflow->global, workflow->jobs, workflow->tests, network, ekSCHED_FIFO);
+                log_printf("%s", "");
+                simul_log(sim);
+                simul_destroy(&sim);
+                json_destroy(&workflow, Workflow);
+                ok = TRUE;
+            }
+            else
+            {
+                log_printf("%s Parsing workflow file '%s'", kASCII_FAIL, tc(pfile));
+            }
+            stm_close(&stm);
+        }
+        else if (history != NULL)
+        {
+            log_printf("%s Reading workflow file '%s'", kASCII_FAIL, tc(pfile));
+        }
+    arrpt_end()
+
+    dbind_destopt(&history, Report);
+    return ok;
+}
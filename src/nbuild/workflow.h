@@ -17,3 +17,5 @@ void workflow_dbind(void);
 Workflows *workflow_create(const char_t *workflow_file);
 
 String *workflow_run(Workflows *workflows, const Network *network, const char_t *forced_jobs, const char_t *logfile, const char_t *tmppath);
+
+bool_t workflow_simulate(Workflows *workflows, const Network *network, const char_t *report_file);
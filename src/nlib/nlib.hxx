@@ -17,6 +17,7 @@
 
 typedef struct _login_t Login;
 typedef struct _vers_t Vers;
+typedef struct _sshbatch_t SSHBatch;
 
 struct _login_t
 {
@@ -35,4 +36,10 @@ struct _vers_t
     uint16_t patch;
 };
 
+/* Receives each complete output line of a running command */
+typedef void (*FPtr_ssh_line)(void *data, const char_t *line);
+
+#define FUNC_CHECK_SSH_LINE(func, type) \
+    (void)((void (*)(type *, const char_t *))func == func)
+
 #endif
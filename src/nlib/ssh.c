@@ -11,19 +11,29 @@
 /* SSH Commands */
 
 #include "ssh.h"
+#include "nlib.h"
+#include <core/arrpt.h>
+#include <core/arrst.h>
+#include <core/heap.h>
 #include <core/hfile.h>
 #include <core/stream.h>
 #include <core/strings.h>
+#include <osbs/bmutex.h>
 #include <osbs/bproc.h>
 #include <osbs/bthread.h>
+#include <osbs/btime.h>
 #include <osbs/bsocket.h>
 #include <osbs/log.h>
 #include <osbs/osbs.h>
+#include <sewer/bmem.h>
 #include <sewer/cassert.h>
 #include <sewer/bstd.h>
 #include <sewer/ptr.h>
 
 typedef struct _proc_std_t ProcStd;
+typedef struct _watchdog_t Watchdog;
+typedef struct _mux_t Mux;
+typedef struct _lines_t Lines;
 
 struct _proc_std_t
 {
@@ -31,8 +41,55 @@ struct _proc_std_t
     Stream *stm;
 };
 
+struct _watchdog_t
+{
+    Proc *proc;
+    Mutex *mutex;
+    uint32_t timeout;
+    bool_t done;
+    bool_t expired;
+};
+
+struct _lines_t
+{
+    FPtr_ssh_line func_line;
+    void *data;
+    char_t *buffer;
+    uint32_t size;
+    uint32_t capacity;
+};
+
+struct _sshbatch_t
+{
+    const Login *login;
+    ArrPt(String) *cmds;
+    ArrPt(String) *outs;
+    ArrSt(uint32_t) *rets;
+};
+
+struct _mux_t
+{
+    Mutex *mutex;
+    String *path;
+    ArrPt(String) *masters;
+    uint32_t handshakes;
+    uint32_t reused;
+};
+
 #define READ_BUFFER_SIZE 1024
 
+/* Seconds an idle master connection stays alive */
+static const uint32_t i_MUX_PERSIST = 600;
+
+static Mux *i_MUX = NULL;
+
+/* sshd port and the protocol identification prefix (RFC 4253) */
+static const uint16_t i_SSH_PORT = 22;
+static const char_t *i_SSH_BANNER = "SSH-";
+
+/* Echoed after each batch step, followed by the step index and exit code */
+static const char_t *i_BATCH_MARK = "NBATCH@STEP";
+
 /*
 SSH Return Codes
 ================
@@ -110,15 +167,87 @@ static uint32_t i_std_err(ProcStd *data)
 
 /*---------------------------------------------------------------------------*/
 
-uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_)
+static uint32_t i_watchdog(Watchdog *dog)
+{
+    uint64_t init = btime_now();
+    bool_t end = FALSE;
+    cassert_no_null(dog);
+    while (end == FALSE)
+    {
+        bmutex_lock(dog->mutex);
+        if (dog->done == TRUE)
+        {
+            end = TRUE;
+        }
+        else if ((btime_now() - init) / 1000000 >= (uint64_t)dog->timeout)
+        {
+            /* Killing the process closes its pipes and unblocks the reader */
+            bproc_cancel(dog->proc);
+            dog->expired = TRUE;
+            end = TRUE;
+        }
+        bmutex_unlock(dog->mutex);
+
+        if (end == FALSE)
+            bthread_sleep(200);
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_lines_flush(Lines *lines)
+{
+    cassert_no_null(lines);
+    cassert(lines->size < lines->capacity);
+    lines->buffer[lines->size] = '\0';
+    lines->func_line(lines->data, lines->buffer);
+    lines->size = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Split the output in lines as it arrives, without keep the whole output */
+static void i_lines_push(Lines *lines, const byte_t *data, const uint32_t size)
+{
+    uint32_t i = 0;
+    cassert_no_null(lines);
+    for (i = 0; i < size; ++i)
+    {
+        if (data[i] == '\n')
+        {
+            i_lines_flush(lines);
+        }
+        else if (data[i] != '\r')
+        {
+            if (lines->size + 1 >= lines->capacity)
+            {
+                uint32_t capacity = lines->capacity * 2;
+                lines->buffer = heap_realloc_n(lines->buffer, lines->capacity, capacity, char_t);
+                lines->capacity = capacity;
+            }
+
+            lines->buffer[lines->size] = (char_t)data[i];
+            lines->size += 1;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_command(const char_t *cmd, Stream **stdout_, Stream **stderr_, Lines *lines, const uint32_t timeout, bool_t *expired)
 {
     Proc *proc = bproc_exec(cmd, NULL);
     uint32_t return_value = UINT32_MAX;
+    ptr_assign(expired, FALSE);
 
     if (proc != NULL)
     {
         ProcStd proc_err = {NULL, NULL};
+        Watchdog dog = {NULL, NULL, 0, FALSE, FALSE};
         Thread *thread_err = NULL;
+        Thread *thread_dog = NULL;
         byte_t buffer[READ_BUFFER_SIZE + 1];
         uint32_t rsize, ret;
 
@@ -133,12 +262,27 @@ uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_)
             thread_err = bthread_create(i_std_err, &proc_err, ProcStd);
         }
 
+        if (timeout > 0)
+        {
+            dog.proc = proc;
+            dog.mutex = bmutex_create();
+            dog.timeout = timeout;
+            thread_dog = bthread_create(i_watchdog, &dog, Watchdog);
+        }
+
         while (bproc_read(proc, buffer, READ_BUFFER_SIZE, &rsize, NULL) == TRUE)
         {
             if (stdout_ != NULL)
                 stm_write(*stdout_, buffer, rsize);
+
+            if (lines != NULL)
+                i_lines_push(lines, buffer, rsize);
         }
 
+        /* Last line without end-of-line */
+        if (lines != NULL && lines->size > 0)
+            i_lines_flush(lines);
+
         if (stderr_ != NULL)
         {
             bproc_eread_close(proc);
@@ -146,6 +290,17 @@ uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_)
 
         ret = bproc_wait(proc);
 
+        if (thread_dog != NULL)
+        {
+            bmutex_lock(dog.mutex);
+            dog.done = TRUE;
+            bmutex_unlock(dog.mutex);
+            bthread_wait(thread_dog);
+            bthread_close(&thread_dog);
+            bmutex_close(&dog.mutex);
+            ptr_assign(expired, dog.expired);
+        }
+
         if (thread_err != NULL)
         {
             bthread_wait(thread_err);
@@ -161,6 +316,187 @@ uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_)
 
 /*---------------------------------------------------------------------------*/
 
+uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_)
+{
+    return i_command(cmd, stdout_, stderr_, NULL, 0, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_command_lines(const char_t *cmd, FPtr_ssh_line func_line, void *data)
+{
+    Lines lines;
+    uint32_t ret = UINT32_MAX;
+    cassert_no_nullf(func_line);
+    lines.func_line = func_line;
+    lines.data = data;
+    lines.capacity = 512;
+    lines.size = 0;
+    lines.buffer = heap_new_n(lines.capacity, char_t);
+    ret = i_command(cmd, NULL, NULL, &lines, 0, NULL);
+    heap_delete_n(&lines.buffer, lines.capacity, char_t);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_command_lines_imp(const char_t *cmd, FPtr_ssh_line func_line, void *data)
+{
+    return i_command_lines(cmd, func_line, data);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void ssh_mux_start(const char_t *path)
+{
+    cassert(i_MUX == NULL);
+    cassert_no_null(path);
+
+    /* OpenSSH ControlMaster is only available in the Linux master */
+    if (osbs_platform() != ekLINUX)
+        return;
+
+    /* Sockets of a previous crashed session */
+    if (hfile_exists(path, NULL) == TRUE)
+        hfile_dir_destroy(path, NULL);
+
+    if (hfile_dir_create(path, NULL) == TRUE)
+    {
+        i_MUX = heap_new0(Mux);
+        i_MUX->mutex = bmutex_create();
+        i_MUX->path = str_c(path);
+        i_MUX->masters = arrpt_create(String);
+    }
+    else
+    {
+        log_printf("%s Creating '%s' ssh control folder. Connections will not be shared", kASCII_WARN, path);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static String *i_mux_socket(const Login *login)
+{
+    cassert_no_null(i_MUX);
+    cassert_no_null(login);
+    return str_printf("%s/%s@%s", tc(i_MUX->path), tc(login->user), tc(login->ip));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void i_mux_exit(const char_t *socket, const char_t *userip)
+{
+    String *cmd = str_printf("ssh -O exit -o ControlPath=%s %s", socket, userip);
+    i_command(tc(cmd), NULL, NULL, NULL, 0, NULL);
+    str_destroy(&cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void ssh_mux_finish(void)
+{
+    if (i_MUX != NULL)
+    {
+        arrpt_foreach(userip, i_MUX->masters, String)
+            String *socket = str_printf("%s/%s", tc(i_MUX->path), tc(userip));
+            if (hfile_exists(tc(socket), NULL) == TRUE)
+                i_mux_exit(tc(socket), tc(userip));
+            str_destroy(&socket);
+        arrpt_end()
+
+        log_printf("%s SSH connections: %s%d%s handshakes, %s%d%s reused", kASCII_OK, kASCII_VERSION, i_MUX->handshakes, kASCII_RESET, kASCII_VERSION, i_MUX->reused, kASCII_RESET);
+        hfile_dir_destroy(tc(i_MUX->path), NULL);
+        arrpt_destroy(&i_MUX->masters, str_destroy, String);
+        str_destroy(&i_MUX->path);
+        bmutex_close(&i_MUX->mutex);
+        heap_delete(&i_MUX, Mux);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void ssh_mux_stats(uint32_t *handshakes, uint32_t *reused)
+{
+    cassert_no_null(handshakes);
+    cassert_no_null(reused);
+    *handshakes = 0;
+    *reused = 0;
+    if (i_MUX != NULL)
+    {
+        bmutex_lock(i_MUX->mutex);
+        *handshakes = i_MUX->handshakes;
+        *reused = i_MUX->reused;
+        bmutex_unlock(i_MUX->mutex);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int i_userip_cmp(const String *str1, const String *str2)
+{
+    return str_scmp(str1, str2);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * ssh options to share a persistent master connection with 'login'.
+ * The first command opens the master (ControlMaster=auto) and the next ones
+ * reuse the channel, without new TCP + key-exchange + auth handshakes.
+ */
+static String *i_mux_opts(const Login *login)
+{
+    String *opts = NULL;
+    if (i_MUX != NULL && i_localhost(login) == FALSE)
+    {
+        String *socket = i_mux_socket(login);
+        String *userip = str_printf("%s@%s", tc(login->user), tc(login->ip));
+        bmutex_lock(i_MUX->mutex);
+
+        if (hfile_exists(tc(socket), NULL) == TRUE)
+            i_MUX->reused += 1;
+        else
+            i_MUX->handshakes += 1;
+
+        if (arrpt_search(i_MUX->masters, i_userip_cmp, userip, NULL, String, String) == NULL)
+        {
+            arrpt_append(i_MUX->masters, userip, String);
+            userip = NULL;
+        }
+
+        bmutex_unlock(i_MUX->mutex);
+        opts = str_printf("-o ControlMaster=auto -o ControlPath=%s -o ControlPersist=%d", tc(socket), i_MUX_PERSIST);
+        str_destroy(&socket);
+        str_destopt(&userip);
+    }
+    else
+    {
+        opts = str_c("");
+    }
+
+    return opts;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Close the master connection of a host that is going down */
+static void i_mux_forget(const Login *login)
+{
+    if (i_MUX != NULL && i_localhost(login) == FALSE)
+    {
+        String *socket = i_mux_socket(login);
+        String *userip = str_printf("%s@%s", tc(login->user), tc(login->ip));
+        bmutex_lock(i_MUX->mutex);
+        if (hfile_exists(tc(socket), NULL) == TRUE)
+            i_mux_exit(tc(socket), tc(userip));
+        bmutex_unlock(i_MUX->mutex);
+        str_destroy(&socket);
+        str_destroy(&userip);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static String *i_ssh_compose(const Login *login, const char_t *cmd)
 {
     String *ssh = NULL;
@@ -174,13 +510,18 @@ static String *i_ssh_compose(const Login *login, const char_t *cmd)
             break;
 
         case ekLINUX:
+        {
+            String *opts = NULL;
             cassert_no_null(login);
+            opts = i_mux_opts(login);
             if (login->use_sshpass == TRUE)
-                ssh = str_printf("sshpass -p '%s' ssh %s@%s '%s'", tc(login->pass), tc(login->user), tc(login->ip), cmd);
+                ssh = str_printf("sshpass -p '%s' ssh %s %s@%s '%s'", tc(login->pass), tc(opts), tc(login->user), tc(login->ip), cmd);
             else
                 /* Uses ssh certificates */
-                ssh = str_printf("ssh %s@%s '%s'", tc(login->user), tc(login->ip), cmd);
+                ssh = str_printf("ssh %s %s@%s '%s'", tc(opts), tc(login->user), tc(login->ip), cmd);
+            str_destroy(&opts);
             break;
+        }
 
         case ekMACOS:
         case ekIOS:
@@ -198,7 +539,7 @@ static String *i_ssh_compose(const Login *login, const char_t *cmd)
 
 /*---------------------------------------------------------------------------*/
 
-static Stream *i_ssh_command(const Login *login, const char_t *cmd, const bool_t capture_stderr, uint32_t *return_value)
+static Stream *i_ssh_command_timeout(const Login *login, const char_t *cmd, const bool_t capture_stderr, const uint32_t timeout, bool_t *expired, uint32_t *return_value)
 {
     Stream *stdout_ = NULL;
     Stream *stderr_ = NULL;
@@ -206,7 +547,7 @@ static Stream *i_ssh_command(const Login *login, const char_t *cmd, const bool_t
 
     {
         String *ssh = i_ssh_compose(login, cmd);
-        ret = ssh_command(tc(ssh), &stdout_, (capture_stderr == TRUE) ? &stderr_ : NULL);
+        ret = i_command(tc(ssh), &stdout_, (capture_stderr == TRUE) ? &stderr_ : NULL, NULL, timeout, expired);
         str_destroy(&ssh);
     }
 
@@ -227,6 +568,23 @@ static Stream *i_ssh_command(const Login *login, const char_t *cmd, const bool_t
 
 /*---------------------------------------------------------------------------*/
 
+static Stream *i_ssh_command(const Login *login, const char_t *cmd, const bool_t capture_stderr, uint32_t *return_value)
+{
+    return i_ssh_command_timeout(login, cmd, capture_stderr, 0, NULL, return_value);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_ssh_command_lines(const Login *login, const char_t *cmd, FPtr_ssh_line func_line, void *data)
+{
+    String *ssh = i_ssh_compose(login, cmd);
+    uint32_t ret = i_command_lines(tc(ssh), func_line, data);
+    str_destroy(&ssh);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static bool_t i_ssh_ok(const Login *login, String **cmd)
 {
     uint32_t ret = UINT32_MAX;
@@ -284,6 +642,30 @@ bool_t ssh_ping(const char_t *ip)
 
 /*---------------------------------------------------------------------------*/
 
+bool_t ssh_probe(const char_t *ip, const uint32_t timeout_ms)
+{
+    /* In-process TCP connect. The host is ready when sshd sends its banner, not when it answers a ping */
+    bool_t ok = FALSE;
+    Socket *socket = bsocket_connect(bsocket_str_ip(ip), i_SSH_PORT, timeout_ms, NULL);
+    if (socket != NULL)
+    {
+        byte_t banner[4];
+        uint32_t rsize = 0;
+        bsocket_read_timeout(socket, timeout_ms);
+        if (bsocket_read(socket, banner, sizeof(banner), &rsize, NULL) == TRUE)
+        {
+            if (rsize == sizeof(banner) && bmem_cmp(banner, cast_const(i_SSH_BANNER, byte_t), sizeof(banner)) == 0)
+                ok = TRUE;
+        }
+
+        bsocket_close(&socket);
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static uint32_t i_repo_version(const char_t *cmd)
 {
     Stream *stm = i_ssh_command(NULL, cmd, FALSE, NULL);
@@ -472,6 +854,15 @@ bool_t ssh_repo_checkout(const Login *login, const char_t *repo_url, const char_
 
 /*---------------------------------------------------------------------------*/
 
+bool_t ssh_repo_update(const Login *login, const char_t *user, const char_t *pass, const uint32_t repo_vers, const char_t *path)
+{
+    /* svn update C:/wctest -r 1001 */
+    String *cmd = str_printf("svn update --username %s --password %s --non-interactive --no-auth-cache %s -r %d", user, pass, path, repo_vers);
+    return i_ssh_ok(login, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
 static bool_t i_exists(const Login *login, const char_t *file, const file_type_t type)
 {
     bool_t exists = FALSE;
@@ -637,6 +1028,248 @@ bool_t ssh_delete_dir(const Login *login, const char_t *path)
 
 /*---------------------------------------------------------------------------*/
 
+bool_t ssh_delete_expired(const Login *login, const char_t *path, const char_t *pattern, const uint32_t days)
+{
+    String *cmd = NULL;
+    cassert_no_null(login);
+    /* 'forfiles' fails if no file matches, 'ver' resets the error level */
+    if (login->platform == ekWINDOWS)
+        cmd = str_printf("forfiles /p %s /m %s /d -%d /c \"cmd /c del @path\" 2>nul || ver>nul", path, pattern, days);
+    else
+        cmd = str_printf("find %s -maxdepth 1 -name '%s' -mtime +%d -delete", path, pattern, days);
+    return i_ssh_ok(login, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static platform_t i_login_platform(const Login *login)
+{
+    if (login != NULL)
+        return login->platform;
+    return osbs_platform();
+}
+
+/*---------------------------------------------------------------------------*/
+
+SSHBatch *ssh_batch_create(const Login *login)
+{
+    SSHBatch *batch = heap_new0(SSHBatch);
+    batch->login = login;
+    batch->cmds = arrpt_create(String);
+    batch->outs = arrpt_create(String);
+    batch->rets = arrst_create(uint32_t);
+    return batch;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void ssh_batch_destroy(SSHBatch **batch)
+{
+    cassert_no_null(batch);
+    cassert_no_null(*batch);
+    arrpt_destroy(&(*batch)->cmds, str_destroy, String);
+    arrpt_destroy(&(*batch)->outs, str_destroy, String);
+    arrst_destroy(&(*batch)->rets, NULL, uint32_t);
+    heap_delete(batch, SSHBatch);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_batch_add(SSHBatch *batch, String **cmd)
+{
+    cassert_no_null(batch);
+    cassert_no_null(cmd);
+    cassert(arrst_size(batch->rets, uint32_t) == 0);
+    arrpt_append(batch->cmds, *cmd, String);
+    *cmd = NULL;
+    return arrpt_size(batch->cmds, String) - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_batch_create_dir(SSHBatch *batch, const char_t *dir)
+{
+    String *cmd = NULL;
+    cassert_no_null(batch);
+    /* Command extensions make 'mkdir' create the intermediate folders */
+    if (i_login_platform(batch->login) == ekWINDOWS)
+        cmd = str_printf("if not exist %s mkdir %s", dir, dir);
+    else
+        cmd = str_printf("mkdir -p %s", dir);
+    return ssh_batch_add(batch, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_batch_delete_dir(SSHBatch *batch, const char_t *path)
+{
+    String *cmd = NULL;
+    cassert_no_null(batch);
+    if (i_login_platform(batch->login) == ekWINDOWS)
+        cmd = str_printf("if exist %s rd /s /q %s", path, path);
+    else
+        cmd = str_printf("rm -rf %s", path);
+    return ssh_batch_add(batch, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static const char_t *i_ncpus_cmd(const platform_t platform)
+{
+    if (platform == ekWINDOWS)
+        return "echo %NUMBER_OF_PROCESSORS%";
+    else if (platform == ekMACOS)
+        return "sysctl -n hw.ncpu";
+    else
+        return "nproc";
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_batch_ncpus(SSHBatch *batch)
+{
+    String *cmd = NULL;
+    cassert_no_null(batch);
+    cmd = str_c(i_ncpus_cmd(i_login_platform(batch->login)));
+    return ssh_batch_add(batch, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static String *i_batch_script(const SSHBatch *batch)
+{
+    platform_t platform = i_login_platform(batch->login);
+    Stream *stm = stm_memory(1024);
+    String *script = NULL;
+
+    /*
+     * Steps run in order and the script stops at the first failure.
+     * cmd expands %errorlevel% when the line is parsed, so in Windows
+     * steps are chained with '&&' and the failed step is the first without mark.
+     */
+    arrpt_foreach_const(cmd, batch->cmds, String)
+        if (platform == ekWINDOWS)
+            stm_printf(stm, "%s(%s) 2>&1 && echo %s %d 0", cmd_i > 0 ? " && " : "", tc(cmd), i_BATCH_MARK, cmd_i);
+        else
+            stm_printf(stm, "{ %s; } 2>&1; r=$?; echo %s %d $r; [ $r -eq 0 ] || exit $r; ", tc(cmd), i_BATCH_MARK, cmd_i);
+    arrpt_end()
+
+    script = stm_str(stm);
+    stm_close(&stm);
+    return script;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t ssh_batch_run(SSHBatch *batch)
+{
+    String *script = NULL;
+    Stream *stm = NULL;
+    Stream *out = stm_memory(512);
+    uint32_t ret = UINT32_MAX;
+    uint32_t i, n = 0;
+    bool_t ok = TRUE;
+    cassert_no_null(batch);
+    cassert(arrst_size(batch->rets, uint32_t) == 0);
+    n = arrpt_size(batch->cmds, String);
+    for (i = 0; i < n; ++i)
+    {
+        arrpt_append(batch->outs, NULL, String);
+        arrst_append(batch->rets, UINT32_MAX, uint32_t);
+    }
+
+    script = i_batch_script(batch);
+    stm = i_ssh_command(batch->login, tc(script), FALSE, &ret);
+
+    if (stm != NULL)
+    {
+        const char_t *line = stm_read_line(stm);
+        while (line != NULL)
+        {
+            String *left = NULL;
+            String *right = NULL;
+            if (str_split(line, i_BATCH_MARK, &left, &right) == TRUE)
+            {
+                String *sstep = NULL;
+                String *sret = NULL;
+                /* The mark is followed by ' <step> <ret>' */
+                String *mark = str_trim(tc(right));
+                stm_writef(out, tc(left));
+                if (str_split_trim(tc(mark), " ", &sstep, &sret) == TRUE)
+                {
+                    bool_t err1 = FALSE, err2 = FALSE;
+                    uint32_t step = str_to_u32(tc(sstep), 10, &err1);
+                    uint32_t sret_v = str_to_u32(tc(sret), 10, &err2);
+                    if (err1 == FALSE && err2 == FALSE && step < n)
+                    {
+                        String **outstr = arrpt_all(batch->outs, String) + step;
+                        str_destopt(outstr);
+                        *outstr = stm_str(out);
+                        *arrst_get(batch->rets, step, uint32_t) = sret_v;
+                        stm_close(&out);
+                        out = stm_memory(512);
+                    }
+                }
+
+                str_destopt(&sstep);
+                str_destopt(&sret);
+                str_destroy(&mark);
+            }
+            else
+            {
+                stm_writef(out, line);
+                stm_writef(out, "\n");
+            }
+
+            str_destopt(&left);
+            str_destopt(&right);
+            line = stm_read_line(stm);
+        }
+
+        stm_close(&stm);
+    }
+
+    /* The first step without mark is the failed one. The next ones didn't run */
+    for (i = 0; i < n; ++i)
+    {
+        uint32_t *step_ret = arrst_get(batch->rets, i, uint32_t);
+        if (*step_ret == UINT32_MAX)
+        {
+            String **outstr = arrpt_all(batch->outs, String) + i;
+            *step_ret = (ret != 0) ? ret : 1;
+            *outstr = stm_str(out);
+            ok = FALSE;
+            break;
+        }
+        else if (*step_ret != 0)
+        {
+            ok = FALSE;
+        }
+    }
+
+    str_destroy(&script);
+    stm_close(&out);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_batch_ret(const SSHBatch *batch, const uint32_t step)
+{
+    cassert_no_null(batch);
+    return *arrst_get_const(batch->rets, step, uint32_t);
+}
+
+/*---------------------------------------------------------------------------*/
+
+const char_t *ssh_batch_output(const SSHBatch *batch, const uint32_t step)
+{
+    cassert_no_null(batch);
+    return tc(arrpt_get_const(batch->outs, step, String));
+}
+
+/*---------------------------------------------------------------------------*/
+
 Stream *ssh_file_cat(const Login *login, const char_t *path, const char_t *filename)
 {
     String *cmd = NULL;
@@ -688,12 +1321,71 @@ bool_t ssh_to_file(const Login *login, const char_t *path, const char_t *filenam
     }
     else
     {
-        String *tmp = hfile_appdata("temp_file");
+        /* Several threads can write remote files at the same time */
+        String *name = str_printf("temp_file_%d", bthread_current_id());
+        String *tmp = hfile_appdata(tc(name));
         Stream *file = stm_to_file(tc(tmp), NULL);
         stm_write(file, data, size);
         stm_close(&file);
         ok = ssh_scp(NULL, tc(tmp), login, tc(dest), FALSE, FALSE);
         str_destroy(&tmp);
+        str_destroy(&name);
+    }
+
+    str_destroy(&dest);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+bool_t ssh_append_file(const Login *login, const char_t *path, const char_t *filename, const Stream *stm)
+{
+    const byte_t *data = stm_buffer(stm);
+    uint32_t size = stm_buffer_size(stm);
+    String *dest = i_join_file(login, path, filename);
+    bool_t ok = FALSE;
+
+    if (i_localhost(login))
+    {
+        /* Append mode doesn't create the file */
+        Stream *file = NULL;
+        if (hfile_exists(tc(dest), NULL) == TRUE)
+            file = stm_append_file(tc(dest), NULL);
+        else
+            file = stm_to_file(tc(dest), NULL);
+
+        if (file != NULL)
+        {
+            stm_write(file, data, size);
+            stm_close(&file);
+            ok = TRUE;
+        }
+    }
+    else
+    {
+        /* The data is uploaded aside, so a failed copy never leaves a half-written file */
+        String *part = str_printf("%s.part", tc(dest));
+        String *name = str_printf("temp_file_%d", bthread_current_id());
+        String *tmp = hfile_appdata(tc(name));
+        Stream *file = stm_to_file(tc(tmp), NULL);
+        stm_write(file, data, size);
+        stm_close(&file);
+        ok = ssh_scp(NULL, tc(tmp), login, tc(part), FALSE, FALSE);
+
+        if (ok == TRUE)
+        {
+            String *cmd = NULL;
+            if (login->platform == ekWINDOWS)
+                cmd = str_printf("(if exist %s (copy /b %s+%s %s) else (copy /b %s %s)) && del %s", tc(dest), tc(dest), tc(part), tc(dest), tc(part), tc(dest), tc(part));
+            else
+                /* Flushed to disk once per appended batch */
+                cmd = str_printf("cat %s >> %s && rm %s && sync", tc(part), tc(dest), tc(part));
+            ok = i_ssh_ok(login, &cmd);
+        }
+
+        str_destroy(&part);
+        str_destroy(&tmp);
+        str_destroy(&name);
     }
 
     str_destroy(&dest);
@@ -734,15 +1426,6 @@ bool_t ssh_copy(const Login *from_login, const char_t *from_path, const char_t *
 
 /*---------------------------------------------------------------------------*/
 
-static platform_t i_login_platform(const Login *login)
-{
-    if (login != NULL)
-        return login->platform;
-    return osbs_platform();
-}
-
-/*---------------------------------------------------------------------------*/
-
 bool_t ssh_copy_files(const Login *login, const char_t *from_path, const char_t *to_path)
 {
     platform_t platform = i_login_platform(login);
@@ -800,13 +1483,26 @@ static const char_t *i_scp_cmd(const Login *from_login, const Login *to_login, c
 
 /*---------------------------------------------------------------------------*/
 
+static String *i_scp_mux_opts(const Login *from_login, const Login *to_login)
+{
+    if (i_localhost(from_login) == TRUE)
+        return i_mux_opts(to_login);
+    if (i_localhost(to_login) == TRUE)
+        return i_mux_opts(from_login);
+    /* Remote to remote copies open their own connections */
+    return str_c("");
+}
+
+/*---------------------------------------------------------------------------*/
+
 bool_t ssh_scp(const Login *from_login, const char_t *from_path, const Login *to_login, const char_t *to_path, const bool_t recursive, const bool_t proxy)
 {
     bool_t ok = FALSE;
     String *from = i_scp_op(from_login, from_path);
     String *to = i_scp_op(to_login, to_path);
     const char_t *scp = i_scp_cmd(from_login, to_login, recursive, proxy);
-    String *cmd = str_printf("%s %s %s", scp, tc(from), tc(to));
+    String *opts = i_scp_mux_opts(from_login, to_login);
+    String *cmd = str_printf("%s %s %s %s", scp, tc(opts), tc(from), tc(to));
     Proc *proc = bproc_exec(tc(cmd), NULL);
 
     if (proc != NULL)
@@ -822,6 +1518,7 @@ bool_t ssh_scp(const Login *from_login, const char_t *from_path, const Login *to
 
     str_destroy(&from);
     str_destroy(&to);
+    str_destroy(&opts);
     str_destroy(&cmd);
     return ok;
 }
@@ -834,14 +1531,16 @@ bool_t ssh_upload(const char_t *from_path, const Login *to_login, const char_t *
     String *from = i_scp_op(NULL, from_path);
     String *to = i_scp_op(to_login, to_path);
     const char_t *scp = (recursive == TRUE) ? "scp -r" : "scp";
+    String *opts = NULL;
     String *cmd = NULL;
     Proc *proc = NULL;
 
     cassert_no_null(to_login);
+    opts = i_mux_opts(to_login);
     if (to_login->use_sshpass == TRUE)
-        cmd = str_printf("sshpass -p '%s' %s %s %s", tc(to_login->pass), scp, tc(from), tc(to));
+        cmd = str_printf("sshpass -p '%s' %s %s %s %s", tc(to_login->pass), scp, tc(opts), tc(from), tc(to));
     else
-        cmd = str_printf("%s %s %s", scp, tc(from), tc(to));
+        cmd = str_printf("%s %s %s %s", scp, tc(opts), tc(from), tc(to));
 
     proc = bproc_exec(tc(cmd), NULL);
 
@@ -858,6 +1557,7 @@ bool_t ssh_upload(const char_t *from_path, const Login *to_login, const char_t *
 
     str_destroy(&from);
     str_destroy(&to);
+    str_destroy(&opts);
     str_destroy(&cmd);
     return ok;
 }
@@ -948,7 +1648,9 @@ bool_t ssh_reboot(const Login *login)
     {
         String *cmd = str_printf("echo %s | sudo -S /sbin/reboot", tc(login->pass));
         /* ssh reboot returns '255' instead 0. Perhaps because the connection is closed by remote */
-        return i_ssh_ret(login, &cmd, 255);
+        bool_t ok = i_ssh_ret(login, &cmd, 255);
+        i_mux_forget(login);
+        return ok;
     }
 
     return FALSE;
@@ -958,32 +1660,34 @@ bool_t ssh_reboot(const Login *login)
 
 bool_t ssh_shutdown(const Login *login)
 {
+    String *cmd = NULL;
+    bool_t ok = FALSE;
     cassert_no_null(login);
     switch (login->platform)
     {
     case ekLINUX:
-    {
-        String *cmd = str_printf("echo %s | sudo -S shutdown -h now", tc(login->pass));
-        return i_ssh_ok(login, &cmd);
-    }
+        cmd = str_printf("echo %s | sudo -S shutdown -h now", tc(login->pass));
+        break;
 
     case ekWINDOWS:
-    {
-        String *cmd = str_printf("shutdown -s -t 00 -f");
-        return i_ssh_ok(login, &cmd);
-    }
+        cmd = str_printf("shutdown -s -t 00 -f");
+        break;
 
     case ekMACOS:
-    {
-        String *cmd = str_printf("echo %s | sudo -S shutdown -h now", tc(login->pass));
-        return i_ssh_ok(login, &cmd);
-    }
+        cmd = str_printf("echo %s | sudo -S shutdown -h now", tc(login->pass));
+        break;
 
     default:
         cassert_default(login->platform);
     }
 
-    return FALSE;
+    if (cmd != NULL)
+    {
+        ok = i_ssh_ok(login, &cmd);
+        i_mux_forget(login);
+    }
+
+    return ok;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -1044,6 +1748,102 @@ bool_t ssh_cmake_untar(const Login *login, const char_t *dest_path, const char_t
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * The tar output of 'from' is piped through the master into the 'to' file.
+ * The archive is compressed on the fly and never written to a temporal file.
+ */
+bool_t ssh_tar_stream(const Login *from_login, const char_t *src_path, const Login *to_login, const char_t *to_path, const char_t *to_filename)
+{
+    bool_t ok = FALSE;
+
+    /* 'pipefail' and 'cat' are needed in master and destination */
+    if (osbs_platform() == ekLINUX && i_login_platform(to_login) != ekWINDOWS)
+    {
+        String *dest = i_join_file(to_login, to_path, to_filename);
+        String *tar = str_printf("cd %s && tar czf - .", src_path);
+        String *put = str_printf("cat > %s.part && mv %s.part %s", tc(dest), tc(dest), tc(dest));
+        String *from_ssh = i_ssh_compose(from_login, tc(tar));
+        String *to_ssh = i_ssh_compose(to_login, tc(put));
+        String *cmd = str_printf("set -o pipefail; %s | %s", tc(from_ssh), tc(to_ssh));
+        Proc *proc = bproc_exec(tc(cmd), NULL);
+
+        if (proc != NULL)
+        {
+            uint32_t ret = UINT32_MAX;
+            bproc_read_close(proc);
+            bproc_eread_close(proc);
+            ret = bproc_wait(proc);
+            bproc_close(&proc);
+            if (ret == 0)
+                ok = TRUE;
+        }
+
+        /* Remove the incomplete file */
+        if (ok == FALSE)
+        {
+            String *part = str_printf("%s.part", tc(dest));
+            ssh_delete_file(to_login, tc(part));
+            str_destroy(&part);
+        }
+
+        str_destroy(&dest);
+        str_destroy(&tar);
+        str_destroy(&put);
+        str_destroy(&from_ssh);
+        str_destroy(&to_ssh);
+        str_destroy(&cmd);
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * 'configure_file(COPYONLY)' only writes the destination if the content changes,
+ * so unchanged files keep their timestamp and are not rebuilt.
+ */
+static const char_t *i_SYNC_SCRIPT =
+    "file(GLOB_RECURSE files RELATIVE \"${FROM}\" \"${FROM}/*\")\n"
+    "foreach(f ${files})\n"
+    "    configure_file(\"${FROM}/${f}\" \"${TO}/${f}\" COPYONLY)\n"
+    "endforeach()\n"
+    "file(GLOB_RECURSE olds RELATIVE \"${TO}\" \"${TO}/*\")\n"
+    "foreach(f ${olds})\n"
+    "    if(NOT EXISTS \"${FROM}/${f}\")\n"
+    "        file(REMOVE \"${TO}/${f}\")\n"
+    "    endif()\n"
+    "endforeach()\n";
+
+/*---------------------------------------------------------------------------*/
+
+bool_t ssh_cmake_sync(const Login *login, const char_t *from_path, const char_t *to_path, const char_t *work_path)
+{
+    static const char_t *script = "nbuild_sync.cmake";
+    bool_t ok = FALSE;
+    Stream *stm = stm_memory(1024);
+    stm_writef(stm, i_SYNC_SCRIPT);
+    ok = ssh_to_file(login, work_path, script, stm);
+    stm_close(&stm);
+
+    if (ok == TRUE)
+    {
+        /* CMake paths always with '/' */
+        String *from = str_path(ekLINUX, "%s", from_path);
+        String *to = str_path(ekLINUX, "%s", to_path);
+        String *spath = str_path(i_login_platform(login), "%s/%s", work_path, script);
+        String *cmd = str_printf("cmake -DFROM=%s -DTO=%s -P %s", tc(from), tc(to), tc(spath));
+        ok = i_ssh_ok(login, &cmd);
+        str_destroy(&from);
+        str_destroy(&to);
+        str_destroy(&spath);
+    }
+
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static ___INLINE const char_t *i_qt(const Login *login)
 {
     if (osbs_platform() == ekWINDOWS && i_localhost(login) == FALSE)
@@ -1113,12 +1913,13 @@ uint32_t ssh_cmake_configure(const Login *login, const char_t *envvars, const ch
 
 /*---------------------------------------------------------------------------*/
 
-uint32_t ssh_cmake_build(const Login *login, const char_t *envvars, const char_t *build_path, const char_t *opts, String **log)
+uint32_t ssh_cmake_build_imp(const Login *login, const char_t *envvars, const char_t *build_path, const char_t *opts, FPtr_ssh_line func_line, void *data)
 {
     platform_t platform = i_login_platform(login);
     uint32_t ret = UINT32_MAX;
     String *cmd = NULL;
-    Stream *stm = NULL;
+    String *rcmd = NULL;
+    cassert_no_nullf(func_line);
 
     if (str_empty_c(envvars) == FALSE)
     {
@@ -1132,29 +1933,13 @@ uint32_t ssh_cmake_build(const Login *login, const char_t *envvars, const char_t
         cmd = str_printf("cmake --build %s %s", build_path, opts);
     }
 
-    stm = i_ssh_command(login, tc(cmd), TRUE, &ret);
-
-    if (stm != NULL)
-    {
-        if (log != NULL)
-        {
-            Stream *stm_log = stm_memory(2024);
-            uint32_t size = stm_buffer_size(stm);
-            stm_printf(stm_log, "%s", tc(cmd));
-            stm_writef(stm_log, "\n\n");
-            stm_pipe(stm, stm_log, size);
-            *log = stm_str(stm_log);
-            stm_close(&stm_log);
-        }
-        stm_close(&stm);
-    }
-    else
-    {
-        if (log != NULL)
-            *log = str_c("");
-    }
-
+    /* Compiler diagnostics are in stderr with some generators. Keep the original order */
+    rcmd = str_printf("%s 2>&1", tc(cmd));
+    func_line(data, tc(cmd));
+    func_line(data, "");
+    ret = i_ssh_command_lines(login, tc(rcmd), func_line, data);
     str_destroy(&cmd);
+    str_destroy(&rcmd);
     return ret;
 }
 
@@ -1230,10 +2015,10 @@ uint32_t ssh_cmake_install_make_program(const Login *login, const char_t *build_
 
 /*---------------------------------------------------------------------------*/
 
-uint32_t ssh_execute_cmd(const Login *login, const char_t *test_cmd, String **log)
+uint32_t ssh_execute_cmd_timeout(const Login *login, const char_t *test_cmd, const uint32_t timeout, bool_t *expired, String **log)
 {
     uint32_t ret = UINT32_MAX;
-    Stream *stm = i_ssh_command(login, test_cmd, TRUE, &ret);
+    Stream *stm = i_ssh_command_timeout(login, test_cmd, TRUE, timeout, expired, &ret);
     if (stm != NULL)
     {
         if (log != NULL)
@@ -1256,3 +2041,10 @@ uint32_t ssh_execute_cmd(const Login *login, const char_t *test_cmd, String **lo
 
     return ret;
 }
+
+/*---------------------------------------------------------------------------*/
+
+uint32_t ssh_execute_cmd(const Login *login, const char_t *test_cmd, String **log)
+{
+    return ssh_execute_cmd_timeout(login, test_cmd, 0, NULL, log);
+}
@@ -14,8 +14,18 @@
 
 uint32_t ssh_command(const char_t *cmd, Stream **stdout_, Stream **stderr_);
 
+uint32_t ssh_command_lines_imp(const char_t *cmd, FPtr_ssh_line func_line, void *data);
+
+void ssh_mux_start(const char_t *path);
+
+void ssh_mux_finish(void);
+
+void ssh_mux_stats(uint32_t *handshakes, uint32_t *reused);
+
 bool_t ssh_ping(const char_t *ip);
 
+bool_t ssh_probe(const char_t *ip, const uint32_t timeout_ms);
+
 uint32_t ssh_repo_version(const char_t *repo_url, const char_t *user, const char_t *pass);
 
 uint32_t ssh_working_version(const Login *login, const char_t *path);
@@ -30,6 +40,8 @@ bool_t ssh_repo_is_dir(const char_t *repo_url, const uint32_t repo_vers, const c
 
 bool_t ssh_repo_checkout(const Login *login, const char_t *repo_url, const char_t *user, const char_t *pass, const uint32_t repo_vers, const char_t *dest);
 
+bool_t ssh_repo_update(const Login *login, const char_t *user, const char_t *pass, const uint32_t repo_vers, const char_t *path);
+
 bool_t ssh_dir_exists(const Login *login, const char_t *path);
 
 bool_t ssh_file_exists(const Login *login, const char_t *path, const char_t *filename);
@@ -42,10 +54,32 @@ bool_t ssh_delete_file(const Login *login, const char_t *path);
 
 bool_t ssh_delete_dir(const Login *login, const char_t *path);
 
+bool_t ssh_delete_expired(const Login *login, const char_t *path, const char_t *pattern, const uint32_t days);
+
+SSHBatch *ssh_batch_create(const Login *login);
+
+void ssh_batch_destroy(SSHBatch **batch);
+
+uint32_t ssh_batch_add(SSHBatch *batch, String **cmd);
+
+uint32_t ssh_batch_create_dir(SSHBatch *batch, const char_t *dir);
+
+uint32_t ssh_batch_delete_dir(SSHBatch *batch, const char_t *path);
+
+uint32_t ssh_batch_ncpus(SSHBatch *batch);
+
+bool_t ssh_batch_run(SSHBatch *batch);
+
+uint32_t ssh_batch_ret(const SSHBatch *batch, const uint32_t step);
+
+const char_t *ssh_batch_output(const SSHBatch *batch, const uint32_t step);
+
 Stream *ssh_file_cat(const Login *login, const char_t *path, const char_t *filename);
 
 bool_t ssh_to_file(const Login *login, const char_t *path, const char_t *filename, const Stream *stm);
 
+bool_t ssh_append_file(const Login *login, const char_t *path, const char_t *filename, const Stream *stm);
+
 bool_t ssh_copy(const Login *from_login, const char_t *from_path, const char_t *from_filename, const Login *to_login, const char_t *to_path, const char_t *to_filename, const bool_t proxy);
 
 bool_t ssh_copy_files(const Login *login, const char_t *from_path, const char_t *to_path);
@@ -80,14 +114,32 @@ bool_t ssh_cmake_tar(const Login *login, const char_t *src_path, const char_t *t
 
 bool_t ssh_cmake_untar(const Login *login, const char_t *dest_path, const char_t *tarpath);
 
+bool_t ssh_tar_stream(const Login *from_login, const char_t *src_path, const Login *to_login, const char_t *to_path, const char_t *to_filename);
+
+bool_t ssh_cmake_sync(const Login *login, const char_t *from_path, const char_t *to_path, const char_t *work_path);
+
 Stream *ssh_cmake_version(const Login *login);
 
 uint32_t ssh_cmake_configure(const Login *login, const char_t *envvars, const char_t *src_path, const char_t *build_path, const char_t *generator, const char_t *opts, String **log);
 
-uint32_t ssh_cmake_build(const Login *login, const char_t *envvars, const char_t *build_path, const char_t *opts, String **log);
+uint32_t ssh_cmake_build_imp(const Login *login, const char_t *envvars, const char_t *build_path, const char_t *opts, FPtr_ssh_line func_line, void *data);
 
 uint32_t ssh_cmake_install(const Login *login, const char_t *build_path, const char_t *opts, String **log);
 
 uint32_t ssh_cmake_install_make_program(const Login *login, const char_t *build_path, const char_t *install_cmd, String **log);
 
 uint32_t ssh_execute_cmd(const Login *login, const char_t *test_cmd, String **log);
+
+uint32_t ssh_execute_cmd_timeout(const Login *login, const char_t *test_cmd, const uint32_t timeout, bool_t *expired, String **log);
+
+#define ssh_command_lines(cmd, func_line, data, type) \
+    ( \
+        (void)(cast(data, type) == data), \
+        FUNC_CHECK_SSH_LINE(func_line, type), \
+        ssh_command_lines_imp(cmd, (FPtr_ssh_line)func_line, cast(data, void)))
+
+#define ssh_cmake_build(login, envvars, build_path, opts, func_line, data, type) \
+    ( \
+        (void)(cast(data, type) == data), \
+        FUNC_CHECK_SSH_LINE(func_line, type), \
+        ssh_cmake_build_imp(login, envvars, build_path, opts, (FPtr_ssh_line)func_line, cast(data, void)))
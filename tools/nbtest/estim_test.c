@@ -0,0 +1,199 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: estim_test.c
+ *
+ */
+
+/* Job duration estimator over a fixture history */
+
+#include <nbuild/estim.h>
+#include <nbuild/report.h>
+#include <core/arrst.h>
+#include <core/core.h>
+#include <core/strings.h>
+#include <sewer/bstd.h>
+#include <sewer/cassert.h>
+
+typedef struct _ftime_t FTime;
+
+struct _ftime_t
+{
+    uint32_t job_id;
+    const char_t *job;
+    const char_t *step;
+    const char_t *hostname;
+    uint32_t seconds;
+};
+
+/*
+ * Job 0 has build and test history, job 1 only builds, job 2 has no history.
+ * Boot samples are named after the host. 'win' has never been booted.
+ */
+static const FTime i_TIMES[] = {
+    {0, "job0", "build", "linux", 100},
+    {0, "job0", "build", "linux", 120},
+    {0, "job0", "build", "linux", 110},
+    {0, "job0", "build", "win", 200},
+    {0, "job0", "build", "win", 220},
+    {0, "job0", "test", "linux", 30},
+    {1, "job1", "build", "macos", 50},
+    {UINT32_MAX, "linux", "boot", "linux", 40},
+    {UINT32_MAX, "linux", "boot", "linux", 70},
+    {UINT32_MAX, "macos", "boot", "macos", 90}};
+
+/*---------------------------------------------------------------------------*/
+
+/* Replaces the report history with the fixture */
+void report_job_times(const Report *report, const uint32_t job_id, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds)
+{
+    uint32_t i, n = sizeof(i_TIMES) / sizeof(FTime);
+    unref(report);
+    arrst_clear(seconds, NULL, uint32_t);
+    for (i = 0; i < n; ++i)
+    {
+        const FTime *time = &i_TIMES[i];
+        if (time->job_id == job_id && str_equ_c(time->step, step_id) == TRUE)
+        {
+            if (hostname == NULL || str_equ_c(time->hostname, hostname) == TRUE)
+                arrst_append(seconds, time->seconds, uint32_t);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+void report_times(const Report *report, const char_t *job, const char_t *step_id, const char_t *hostname, ArrSt(uint32_t) *seconds)
+{
+    uint32_t i, n = sizeof(i_TIMES) / sizeof(FTime);
+    unref(report);
+    arrst_clear(seconds, NULL, uint32_t);
+    for (i = 0; i < n; ++i)
+    {
+        const FTime *time = &i_TIMES[i];
+        if ((job == NULL || str_equ_c(time->job, job) == TRUE) && str_equ_c(time->step, step_id) == TRUE)
+        {
+            if (hostname == NULL || str_equ_c(time->hostname, hostname) == TRUE)
+                arrst_append(seconds, time->seconds, uint32_t);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_check(const char_t *name, const uint32_t value, const uint32_t expected)
+{
+    if (value != expected)
+    {
+        bstd_printf("FAILED %s: %u, %u expected\n", name, value, expected);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_median(const uint32_t *values, const uint32_t n)
+{
+    ArrSt(uint32_t) *seconds = arrst_create(uint32_t);
+    uint32_t i, median = 0;
+    for (i = 0; i < n; ++i)
+        arrst_append(seconds, values[i], uint32_t);
+    median = estim_median(seconds);
+    arrst_destroy(&seconds, NULL, uint32_t);
+    return median;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_median_test(void)
+{
+    const uint32_t odd[] = {5, 1, 3};
+    const uint32_t even[] = {4, 1, 3, 2};
+    bool_t ok = TRUE;
+    ok &= i_check("empty median", i_median(NULL, 0), UINT32_MAX);
+    ok &= i_check("odd median", i_median(odd, 3), 3);
+    ok &= i_check("even median", i_median(even, 4), 2);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_job_test(void)
+{
+    bool_t ok = TRUE;
+    ok &= i_check("host build", estim_step_seconds(NULL, 0, "build", "linux"), 110);
+    ok &= i_check("any host build", estim_step_seconds(NULL, 0, "build", NULL), 120);
+    ok &= i_check("build and test", estim_job_seconds(NULL, 0, FALSE, "linux"), 140);
+    ok &= i_check("test pending", estim_job_seconds(NULL, 0, TRUE, "linux"), 30);
+    ok &= i_check("never tested", estim_job_seconds(NULL, 0, FALSE, "win"), 210);
+    ok &= i_check("without tests", estim_job_seconds(NULL, 1, FALSE, NULL), 50);
+    ok &= i_check("unknown test", estim_job_seconds(NULL, 1, TRUE, NULL), UINT32_MAX);
+    ok &= i_check("unknown host", estim_job_seconds(NULL, 0, FALSE, "other"), UINT32_MAX);
+    ok &= i_check("unknown job", estim_job_seconds(NULL, 2, FALSE, NULL), UINT32_MAX);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_boot_test(void)
+{
+    bool_t ok = TRUE;
+    ok &= i_check("boot median", estim_boot_seconds(NULL, "linux"), 55);
+    ok &= i_check("boot sample", estim_boot_seconds(NULL, "macos"), 90);
+    ok &= i_check("never booted", estim_boot_seconds(NULL, "win"), UINT32_MAX);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_completion_test(void)
+{
+    bool_t ok = TRUE;
+    uint32_t busy = 0, idle = 0;
+
+    /* Unknown durations saturate below UINT32_MAX, so the host can still be chosen */
+    ok &= i_check("unknown job", estim_completion(0, 1, 0, UINT32_MAX), UINT32_MAX - 1);
+    ok &= i_check("unknown boot", estim_completion(0, 1, UINT32_MAX, 300), UINT32_MAX - 1);
+    ok &= i_check("unknown queue", estim_completion(UINT32_MAX, 1, 0, 300), UINT32_MAX - 1);
+    ok &= i_check("all unknown", estim_completion(UINT32_MAX, 1, UINT32_MAX, UINT32_MAX), UINT32_MAX - 1);
+    ok &= i_check("near limit", estim_completion(0, 1, UINT32_MAX - 10, 9), UINT32_MAX - 1);
+
+    /* A booted host with work (boot = 0) against an idle host that needs boot */
+    busy = estim_completion(100, 1, 0, 300);
+    idle = estim_completion(0, 1, 60, 300);
+    ok &= i_check("booted busy", busy, 400);
+    ok &= i_check("needs boot", idle, 360);
+    ok &= i_check("boot wins", idle < busy ? 1 : 0, 1);
+    busy = estim_completion(30, 1, 0, 300);
+    ok &= i_check("booted wins", busy < idle ? 1 : 0, 1);
+
+    /* Queued work is divided by the slots. Zero slots count as one */
+    ok &= i_check("1 slot", estim_completion(400, 1, 0, 100), 500);
+    ok &= i_check("4 slots", estim_completion(400, 4, 0, 100), 200);
+    ok &= i_check("0 slots", estim_completion(400, 0, 0, 100), 500);
+    ok &= i_check("rounding", estim_completion(10, 4, 0, 100), 102);
+    ok &= i_check("slots and boot", estim_completion(400, 4, 60, 100), 260);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    bool_t ok = TRUE;
+    unref(argc);
+    unref(argv);
+    core_start();
+    ok &= i_median_test();
+    ok &= i_job_test();
+    ok &= i_boot_test();
+    ok &= i_completion_test();
+    bstd_printf("%s: estim\n", ok == TRUE ? "OK" : "FAILED");
+    core_finish();
+    return ok == TRUE ? 0 : 1;
+}
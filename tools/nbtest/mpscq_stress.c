@@ -0,0 +1,129 @@
+/*
+ * NBuild CMake-based C/C++ Continuous Integration System
+ * 2015-2025 Francisco Garcia Collado
+ * MIT Licence
+ * https://nappgui.com/en/legal/license.html
+ *
+ * File: mpscq_stress.c
+ *
+ */
+
+/* Stress test of the report queue: many producers, one consumer */
+
+#include <nbuild/mpscq.h>
+#include <core/core.h>
+#include <core/heap.h>
+#include <osbs/bthread.h>
+#include <sewer/bstd.h>
+#include <sewer/cassert.h>
+
+typedef struct _srecord_t SRecord;
+typedef struct _producer_t Producer;
+
+struct _srecord_t
+{
+    MPSCNode node;
+    uint32_t producer;
+    uint32_t seq;
+};
+
+struct _producer_t
+{
+    MPSCQueue *queue;
+    SRecord *records;
+    Thread *thread;
+};
+
+static const uint32_t i_NPRODUCERS = 16;
+static const uint32_t i_NRECORDS = 200000;
+
+/*---------------------------------------------------------------------------*/
+
+static uint32_t i_producer_thread(Producer *producer)
+{
+    uint32_t i;
+    cassert_no_null(producer);
+    for (i = 0; i < i_NRECORDS; ++i)
+        mpscq_push(producer->queue, &producer->records[i].node);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static bool_t i_consume(MPSCQueue *queue)
+{
+    uint32_t *next = heap_new_n0(i_NPRODUCERS, uint32_t);
+    uint32_t total = 0;
+    bool_t ok = TRUE;
+
+    /* Every record arrives once, in the push order of its producer */
+    while (ok == TRUE && total < i_NPRODUCERS * i_NRECORDS)
+    {
+        SRecord *record = (SRecord *)mpscq_pop(queue);
+        if (record != NULL)
+        {
+            if (record->seq != next[record->producer])
+            {
+                bstd_printf("Producer %d: record %d arrived, %d expected\n", record->producer, record->seq, next[record->producer]);
+                ok = FALSE;
+            }
+
+            next[record->producer] += 1;
+            total += 1;
+        }
+    }
+
+    if (ok == TRUE && mpscq_pop(queue) != NULL)
+    {
+        bstd_printf("Unexpected record after %d\n", total);
+        ok = FALSE;
+    }
+
+    heap_delete_n(&next, i_NPRODUCERS, uint32_t);
+    return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    MPSCQueue *queue = NULL;
+    Producer *producers = NULL;
+    bool_t ok = TRUE;
+    uint32_t i, j;
+    unref(argc);
+    unref(argv);
+
+    core_start();
+    queue = mpscq_create();
+    producers = heap_new_n0(i_NPRODUCERS, Producer);
+
+    for (i = 0; i < i_NPRODUCERS; ++i)
+    {
+        producers[i].queue = queue;
+        producers[i].records = heap_new_n0(i_NRECORDS, SRecord);
+        for (j = 0; j < i_NRECORDS; ++j)
+        {
+            producers[i].records[j].producer = i;
+            producers[i].records[j].seq = j;
+        }
+    }
+
+    for (i = 0; i < i_NPRODUCERS; ++i)
+        producers[i].thread = bthread_create(i_producer_thread, &producers[i], Producer);
+
+    ok = i_consume(queue);
+
+    for (i = 0; i < i_NPRODUCERS; ++i)
+    {
+        bthread_wait(producers[i].thread);
+        bthread_close(&producers[i].thread);
+        heap_delete_n(&producers[i].records, i_NRECORDS, SRecord);
+    }
+
+    heap_delete_n(&producers, i_NPRODUCERS, Producer);
+    mpscq_destroy(&queue);
+    bstd_printf("%s: %d producers x %d records\n", ok == TRUE ? "OK" : "FAILED", i_NPRODUCERS, i_NRECORDS);
+    core_finish();
+    return ok == TRUE ? 0 : 1;
+}